@@ -0,0 +1,324 @@
+#include "adc_humidity_reader.h"
+#include <algorithm>
+#include <esp_idf_version.h>
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <esp_adc/adc_cali.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include <esp_adc/adc_continuous.h>
+#else
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#endif
+
+namespace
+{
+// ADC1 は1つしかないため、ドライバの状態はファイル内で保持する
+#if ESP_IDF_VERSION_MAJOR >= 5
+adc_continuous_handle_t adcHandle = nullptr; ///< 連続変換ドライバのハンドル
+adc_cali_handle_t caliHandle = nullptr;      ///< キャリブレーションのハンドル
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+constexpr adc_atten_t ATTEN = ADC_ATTEN_DB_12; ///< 減衰量（約0〜2.5V）
+#else
+constexpr adc_atten_t ATTEN = ADC_ATTEN_DB_11; ///< 減衰量（約0〜2.5V）
+#endif
+#else
+esp_adc_cal_characteristics_t adcChars; ///< キャリブレーションの特性値
+
+constexpr adc_atten_t ATTEN = ADC_ATTEN_DB_11; ///< 減衰量（約0〜2.5V）
+#endif
+
+/**
+ * @brief 連続変換ドライバを初期化して開始する
+ */
+bool startDriver(const uint8_t *channels, size_t count, uint32_t sampleFreq, size_t frameSize)
+{
+    adc_digi_pattern_config_t patterns[ContinuousADCHumidityReader::MAX_CHANNELS] = {};
+    uint32_t channelMask = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        patterns[i].atten = ATTEN;
+        patterns[i].channel = channels[i];
+        patterns[i].unit = 0; // ADC1
+        patterns[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        channelMask |= 1 << channels[i];
+    }
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+    adc_continuous_handle_cfg_t handleConfig = {};
+    handleConfig.max_store_buf_size = frameSize * 4;
+    handleConfig.conv_frame_size = frameSize;
+    if (adc_continuous_new_handle(&handleConfig, &adcHandle) != ESP_OK)
+    {
+        return false;
+    }
+
+    adc_continuous_config_t config = {};
+    config.pattern_num = count;
+    config.adc_pattern = patterns;
+    config.sample_freq_hz = sampleFreq;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+    if (adc_continuous_config(adcHandle, &config) != ESP_OK)
+    {
+        return false;
+    }
+
+    // ESP32-C3 はeFuseの値を使う曲線近似のキャリブレーションに対応している
+    adc_cali_curve_fitting_config_t caliConfig = {};
+    caliConfig.unit_id = ADC_UNIT_1;
+    caliConfig.atten = ATTEN;
+    caliConfig.bitwidth = ADC_BITWIDTH_DEFAULT;
+    if (adc_cali_create_scheme_curve_fitting(&caliConfig, &caliHandle) != ESP_OK)
+    {
+        return false;
+    }
+
+    return adc_continuous_start(adcHandle) == ESP_OK;
+#else
+    adc_digi_init_config_t initConfig = {};
+    initConfig.max_store_buf_size = frameSize * 4;
+    initConfig.conv_num_each_intr = frameSize;
+    initConfig.adc1_chan_mask = channelMask;
+    initConfig.adc2_chan_mask = 0;
+    if (adc_digi_initialize(&initConfig) != ESP_OK)
+    {
+        return false;
+    }
+
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = false;
+    config.pattern_num = count;
+    config.adc_pattern = patterns;
+    config.sample_freq_hz = sampleFreq;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+    if (adc_digi_controller_configure(&config) != ESP_OK)
+    {
+        return false;
+    }
+
+    esp_adc_cal_characterize(ADC_UNIT_1, ATTEN, ADC_WIDTH_BIT_12, 0, &adcChars);
+
+    return adc_digi_start() == ESP_OK;
+#endif
+}
+
+/**
+ * @brief 連続変換ドライバを停止して解放する（途中まで初期化した場合も呼び出せる）
+ */
+void stopDriver()
+{
+#if ESP_IDF_VERSION_MAJOR >= 5
+    if (adcHandle)
+    {
+        adc_continuous_stop(adcHandle);
+        adc_continuous_deinit(adcHandle);
+        adcHandle = nullptr;
+    }
+    if (caliHandle)
+    {
+        adc_cali_delete_scheme_curve_fitting(caliHandle);
+        caliHandle = nullptr;
+    }
+#else
+    adc_digi_stop();
+    adc_digi_deinitialize();
+#endif
+}
+
+/**
+ * @brief 連続変換を一時停止する
+ */
+void pauseDriver()
+{
+#if ESP_IDF_VERSION_MAJOR >= 5
+    adc_continuous_stop(adcHandle);
+#else
+    adc_digi_stop();
+#endif
+}
+
+/**
+ * @brief 一時停止した連続変換を再開する
+ */
+bool resumeDriver()
+{
+#if ESP_IDF_VERSION_MAJOR >= 5
+    return adc_continuous_start(adcHandle) == ESP_OK;
+#else
+    return adc_digi_start() == ESP_OK;
+#endif
+}
+
+/**
+ * @brief 変換結果を受け取るまで待つ
+ *
+ * @return true 受け取った
+ * @return false 受信バッファが溢れていた、または読み取りに失敗
+ */
+bool readFrame(uint8_t *buffer, size_t size, uint32_t &length)
+{
+#if ESP_IDF_VERSION_MAJOR >= 5
+    return adc_continuous_read(adcHandle, buffer, size, &length, ADC_MAX_DELAY) == ESP_OK;
+#else
+    return adc_digi_read_bytes(buffer, size, &length, ADC_MAX_DELAY) == ESP_OK;
+#endif
+}
+
+/**
+ * @brief 生データをキャリブレーション済みの電圧に変換する
+ */
+uint32_t toMillivolts(uint16_t raw)
+{
+#if ESP_IDF_VERSION_MAJOR >= 5
+    int millivolts = 0;
+    adc_cali_raw_to_voltage(caliHandle, raw, &millivolts);
+    return millivolts;
+#else
+    return esp_adc_cal_raw_to_voltage(raw, &adcChars);
+#endif
+}
+} // namespace
+
+bool ContinuousADCHumidityReader::begin()
+{
+    if (task)
+    {
+        return true;
+    }
+
+    // ADC1 に接続されたピンだけを使用できる
+    for (size_t i = 0; i < channelCount; i++)
+    {
+        int8_t channel = digitalPinToAnalogChannel(sensorPins[i]);
+        if (channel < 0 || channel >= SOC_ADC_CHANNEL_NUM(0))
+        {
+            return false;
+        }
+        adcChannels[i] = channel;
+    }
+
+    // 失敗した場合は途中まで初期化したドライバを解放し、単発の読み取りで代用する
+    if (!startDriver(adcChannels, channelCount, SAMPLE_FREQ_HZ, FRAME_SIZE))
+    {
+        stopDriver();
+        return false;
+    }
+    if (xTaskCreate(taskEntry, "adc", stackSize, this, priority, &task) != pdPASS)
+    {
+        task = nullptr;
+        stopDriver();
+        return false;
+    }
+
+    // 起動直後の 0 mV でポンプが制御されないよう、全チャンネルの最初の値が揃うまで待つ
+    uint32_t start = millis();
+    while (!isReady() && millis() - start < READY_TIMEOUT)
+    {
+        delay(1);
+    }
+
+    // 値が揃わない場合は変換されていないため、連続変換をやめて単発の読み取りで代用する
+    if (!isReady())
+    {
+        vTaskDelete(task);
+        task = nullptr;
+        stopDriver();
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void ContinuousADCHumidityReader::suspend()
+{
+    if (running)
+    {
+        pauseDriver();
+    }
+}
+
+void ContinuousADCHumidityReader::resume()
+{
+    if (!running)
+    {
+        return;
+    }
+
+    restarted = true;
+    if (!resumeDriver())
+    {
+        running = false;
+    }
+}
+
+void ContinuousADCHumidityReader::taskEntry(void *arg)
+{
+    static_cast<ContinuousADCHumidityReader *>(arg)->run();
+}
+
+void ContinuousADCHumidityReader::run()
+{
+    uint8_t buffer[FRAME_SIZE];
+    for (;;)
+    {
+        uint32_t length = 0;
+        if (!readFrame(buffer, sizeof(buffer), length))
+        {
+            overrunCount++;
+            continue;
+        }
+
+        // スリープの前に途中まで集めた生データは、復帰後の値と混ぜずに捨てる
+        if (restarted)
+        {
+            restarted = false;
+            for (Window &window : windows)
+            {
+                window.size = 0;
+            }
+        }
+
+        for (uint32_t offset = 0; offset + SOC_ADC_DIGI_RESULT_BYTES <= length; offset += SOC_ADC_DIGI_RESULT_BYTES)
+        {
+            const adc_digi_output_data_t *result = reinterpret_cast<const adc_digi_output_data_t *>(&buffer[offset]);
+            if (result->type2.unit == 0)
+            {
+                addSample(result->type2.channel, result->type2.data);
+            }
+        }
+        conversionCount += length / SOC_ADC_DIGI_RESULT_BYTES;
+    }
+}
+
+void ContinuousADCHumidityReader::addSample(uint8_t adcChannel, uint16_t raw)
+{
+    for (size_t i = 0; i < channelCount; i++)
+    {
+        if (adcChannels[i] != adcChannel)
+        {
+            continue;
+        }
+
+        Window &window = windows[i];
+        window.raw[window.size++] = raw;
+        if (window.size < OVERSAMPLE)
+        {
+            return;
+        }
+
+        // 中央値で突発的なノイズを除いてから、電圧に変換してEMAで平滑化する
+        uint16_t *middle = window.raw + OVERSAMPLE / 2;
+        std::nth_element(window.raw, middle, window.raw + OVERSAMPLE);
+        float millivolts = toMillivolts(*middle);
+        window.size = 0;
+
+        uint32_t bit = 1 << i;
+        filtered[i] = (readyMask & bit) ? filtered[i] + EMA_ALPHA * (millivolts - filtered[i]) : millivolts;
+        latestMillivolts[i] = static_cast<uint16_t>(filtered[i] + 0.5f);
+        readyMask |= bit;
+        return;
+    }
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include "humidity_calibration.h"
+#include "humidity_reader.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * @brief ADCの連続変換（DMA）を使用した湿度読み取りの実装
+ *
+ * 専用の FreeRTOS タスクが ADC1 の連続変換の結果をまとめて受け取り、チャンネルごとに
+ * OVERSAMPLE 個の生データの中央値を求めてから、ESP-IDF のADCキャリブレーションで電圧に変換し、
+ * 指数移動平均（EMA）で平滑化します。
+ *
+ * readHumidity() / readAll() は最新の平滑化済みの電圧をチャンネルごとの HumidityCalibration で湿度に変換するだけで、
+ * ADCの変換を待ちません。
+ * 中央値で突発的なノイズを除き、EMAで細かな揺れを抑えるため、閾値付近でポンプが稼働・停止を繰り返しにくくなります。
+ *
+ * 連続変換を開始できなかった場合や、最初の値が READY_TIMEOUT までに揃わなかった場合は、連続変換をやめて
+ * GPIOHumidityReader と同じ単発の読み取り（analogReadMilliVolts）で代用します。変換されない 0 mV のままの値で
+ * ポンプが制御されることはありません。
+ *
+ * 1チャンネルの場合は IHumidityReader、複数チャンネルの場合は IMultiHumidityReader として使用できます。
+ * 使用できるのは ADC1 に接続されたピン（ESP32-C3 では D0〜D2 など）だけです。
+ */
+class ContinuousADCHumidityReader final : public IHumidityReader, public IMultiHumidityReader
+{
+public:
+    constexpr static size_t MAX_CHANNELS = 5;        ///< 同時に変換できる最大チャンネル数（ESP32-C3 の ADC1）
+    constexpr static uint32_t SAMPLE_FREQ_HZ = 2000; ///< 全チャンネル合計の変換周波数 (Hz)
+    constexpr static size_t FRAME_SIZE = 256;        ///< 1回に受け取る変換結果のバイト数
+    constexpr static size_t OVERSAMPLE = 32;         ///< 中央値を求める生データ数（チャンネルあたり）
+    constexpr static float EMA_ALPHA = 0.125f;       ///< 指数移動平均の係数（大きいほど速く追従）
+    constexpr static uint32_t READY_TIMEOUT = 500;   ///< begin() で最初の値を待つ最大時間（ミリ秒）
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param sensorPins センサーが接続されているアナログピン番号の配列（チャンネル順）
+     * @param channelCount チャンネル数（最大 MAX_CHANNELS、超える分は読み取らない）
+     * @param stackSize 変換タスクのスタックサイズ（バイト）
+     * @param priority 変換タスクの優先度
+     */
+    ContinuousADCHumidityReader(const uint8_t *sensorPins, size_t channelCount, uint32_t stackSize = 3072,
+                                UBaseType_t priority = tskIDLE_PRIORITY + 2)
+        : sensorPins(sensorPins), channelCount(std::min(channelCount, MAX_CHANNELS)), stackSize(stackSize), priority(priority)
+    {
+    }
+
+    /**
+     * @brief ADCの連続変換と変換タスクを開始する
+     *
+     * setup() 関数内で、アプリケーションの初期化より前に呼び出してください。
+     * 全チャンネルの最初の値が揃うまで（最大 READY_TIMEOUT）待ちます。
+     *
+     * @return true 開始成功
+     * @return false ADC1 以外のピンが指定された、ドライバ・タスクの作成に失敗した、または値が揃わなかった
+     *               （以降は単発の読み取りで代用する）
+     */
+    bool begin();
+
+    /**
+     * @brief 最初のチャンネルの最新の平滑化済み湿度を取得する
+     *
+     * @return float 湿度値（%）
+     */
+    float readHumidity() override
+    {
+        return getHumidity(0);
+    }
+
+    /**
+     * @brief 指定したチャンネルの最新の平滑化済み湿度を取得する
+     *
+     * 校正値の入れ替えと排他するため、ポンプを止めるタイマーのコールバックなど別のタスクからも呼び出せます。
+     *
+     * @param channel チャンネル番号（0始まり）
+     * @return float 湿度値（%）
+     */
+    float getHumidity(size_t channel) const
+    {
+        uint16_t millivolts = readMillivolts(channel);
+        portENTER_CRITICAL(&calibrationLock);
+        float humidity = calibrations[channel].toHumidity(millivolts);
+        portEXIT_CRITICAL(&calibrationLock);
+        return humidity;
+    }
+
+    size_t getChannelCount() const override
+    {
+        return channelCount;
+    }
+
+    /**
+     * @brief 全チャンネルの最新の平滑化済み湿度を取得する
+     *
+     * @param[out] humidity チャンネルごとの湿度値（%）
+     */
+    void readAll(float *humidity) override
+    {
+        for (size_t i = 0; i < channelCount; i++)
+        {
+            humidity[i] = getHumidity(i);
+        }
+    }
+
+    /**
+     * @brief 指定したチャンネルの最新の平滑化済みの電圧を取得する
+     *
+     * @param channel チャンネル番号（0始まり）
+     * @return uint16_t 電圧 (mV)
+     */
+    uint16_t getMillivolts(size_t channel) const
+    {
+        return readMillivolts(channel);
+    }
+
+    /**
+     * @brief 指定したチャンネルの校正値を取得する
+     *
+     * 校正値を変更するタスク（メインループ）から呼び出してください。
+     */
+    const HumidityCalibration &getCalibration(size_t channel) const
+    {
+        return calibrations[channel];
+    }
+
+    /**
+     * @brief 指定したチャンネルの校正値を設定する
+     *
+     * 変換中の別のタスクが途中まで書き換えた表を読まないよう、スピンロックの中で入れ替えます。
+     */
+    void setCalibration(size_t channel, const HumidityCalibration &calibration)
+    {
+        portENTER_CRITICAL(&calibrationLock);
+        calibrations[channel] = calibration;
+        portEXIT_CRITICAL(&calibrationLock);
+    }
+
+    /**
+     * @brief 指定したチャンネルの現在の電圧を、指定した湿度の校正点として設定する
+     *
+     * 乾燥した土（または空気中）で humidity = 0、水に浸した状態で humidity = 100 を指定して呼び出します。
+     *
+     * @param channel チャンネル番号（0始まり）
+     * @param humidity 現在の湿度（%）
+     * @return true 設定した
+     * @return false 値がまだ揃っていない、または校正点を追加できない
+     */
+    bool calibrate(size_t channel, uint8_t humidity)
+    {
+        if (channel >= channelCount || (running && !(readyMask & (1u << channel))))
+        {
+            return false;
+        }
+
+        // 表の作り直しには時間がかかるため、コピーで作り直してから入れ替える
+        HumidityCalibration calibration = calibrations[channel];
+        if (!calibration.setPoint(humidity, readMillivolts(channel)))
+        {
+            return false;
+        }
+        setCalibration(channel, calibration);
+        return true;
+    }
+
+    /**
+     * @brief ライトスリープの前に連続変換を止める
+     *
+     * スリープ中は APB クロックと DMA が止まり、連続変換を続けられないため、スリープの直前に呼び出します。
+     * 止めている間は、最後に平滑化した電圧を返します。
+     */
+    void suspend();
+
+    /**
+     * @brief ライトスリープから復帰した後に連続変換を再開する
+     *
+     * スリープ前の途中の生データは捨て、復帰後の変換結果だけで中央値を求め直します。
+     * 再開できなかった場合は、単発の読み取りで代用します。
+     */
+    void resume();
+
+    /**
+     * @brief 連続変換で読み取っているかどうか（false の場合は単発の読み取りで代用している）
+     */
+    bool isRunning() const
+    {
+        return running;
+    }
+
+    /**
+     * @brief 全チャンネルの値が揃っているかどうか
+     */
+    bool isReady() const
+    {
+        return readyMask == (1u << channelCount) - 1;
+    }
+
+    /**
+     * @brief 変換タスクが受け取った変換結果の数を取得する
+     */
+    uint32_t getConversionCount() const
+    {
+        return conversionCount;
+    }
+
+    /**
+     * @brief 変換結果の受け取りに失敗した回数を取得する
+     */
+    uint32_t getOverrunCount() const
+    {
+        return overrunCount;
+    }
+
+private:
+    /**
+     * @brief チャンネルごとの中央値を求める途中の生データ
+     */
+    struct Window
+    {
+        uint16_t raw[OVERSAMPLE]; ///< 生データ
+        size_t size;              ///< 生データ数
+    };
+
+    const uint8_t *sensorPins;   ///< センサーピン番号の配列
+    size_t channelCount;         ///< チャンネル数
+    uint32_t stackSize;          ///< 変換タスクのスタックサイズ
+    UBaseType_t priority;        ///< 変換タスクの優先度
+    TaskHandle_t task = nullptr; ///< 変換タスクのハンドル
+
+    uint8_t adcChannels[MAX_CHANNELS] = {};         ///< チャンネルごとの ADC1 のチャンネル番号
+    Window windows[MAX_CHANNELS] = {};              ///< チャンネルごとの中央値を求める途中の生データ
+    float filtered[MAX_CHANNELS] = {};              ///< チャンネルごとの平滑化済みの電圧 (mV)
+    HumidityCalibration calibrations[MAX_CHANNELS]; ///< チャンネルごとの校正値（入れ替えはスピンロックで保護）
+
+    mutable portMUX_TYPE calibrationLock = portMUX_INITIALIZER_UNLOCKED; ///< 校正値の入れ替えと変換の排他
+
+    volatile uint16_t latestMillivolts[MAX_CHANNELS] = {}; ///< チャンネルごとの最新の平滑化済みの電圧（mV、変換タスクが更新）
+    volatile uint32_t readyMask = 0;                       ///< 最初の値が揃ったチャンネルのビットマスク
+    volatile bool running = false;                         ///< 連続変換で読み取っているかどうか
+    volatile bool restarted = false;                       ///< 再開後に途中の生データを捨てる必要があるかどうか
+    volatile uint32_t conversionCount = 0;                 ///< 受け取った変換結果の数
+    volatile uint32_t overrunCount = 0;                    ///< 変換結果の受け取りに失敗した回数
+
+    /**
+     * @brief 指定したチャンネルの電圧を取得する
+     *
+     * 連続変換が動いていない場合は、そのピンを単発で読み取ります。
+     *
+     * @return uint16_t 電圧 (mV)
+     */
+    uint16_t readMillivolts(size_t channel) const
+    {
+        return running ? latestMillivolts[channel] : analogReadMilliVolts(sensorPins[channel]);
+    }
+
+    /**
+     * @brief 変換タスクのエントリーポイント
+     */
+    static void taskEntry(void *arg);
+
+    /**
+     * @brief 変換結果を受け取り続ける
+     */
+    void run();
+
+    /**
+     * @brief 1つの変換結果をチャンネルの生データに加え、揃ったら中央値・EMAを更新する
+     *
+     * @param adcChannel ADC1 のチャンネル番号
+     * @param raw 生データ
+     */
+    void addSample(uint8_t adcChannel, uint16_t raw);
+};
+
+/**
+ * @brief ContinuousADCHumidityReader の1チャンネルを IHumidityReader として読み取るアダプター
+ *
+ * 複数の植木鉢を管理する場合に、チャンネルごとの TimedPumpController へ停止閾値の確認用に渡します。
+ * 最新の平滑化済みの電圧を変換するだけで、ADCの変換を待ちません。
+ */
+class ContinuousADCChannelReader final : public IHumidityReader
+{
+public:
+    /**
+     * @brief コンストラクタ
+     *
+     * @param reader 複数チャンネルの湿度リーダー
+     * @param channel チャンネル番号（0始まり）
+     */
+    ContinuousADCChannelReader(const ContinuousADCHumidityReader &reader, size_t channel) : reader(reader), channel(channel)
+    {
+    }
+
+    /**
+     * @brief チャンネルの最新の平滑化済み湿度を取得する
+     *
+     * @return float 湿度値（%、リーダーにないチャンネルの場合はポンプが稼働しないよう 100%）
+     */
+    float readHumidity() override
+    {
+        if (channel >= reader.getChannelCount())
+        {
+            return 100.0f;
+        }
+        return reader.getHumidity(channel);
+    }
+
+private:
+    const ContinuousADCHumidityReader &reader; ///< 複数チャンネルの湿度リーダー
+    size_t channel;                            ///< チャンネル番号
+};
@@ -0,0 +1,143 @@
+#include "async_display.h"
+#include "profiler.h"
+#include <algorithm>
+#include <esp_timer.h>
+#include <utility>
+
+bool AsyncDisplay::begin()
+{
+    // I2Cクロックは初期化（Wire の開始）より前に設定する
+    oled.setBusClock(BUS_CLOCK);
+    oled.initDisplay();
+    oled.setPowerSave(0);
+    oled.clearDisplay();
+    frameDiffer.invalidate();
+
+    if (task)
+    {
+        return true;
+    }
+
+    // 追加のバッファに収まらないディスプレイでは、U8G2 のバッファから同期的に送る
+    size_t frameBytes = oled.getBufferTileWidth() * oled.getBufferTileHeight() * FrameDiffer::TILE_BYTES;
+    if (frameBytes > BUFFER_SIZE)
+    {
+        return false;
+    }
+
+    drawing = oled.getBufferPtr();
+    ready = buffers[0];
+    sending = buffers[1];
+
+    mutex = xSemaphoreCreateMutex();
+    if (!mutex)
+    {
+        return false;
+    }
+
+    return xTaskCreate(taskEntry, "display", stackSize, this, priority, &task) == pdPASS;
+}
+
+void AsyncDisplay::beginFrame()
+{
+    frameStart = esp_timer_get_time();
+    oled.clearBuffer();
+}
+
+void AsyncDisplay::present()
+{
+    uint32_t elapsed = esp_timer_get_time() - frameStart;
+    renderTime += elapsed;
+    maxRenderTime = std::max(maxRenderTime, elapsed);
+    frameCount++;
+
+    // 転送タスクがない場合は同期的に転送する（PHASE_TRANSFER が転送タスクと重なることはない）
+    if (!task)
+    {
+        transfer(oled.getBufferPtr());
+        return;
+    }
+
+    // 描画したバッファを転送待ちにし、前の転送待ちのバッファに次のフレームを描く
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (pending)
+    {
+        droppedCount++;
+    }
+    std::swap(drawing, ready);
+    pending = true;
+    xSemaphoreGive(mutex);
+
+    oled.getU8g2()->tile_buf_ptr = drawing;
+    xTaskNotifyGive(task);
+}
+
+bool AsyncDisplay::isBusy() const
+{
+    if (!mutex)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool busy = pending || transferring;
+    xSemaphoreGive(mutex);
+    return busy;
+}
+
+void AsyncDisplay::setPowerSave(bool enabled)
+{
+    while (isBusy())
+    {
+        vTaskDelay(1);
+    }
+    oled.setPowerSave(enabled);
+}
+
+void AsyncDisplay::taskEntry(void *arg)
+{
+    static_cast<AsyncDisplay *>(arg)->run();
+}
+
+void AsyncDisplay::run()
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // 転送待ちのフレームを受け取る（転送中に届いたフレームは次の通知で受け取る）
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        bool received = pending;
+        if (received)
+        {
+            std::swap(ready, sending);
+            pending = false;
+            transferring = true;
+        }
+        xSemaphoreGive(mutex);
+
+        if (!received)
+        {
+            continue;
+        }
+
+        transfer(sending);
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        transferring = false;
+        xSemaphoreGive(mutex);
+    }
+}
+
+void AsyncDisplay::transfer(const uint8_t *frame)
+{
+    PROFILE_PHASE(PHASE_TRANSFER);
+
+    int64_t start = esp_timer_get_time();
+    frameDiffer.send(frame);
+    uint32_t elapsed = esp_timer_get_time() - start;
+
+    transferCount++;
+    transferTime += elapsed;
+    maxTransferTime = std::max(maxTransferTime, elapsed);
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "frame_differ.h"
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#ifndef OLED_I2C_CLOCK
+#define OLED_I2C_CLOCK 400000 ///< OLEDのI2Cクロック (Hz)。SSD1306 の仕様上の最大は 400kHz
+#endif
+
+/**
+ * @brief 描画と転送を分け、I2Cの転送を専用タスクで行うOLEDディスプレイ
+ *
+ * 描画用・転送待ち・転送中の3つのフレームバッファを持ち、U8G2 は描画用のバッファに描きます。
+ * present() は描画用と転送待ちのバッファのポインタを入れ替えて転送タスクに通知するだけで、I2Cの転送を待ちません。
+ * 転送タスクは転送待ちのフレームを転送中のバッファと入れ替え、FrameDiffer で変化したタイルだけを送ります。
+ * 転送中に次のフレームが届いた場合は、転送待ちのフレームを新しいものに置き換えます（古いフレームは送りません）。
+ *
+ * 描画と転送の時間は別々に計測します。ディスプレイのバッファが BUFFER_SIZE より大きい場合や、
+ * タスクを作成できなかった場合は、present() の中で同期的に転送します。
+ */
+class AsyncDisplay final
+{
+public:
+    constexpr static uint32_t BUS_CLOCK = OLED_I2C_CLOCK;               ///< I2Cクロック (Hz)
+    constexpr static size_t BUFFER_SIZE = FrameDiffer::MAX_BUFFER_SIZE; ///< 追加のフレームバッファ1つのバイト数
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param oled OLEDディスプレイオブジェクトへの参照
+     * @param stackSize 転送タスクのスタックサイズ（バイト）
+     * @param priority 転送タスクの優先度
+     */
+    explicit AsyncDisplay(U8G2 &oled, uint32_t stackSize = 2048, UBaseType_t priority = tskIDLE_PRIORITY + 1)
+        : oled(oled), frameDiffer(oled), stackSize(stackSize), priority(priority)
+    {
+    }
+
+    /**
+     * @brief ディスプレイを初期化し、転送タスクを起動する
+     *
+     * I2Cクロックを設定してから初期化し、画面を消去します。
+     *
+     * @return true 非同期で転送できる
+     * @return false 同期的に転送する（バッファが大きすぎる、またはタスクの作成に失敗）
+     */
+    bool begin();
+
+    /**
+     * @brief 描画を始める（バッファを消去する）
+     *
+     * oled.clearBuffer() の代わりに呼び出してください。
+     */
+    void beginFrame();
+
+    /**
+     * @brief 描画したフレームを転送タスクに渡す
+     *
+     * oled.sendBuffer() の代わりに呼び出してください。
+     */
+    void present();
+
+    /**
+     * @brief 転送中、または転送待ちのフレームがあるかどうか
+     *
+     * 転送中にライトスリープするとI2Cの転送が止まるため、スリープの前に確認します。
+     * 転送タスクと同じミューテックスを取得して読むため、転送を受け取る途中の状態は見えません。
+     */
+    bool isBusy() const;
+
+    /**
+     * @brief 転送が終わるのを待ってから、ディスプレイの省電力モードを切り替える
+     *
+     * @param enabled 省電力モードにする（表示を消す）場合は true
+     */
+    void setPowerSave(bool enabled);
+
+    /**
+     * @brief 画面転送の差分を取得する（転送統計の表示用）
+     */
+    const FrameDiffer &getFrameDiffer() const
+    {
+        return frameDiffer;
+    }
+
+    /**
+     * @brief present() したフレーム数を取得する
+     */
+    uint32_t getFrameCount() const
+    {
+        return frameCount;
+    }
+
+    /**
+     * @brief 転送する前に次のフレームに置き換えられたフレーム数を取得する
+     */
+    uint32_t getDroppedCount() const
+    {
+        return droppedCount;
+    }
+
+    /**
+     * @brief 描画にかかった時間の合計を取得する（beginFrame() から present() まで）
+     *
+     * @return uint64_t 時間（マイクロ秒）
+     */
+    uint64_t getRenderTime() const
+    {
+        return renderTime;
+    }
+
+    /**
+     * @brief 描画にかかった最長の時間を取得する
+     *
+     * @return uint32_t 時間（マイクロ秒）
+     */
+    uint32_t getMaxRenderTime() const
+    {
+        return maxRenderTime;
+    }
+
+    /**
+     * @brief 転送したフレーム数を取得する
+     */
+    uint32_t getTransferCount() const
+    {
+        return transferCount;
+    }
+
+    /**
+     * @brief 転送にかかった時間の合計を取得する
+     *
+     * @return uint64_t 時間（マイクロ秒）
+     */
+    uint64_t getTransferTime() const
+    {
+        return transferTime;
+    }
+
+    /**
+     * @brief 転送にかかった最長の時間を取得する
+     *
+     * @return uint32_t 時間（マイクロ秒）
+     */
+    uint32_t getMaxTransferTime() const
+    {
+        return maxTransferTime;
+    }
+
+private:
+    U8G2 &oled;                        ///< OLEDディスプレイ
+    FrameDiffer frameDiffer;           ///< 変化したタイルだけの画面転送
+    uint32_t stackSize;                ///< 転送タスクのスタックサイズ
+    UBaseType_t priority;              ///< 転送タスクの優先度
+    TaskHandle_t task = nullptr;       ///< 転送タスクのハンドル
+    SemaphoreHandle_t mutex = nullptr; ///< バッファのポインタの入れ替えと転送の状態を保護するミューテックス
+
+    uint8_t buffers[2][BUFFER_SIZE] = {}; ///< 転送待ち・転送中に使う追加のフレームバッファ
+    uint8_t *drawing = nullptr;           ///< 描画用のバッファ（U8G2 が描き込む）
+    uint8_t *ready = nullptr;             ///< 転送待ちのバッファ
+    uint8_t *sending = nullptr;           ///< 転送中のバッファ
+    bool pending = false;                 ///< 転送待ちのフレームがあるかどうか（mutex で保護）
+    bool transferring = false;            ///< 転送中かどうか（mutex で保護）
+
+    int64_t frameStart = 0;       ///< 描画を始めた時刻（マイクロ秒）
+    uint32_t frameCount = 0;      ///< present() したフレーム数
+    uint32_t droppedCount = 0;    ///< 転送する前に置き換えられたフレーム数
+    uint64_t renderTime = 0;      ///< 描画にかかった時間の合計（マイクロ秒）
+    uint32_t maxRenderTime = 0;   ///< 描画にかかった最長の時間（マイクロ秒）
+    uint32_t transferCount = 0;   ///< 転送したフレーム数
+    uint64_t transferTime = 0;    ///< 転送にかかった時間の合計（マイクロ秒）
+    uint32_t maxTransferTime = 0; ///< 転送にかかった最長の時間（マイクロ秒）
+
+    /**
+     * @brief 転送タスクのエントリーポイント
+     */
+    static void taskEntry(void *arg);
+
+    /**
+     * @brief 転送待ちのフレームを受け取って送り続ける
+     */
+    void run();
+
+    /**
+     * @brief フレームを送り、転送時間を計測する
+     *
+     * @param frame 送るフレーム
+     */
+    void transfer(const uint8_t *frame);
+};
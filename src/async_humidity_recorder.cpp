@@ -0,0 +1,209 @@
+#include "async_humidity_recorder.h"
+#include "profiler.h"
+
+bool AsyncHumidityRecorder::begin()
+{
+    if (task)
+    {
+        return true;
+    }
+
+    mutex = xSemaphoreCreateMutex();
+    queue = xQueueCreate(QUEUE_LENGTH, sizeof(Message));
+    if (!mutex || !queue)
+    {
+        return false;
+    }
+
+    return xTaskCreate(taskEntry, "recorder", stackSize, this, priority, &task) == pdPASS;
+}
+
+bool AsyncHumidityRecorder::save(const HumidityData &data)
+{
+    if (!task)
+    {
+        // タスク起動前は同期的に保存する（保存タスクはまだないため、PHASE_SAVE が重なることはない）
+        PROFILE_PHASE(PHASE_SAVE);
+        CpuBoost boost(governor);
+        mirror = data;
+        enqueuedCount = data.count;
+        return inner.save(data);
+    }
+
+    // 以前にメッセージを破棄した場合は、差分ではなくデータ全体でミラーを作り直す
+    if (dirty)
+    {
+        return resync(data);
+    }
+
+    // 前回より累計数が減っていればクリアされている
+    if (data.count < enqueuedCount)
+    {
+        Message message = {Message::Type::Clear, 0, 0, 0, 0, generation};
+        dirty = xQueueSend(queue, &message, 0) != pdTRUE;
+        enqueuedCount = 0;
+    }
+
+    // 追加されたデータを古い順に積む（通常は1件、積めなかった時点でやめる）
+    if (!dirty)
+    {
+        data.visitNewest(data.count - enqueuedCount, 0, [&](size_t index, uint32_t timestamp) {
+            Message message = {Message::Type::Sample, data.items[index], data.events[index], data.intervals[index],
+                               timestamp, generation};
+            dirty = xQueueSend(queue, &message, 0) != pdTRUE;
+            return !dirty;
+        });
+    }
+    enqueuedCount = data.count;
+
+    // 破棄したメッセージの分だけミラーが食い違うため、データ全体から作り直す（保存中ならその次の save() で）
+    if (dirty)
+    {
+        droppedCount++;
+        return resync(data);
+    }
+    return true;
+}
+
+bool AsyncHumidityRecorder::resync(const HumidityData &data)
+{
+    if (xSemaphoreTake(mutex, 0) != pdTRUE)
+    {
+        return false;
+    }
+
+    // キューに残っている差分はコピーに含まれるため捨て、受信済みで反映前のものは世代で見分けて無視させる
+    xQueueReset(queue);
+    generation++;
+    mirror = data;
+    enqueuedCount = data.count;
+
+    Message message = {Message::Type::Snapshot, 0, 0, 0, 0, generation};
+    xQueueSend(queue, &message, 0);
+    xSemaphoreGive(mutex);
+
+    dirty = false;
+    resyncCount++;
+    return true;
+}
+
+bool AsyncHumidityRecorder::load(HumidityData &data)
+{
+    return loadRecent(data, HumidityData::RECORD_SIZE);
+}
+
+bool AsyncHumidityRecorder::loadRecent(HumidityData &data, size_t recent)
+{
+    // 保存タスクが保存中の場合は、SDカードへの書き込みを待たずに戻る
+    if (mutex && xSemaphoreTake(mutex, 0) != pdTRUE)
+    {
+        return false;
+    }
+
+    bool ok = inner.loadRecent(data, recent);
+    if (ok)
+    {
+        mirror = data;
+    }
+    enqueuedCount = data.count;
+
+    if (mutex)
+    {
+        xSemaphoreGive(mutex);
+    }
+    return ok;
+}
+
+bool AsyncHumidityRecorder::loadOlder(HumidityData &data, size_t maxSamples)
+{
+    // 保存タスクが保存中の場合は、何も読み込まずに戻る（呼び出し元は次の機会に再び読み込む）
+    if (mutex && xSemaphoreTake(mutex, 0) != pdTRUE)
+    {
+        return false;
+    }
+
+    bool done = inner.loadOlder(data, maxSamples);
+
+    // ヘッド位置はミラーと一致しているため、配列だけをコピーすればよい
+    // （読み込み中に追加されたデータはキュー経由で同じ位置に同じ値が書き込まれる）
+    memcpy(mirror.items, data.items, sizeof(mirror.items));
+    memcpy(mirror.intervals, data.intervals, sizeof(mirror.intervals));
+    memcpy(mirror.events, data.events, sizeof(mirror.events));
+
+    if (mutex)
+    {
+        xSemaphoreGive(mutex);
+    }
+    return done;
+}
+
+void AsyncHumidityRecorder::taskEntry(void *arg)
+{
+    static_cast<AsyncHumidityRecorder *>(arg)->run();
+}
+
+void AsyncHumidityRecorder::apply(const Message &message)
+{
+    if (message.generation != generation)
+    {
+        return;
+    }
+
+    switch (message.type)
+    {
+    case Message::Type::Sample:
+        mirror.pushRecord(message.sample, message.timestamp, message.interval, message.events);
+        break;
+    case Message::Type::Clear:
+        mirror.clear();
+        break;
+    case Message::Type::Snapshot:
+        break;
+    }
+}
+
+void AsyncHumidityRecorder::run()
+{
+    Message message;
+    bool pending = false; // 保存に失敗して再試行待ちのデータがあるか
+
+    for (;;)
+    {
+        // メッセージが届くまで待機（再試行待ちがある場合は一定時間でタイムアウト）
+        TickType_t timeout = pending ? pdMS_TO_TICKS(RETRY_INTERVAL) : portMAX_DELAY;
+        bool received = xQueueReceive(queue, &message, timeout) == pdTRUE;
+        if (!received && !pending)
+        {
+            continue;
+        }
+
+        saving = true;
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (received)
+        {
+            apply(message);
+        }
+
+        // 溜まっているメッセージをまとめて反映し、保存は1回にする
+        while (xQueueReceive(queue, &message, 0) == pdTRUE)
+        {
+            apply(message);
+            coalescedCount++;
+        }
+
+        // 失敗した場合、データはミラーに残り次回の保存でまとめて書き込まれる
+        {
+            PROFILE_PHASE(PHASE_SAVE);
+            governor.boost();
+            pending = !inner.save(mirror);
+            governor.release();
+        }
+        if (pending)
+        {
+            failedCount++;
+        }
+        saveCount++;
+        xSemaphoreGive(mutex);
+        saving = false;
+    }
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "cpu_frequency_governor.h"
+#include "humidity_recorder.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+/**
+ * @brief 保存処理を専用タスクで非同期に行う湿度レコーダーのデコレーター
+ *
+ * save() は前回呼び出し以降に追加されたデータをキューへ積むだけで即座に戻ります。
+ * 専用の FreeRTOS タスクがキューを取り出して内部のミラーに反映し、
+ * 溜まっていた保存要求をまとめて1回の save() としてラップ対象のレコーダーに渡します。
+ * 保存に失敗した場合は RETRY_INTERVAL ごとに再試行し、SDカードが戻った時点で書き込まれます。
+ *
+ * キューが満杯でメッセージを破棄した場合、差分だけではミラーがデータと一致しなくなる（破棄したクリアは保存されない）ため、
+ * 次の save() で差分の代わりにデータ全体をミラーへコピーし直します。コピーは保存タスクが保存中でない間にだけ行い、
+ * 保存中の場合は待たずにその次の save() で再び試みます。
+ *
+ * ミューテックスはミラーとラップ対象のレコーダーを保護し、保存タスクは保存の間これを保持します。
+ * 読み込み（loadRecent() / loadOlder()）は保存中なら待たずに戻るため、SDカードへの書き込みでメインループが止まりません。
+ *
+ * ミラーとして HumidityData を1つ保持するため、その分のRAM（40KB、HUMIDITY_SAMPLE_BITS=8 では32KB）を消費します。
+ */
+class AsyncHumidityRecorder final : public IHumidityRecorder
+{
+public:
+    constexpr static size_t QUEUE_LENGTH = 16;       ///< キューに保持できる最大データ数
+    constexpr static uint32_t RETRY_INTERVAL = 10000; ///< 保存失敗時の再試行間隔（10秒）
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param inner 実際の保存処理を行うレコーダーへの参照
+     * @param governor 保存の間にCPU周波数を上げるガバナーへの参照
+     * @param stackSize 保存タスクのスタックサイズ（バイト）
+     * @param priority 保存タスクの優先度
+     */
+    AsyncHumidityRecorder(IHumidityRecorder &inner, CpuFrequencyGovernor &governor, uint32_t stackSize = 4096,
+                          UBaseType_t priority = tskIDLE_PRIORITY + 1)
+        : inner(inner), governor(governor), stackSize(stackSize), priority(priority)
+    {
+    }
+
+    /**
+     * @brief 保存タスクを起動する
+     *
+     * setup() 関数内で呼び出してください。起動前の save() は同期的に処理されます。
+     *
+     * @return true 起動成功
+     * @return false キューまたはタスクの作成に失敗
+     */
+    bool begin();
+
+    /**
+     * @brief 新しいデータを保存キューへ積む
+     *
+     * キューが満杯の場合、積めなかったメッセージは破棄してドロップ数に加算し、データ全体からミラーを作り直します。
+     *
+     * @param data 保存する湿度データ
+     * @return true すべてのデータをキューに積めた、またはミラーを作り直した
+     * @return false メッセージを破棄し、ミラーをまだ作り直せていない
+     */
+    bool save(const HumidityData &data) override;
+
+    /**
+     * @brief ラップ対象のレコーダーから同期的にデータを読み込む
+     *
+     * 読み込んだ内容はミラーにも反映されます。保存タスクが保存中の場合は待たずに失敗します。
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @return true 読み込み成功
+     * @return false 読み込み失敗、または保存中
+     */
+    bool load(HumidityData &data) override;
+
+    /**
+     * @brief ラップ対象のレコーダーから最新のデータだけを同期的に読み込む
+     *
+     * 保存タスクが保存中の場合は待たずに失敗します（起動時は保存タスクの起動前に呼び出すため待つことはありません）。
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @param recent 最低限読み込む最新データ数
+     * @return true 読み込み成功
+     * @return false 読み込み失敗、または保存中
+     */
+    bool loadRecent(HumidityData &data, size_t recent) override;
+
+    /**
+     * @brief ラップ対象のレコーダーから古いデータを読み込み、ミラーにも反映する
+     *
+     * 保存タスクが保存中の場合は待たずに、何も読み込まずに false を返します（読み込み済みのデータ数が増えないことで分かります）。
+     *
+     * @param[out] data loadRecent() に渡した湿度データ構造体
+     * @param maxSamples 今回読み込む最大データ数の目安
+     * @return true すべて読み込み終えた
+     * @return false まだ読み込むデータが残っている
+     */
+    bool loadOlder(HumidityData &data, size_t maxSamples) override;
+
+    /**
+     * @brief 読み込み済みのデータ数を取得する
+     */
+    size_t getLoadedCount() const override
+    {
+        return inner.getLoadedCount();
+    }
+
+    /**
+     * @brief 保存待ちのデータ数を取得する
+     */
+    size_t getQueueDepth() const
+    {
+        return queue ? uxQueueMessagesWaiting(queue) : 0;
+    }
+
+    /**
+     * @brief 保存タスクが処理中、または処理待ちのデータがあるかどうか
+     *
+     * 処理中にライトスリープすると保存タスクが止まるため、スリープの前に確認します。
+     */
+    bool isBusy() const
+    {
+        return saving || (queue && uxQueueMessagesWaiting(queue) > 0);
+    }
+
+    /**
+     * @brief キューが満杯でメッセージを破棄した回数を取得する
+     */
+    uint32_t getDroppedCount() const
+    {
+        return droppedCount;
+    }
+
+    /**
+     * @brief データ全体からミラーを作り直した回数を取得する
+     */
+    uint32_t getResyncCount() const
+    {
+        return resyncCount;
+    }
+
+    /**
+     * @brief ラップ対象のレコーダーで実行した保存回数を取得する
+     */
+    uint32_t getSaveCount() const
+    {
+        return saveCount;
+    }
+
+    /**
+     * @brief 他の保存要求とまとめられた保存要求の数を取得する
+     */
+    uint32_t getCoalescedCount() const
+    {
+        return coalescedCount;
+    }
+
+    /**
+     * @brief ラップ対象のレコーダーで失敗した保存回数を取得する
+     */
+    uint32_t getFailedCount() const
+    {
+        return failedCount;
+    }
+
+private:
+    /**
+     * @brief 保存タスクへ渡すメッセージ
+     */
+    struct Message
+    {
+        enum class Type : uint8_t
+        {
+            Sample,   ///< データの追加
+            Clear,    ///< データのクリア
+            Snapshot, ///< ミラーを作り直した（反映するものはなく、保存だけを行う）
+        };
+
+        Type type;                   ///< メッセージ種別
+        HumidityData::Sample sample; ///< 追加する湿度データ（Sample のみ）
+        uint8_t events;              ///< イベントのビットフラグ（Sample のみ）
+        uint16_t interval;           ///< 前のデータからの経過秒数（Sample のみ）
+        uint32_t timestamp;          ///< 記録した時刻（Sample のみ）
+        uint8_t generation;          ///< 積んだときのミラーの世代（作り直す前の世代のメッセージは反映しない）
+    };
+
+    IHumidityRecorder &inner;       ///< 実際の保存処理を行うレコーダー
+    CpuFrequencyGovernor &governor; ///< CPU周波数のガバナー
+    uint32_t stackSize;             ///< 保存タスクのスタックサイズ
+    UBaseType_t priority;           ///< 保存タスクの優先度
+
+    HumidityData mirror;                ///< 保存タスクが保持するデータのミラー
+    QueueHandle_t queue = nullptr;      ///< 保存タスクへのメッセージキュー
+    SemaphoreHandle_t mutex = nullptr;  ///< ミラーを保護するミューテックス
+    TaskHandle_t task = nullptr;        ///< 保存タスクのハンドル
+    uint32_t enqueuedCount = 0;         ///< キューに積んだ時点での累計データ数
+    uint8_t generation = 0;             ///< ミラーの世代（作り直すたびに増やす、ミューテックスで保護）
+    bool dirty = false;                 ///< メッセージを破棄し、ミラーを作り直す必要があるか
+
+    volatile uint32_t droppedCount = 0;   ///< メッセージを破棄した回数
+    volatile uint32_t resyncCount = 0;    ///< ミラーを作り直した回数
+    volatile uint32_t saveCount = 0;      ///< 保存回数
+    volatile uint32_t coalescedCount = 0; ///< まとめられた保存要求の数
+    volatile uint32_t failedCount = 0;    ///< 失敗した保存回数
+    volatile bool saving = false;         ///< 保存タスクがメッセージを処理中かどうか
+
+    /**
+     * @brief 保存タスクのエントリーポイント
+     */
+    static void taskEntry(void *arg);
+
+    /**
+     * @brief 保存タスクの本体
+     */
+    void run();
+
+    /**
+     * @brief メッセージをミラーへ反映する（作り直す前の世代のメッセージは無視する）
+     */
+    void apply(const Message &message);
+
+    /**
+     * @brief データ全体をミラーへコピーし、キューに残っている差分を捨てて保存タスクに保存させる
+     *
+     * 保存タスクが保存中の場合は待たずに戻ります。
+     *
+     * @return true 作り直した
+     * @return false 保存中のため作り直せなかった
+     */
+    bool resync(const HumidityData &data);
+};
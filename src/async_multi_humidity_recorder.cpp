@@ -0,0 +1,206 @@
+#include "async_multi_humidity_recorder.h"
+#include "profiler.h"
+
+bool AsyncMultiHumidityRecorder::begin()
+{
+    if (task)
+    {
+        return true;
+    }
+
+    mutex = xSemaphoreCreateMutex();
+    queue = xQueueCreate(QUEUE_LENGTH, sizeof(Message));
+    if (!mutex || !queue)
+    {
+        return false;
+    }
+
+    return xTaskCreate(taskEntry, "recorder", stackSize, this, priority, &task) == pdPASS;
+}
+
+bool AsyncMultiHumidityRecorder::save(const MultiHumidityData &data)
+{
+    if (!task)
+    {
+        // タスク起動前は同期的に保存する（保存タスクはまだないため、PHASE_SAVE が重なることはない）
+        PROFILE_PHASE(PHASE_SAVE);
+        CpuBoost boost(governor);
+        mirror = data;
+        enqueuedCount = data.count;
+        return inner.save(data);
+    }
+
+    // 以前にメッセージを破棄した場合は、差分ではなくデータ全体でミラーを作り直す
+    if (dirty)
+    {
+        return resync(data);
+    }
+
+    // 前回より累計数が減っていればクリアされている
+    if (data.count < enqueuedCount)
+    {
+        Message message = {};
+        message.type = Message::Type::Clear;
+        message.generation = generation;
+        dirty = xQueueSend(queue, &message, 0) != pdTRUE;
+        enqueuedCount = 0;
+    }
+
+    // 追加された行を古い順に積む（通常は1行、積めなかった時点でやめる）
+    // 各行の時刻は、最新の行の時刻から新しい行の記録間隔をさかのぼって求める
+    uint32_t newRows = std::min<uint32_t>(data.count - enqueuedCount, MultiHumidityData::RECORD_SIZE);
+    uint32_t timestamp = data.newestTime;
+    for (uint32_t i = 0; i + 1 < newRows; i++)
+    {
+        uint16_t interval = data.intervals[data.position(i)];
+        timestamp -= interval == MultiHumidityData::INTERVAL_UNKNOWN ? 0 : interval;
+    }
+    for (uint32_t i = newRows; i-- > 0 && !dirty;)
+    {
+        size_t position = data.position(i);
+        if (i + 1 < newRows)
+        {
+            uint16_t interval = data.intervals[position];
+            timestamp += interval == MultiHumidityData::INTERVAL_UNKNOWN ? 0 : interval;
+        }
+
+        Message message = {};
+        message.type = Message::Type::Row;
+        message.generation = generation;
+        message.events = data.events[position];
+        message.pumps = data.pumps[position];
+        message.interval = data.intervals[position];
+        message.timestamp = timestamp;
+        for (size_t channel = 0; channel < MultiHumidityData::CHANNELS; channel++)
+        {
+            message.humidity[channel] = data.humidity[channel][position];
+        }
+        dirty = xQueueSend(queue, &message, 0) != pdTRUE;
+    }
+    enqueuedCount = data.count;
+
+    // 破棄したメッセージの分だけミラーが食い違うため、データ全体から作り直す（保存中ならその次の save() で）
+    if (dirty)
+    {
+        droppedCount++;
+        return resync(data);
+    }
+    return true;
+}
+
+bool AsyncMultiHumidityRecorder::resync(const MultiHumidityData &data)
+{
+    if (xSemaphoreTake(mutex, 0) != pdTRUE)
+    {
+        return false;
+    }
+
+    // キューに残っている差分はコピーに含まれるため捨て、受信済みで反映前のものは世代で見分けて無視させる
+    xQueueReset(queue);
+    generation++;
+    mirror = data;
+    enqueuedCount = data.count;
+
+    Message message = {};
+    message.type = Message::Type::Snapshot;
+    message.generation = generation;
+    xQueueSend(queue, &message, 0);
+    xSemaphoreGive(mutex);
+
+    dirty = false;
+    resyncCount++;
+    return true;
+}
+
+bool AsyncMultiHumidityRecorder::load(MultiHumidityData &data)
+{
+    // 保存タスクが保存中の場合は、SDカードへの書き込みを待たずに戻る
+    if (mutex && xSemaphoreTake(mutex, 0) != pdTRUE)
+    {
+        return false;
+    }
+
+    bool ok = inner.load(data);
+    if (ok)
+    {
+        mirror = data;
+    }
+    enqueuedCount = data.count;
+
+    if (mutex)
+    {
+        xSemaphoreGive(mutex);
+    }
+    return ok;
+}
+
+void AsyncMultiHumidityRecorder::taskEntry(void *arg)
+{
+    static_cast<AsyncMultiHumidityRecorder *>(arg)->run();
+}
+
+void AsyncMultiHumidityRecorder::apply(const Message &message)
+{
+    if (message.generation != generation)
+    {
+        return;
+    }
+
+    switch (message.type)
+    {
+    case Message::Type::Row:
+        mirror.pushRecord(message.humidity, message.timestamp, message.interval, message.events, message.pumps);
+        break;
+    case Message::Type::Clear:
+        mirror.clear();
+        break;
+    case Message::Type::Snapshot:
+        break;
+    }
+}
+
+void AsyncMultiHumidityRecorder::run()
+{
+    Message message;
+    bool pending = false; // 保存に失敗して再試行待ちのデータがあるか
+
+    for (;;)
+    {
+        // メッセージが届くまで待機（再試行待ちがある場合は一定時間でタイムアウト）
+        TickType_t timeout = pending ? pdMS_TO_TICKS(RETRY_INTERVAL) : portMAX_DELAY;
+        bool received = xQueueReceive(queue, &message, timeout) == pdTRUE;
+        if (!received && !pending)
+        {
+            continue;
+        }
+
+        saving = true;
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (received)
+        {
+            apply(message);
+        }
+
+        // 溜まっているメッセージをまとめて反映し、保存は1回にする
+        while (xQueueReceive(queue, &message, 0) == pdTRUE)
+        {
+            apply(message);
+            coalescedCount++;
+        }
+
+        // 失敗した場合、データはミラーに残り次回の保存でまとめて書き込まれる
+        {
+            PROFILE_PHASE(PHASE_SAVE);
+            governor.boost();
+            pending = !inner.save(mirror);
+            governor.release();
+        }
+        if (pending)
+        {
+            failedCount++;
+        }
+        saveCount++;
+        xSemaphoreGive(mutex);
+        saving = false;
+    }
+}
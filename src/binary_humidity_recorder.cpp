@@ -0,0 +1,368 @@
+#include "binary_humidity_recorder.h"
+#include <esp_rom_crc.h>
+
+namespace
+{
+/**
+ * @brief ヘッダのCRCを計算する（crcフィールド自身は除く）
+ */
+template <typename Header> uint32_t headerCrc(const Header &header)
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&header), offsetof(Header, crc));
+}
+} // namespace
+
+bool BinarySDHumidityRecorder::save(const HumidityData &data)
+{
+    // 読み込み中は未読み込みの古いデータを上書きしないよう保存しない
+    if (loading || !card.ensureMounted())
+    {
+        return false;
+    }
+
+    // 再マウントされた場合はカードが差し替えられた可能性があるため全体を書き直す
+    if (card.getMountGeneration() != syncedGeneration)
+    {
+        synced = false;
+    }
+
+    uint32_t start = micros();
+    bool ok = write(data);
+    card.recordLatency(micros() - start);
+
+    if (!ok)
+    {
+        // 書き込みに失敗した場合はカードが抜かれた可能性がある
+        card.reportFailure();
+    }
+    return ok;
+}
+
+bool BinarySDHumidityRecorder::load(HumidityData &data)
+{
+    return loadRecent(data, HumidityData::RECORD_SIZE);
+}
+
+bool BinarySDHumidityRecorder::loadRecent(HumidityData &data, size_t recent)
+{
+    if (!card.ensureMounted())
+    {
+        return false;
+    }
+
+    uint32_t start = micros();
+    bool ok = readHeader(data) && readSectors(data, recent);
+    card.recordLatency(micros() - start);
+
+    if (!ok)
+    {
+        loading = false;
+    }
+    return ok;
+}
+
+bool BinarySDHumidityRecorder::loadOlder(HumidityData &data, size_t maxSamples)
+{
+    if (!loading)
+    {
+        return true;
+    }
+
+    // 読み込み中にクリアされた場合やカードが使えなくなった場合は中断する
+    if (data.count < loadCount || !card.ensureMounted())
+    {
+        loading = false;
+        synced = false;
+        return true;
+    }
+
+    uint32_t start = micros();
+    bool ok = readSectors(data, getLoadedCount() + maxSamples);
+    card.recordLatency(micros() - start);
+
+    if (!ok)
+    {
+        loading = false;
+        synced = false;
+        card.reportFailure();
+    }
+    return !loading;
+}
+
+uint32_t BinarySDHumidityRecorder::sectorCrc(const DataSector &sector, size_t sectorIndex)
+{
+    return esp_rom_crc32_le(sectorIndex, reinterpret_cast<const uint8_t *>(&sector), offsetof(DataSector, crc));
+}
+
+bool BinarySDHumidityRecorder::writeDataSector(fs::File &file, const HumidityData &data, size_t sectorIndex)
+{
+    DataSector sector = {};
+
+    // リングバッファの該当範囲をコピー（最終セクタの余りはゼロ埋め）
+    size_t first = sectorIndex * SAMPLES_PER_SECTOR;
+    size_t n = std::min(SAMPLES_PER_SECTOR, HumidityData::RECORD_SIZE - first);
+    memcpy(sector.intervals, &data.intervals[first], n * sizeof(uint16_t));
+    memcpy(sector.samples, &data.items[first], n * sizeof(HumidityData::Sample));
+    memcpy(sector.events, &data.events[first], n * sizeof(uint8_t));
+
+    // セクタ番号をシードにすることで、別の位置に書かれたセクタも検出できる
+    sector.crc = sectorCrc(sector, sectorIndex);
+
+    if (!file.seek((HEADER_SECTOR_COUNT + sectorIndex) * SECTOR_SIZE))
+    {
+        return false;
+    }
+    return file.write(reinterpret_cast<const uint8_t *>(&sector), SECTOR_SIZE) == SECTOR_SIZE;
+}
+
+bool BinarySDHumidityRecorder::writeHeader(fs::File &file, const HumidityData &data)
+{
+    uint8_t buffer[SECTOR_SIZE] = {};
+
+    FileHeader header = {};
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    header.sampleSize = sizeof(HumidityData::Sample);
+    header.recordSize = HumidityData::RECORD_SIZE;
+    header.samplesPerSector = SAMPLES_PER_SECTOR;
+    header.head = data.head;
+    header.count = data.count;
+    header.newestTime = data.newestTime;
+    header.sequence = headerSequence + 1;
+    header.crc = headerCrc(header);
+    memcpy(buffer, &header, sizeof(header));
+
+    // 失敗した場合は番号を進めず、次回も同じセクタに書き込む（最後に書き込めたヘッダは上書きしない）
+    if (!file.seek((header.sequence % HEADER_SECTOR_COUNT) * SECTOR_SIZE) ||
+        file.write(buffer, SECTOR_SIZE) != SECTOR_SIZE)
+    {
+        return false;
+    }
+    headerSequence = header.sequence;
+    return true;
+}
+
+bool BinarySDHumidityRecorder::rewriteAll(const HumidityData &data)
+{
+    // ファイルを作り直して全セクタを確保する
+    fs::File file = card.fs().open(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < DATA_SECTOR_COUNT && ok; i++)
+    {
+        ok = writeDataSector(file, data, i);
+    }
+
+    // ヘッダはデータの後に書き込み、未完成のファイルが有効とみなされないようにする
+    // （両方のコピーを書き込み、以前のファイルのヘッダがもう一方のセクタに残らないようにする）
+    for (size_t i = 0; i < HEADER_SECTOR_COUNT && ok; i++)
+    {
+        ok = writeHeader(file, data);
+    }
+    file.close();
+
+    return ok;
+}
+
+bool BinarySDHumidityRecorder::write(const HumidityData &data)
+{
+    uint32_t newSamples = data.count - savedCount;
+    bool needsRewrite = !synced ||                                                            // ファイルの内容が不明
+                        data.count < savedCount ||                                            // データがクリアされた
+                        newSamples >= HumidityData::RECORD_SIZE ||                            // 全体が入れ替わった
+                        (savedHead + newSamples) % HumidityData::RECORD_SIZE != data.head;           // ヘッドの整合性が取れない
+
+    bool ok;
+    if (needsRewrite)
+    {
+        ok = rewriteAll(data);
+    }
+    else
+    {
+        fs::File file = card.fs().open(path, "r+");
+        if (!file)
+        {
+            synced = false;
+            return false;
+        }
+
+        // 新しいデータを含むセクタのみを書き込む
+        ok = true;
+        size_t index = savedHead;
+        size_t remaining = newSamples;
+        while (remaining > 0 && ok)
+        {
+            size_t sectorIndex = index / SAMPLES_PER_SECTOR;
+            ok = writeDataSector(file, data, sectorIndex);
+
+            size_t sectorEnd = std::min((sectorIndex + 1) * SAMPLES_PER_SECTOR, HumidityData::RECORD_SIZE);
+            size_t n = std::min(sectorEnd - index, remaining);
+            remaining -= n;
+            index = (index + n) % HumidityData::RECORD_SIZE;
+        }
+
+        // 最後にヘッド位置を更新
+        ok = ok && writeHeader(file, data);
+        file.close();
+    }
+
+    synced = ok;
+    if (ok)
+    {
+        syncedGeneration = card.getMountGeneration();
+        savedHead = data.head;
+        savedCount = data.count;
+    }
+    return ok;
+}
+
+bool BinarySDHumidityRecorder::readHeader(HumidityData &data)
+{
+    // ファイルを開く
+    fs::File file = card.fs().open(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    if (file.size() < (HEADER_SECTOR_COUNT + DATA_SECTOR_COUNT) * SECTOR_SIZE)
+    {
+        // ファイルサイズが不足している場合は失敗
+        file.close();
+        return false;
+    }
+
+    // 2つのヘッダを読み込み、有効なもののうちシーケンス番号が新しい方を使う
+    // （書き込み途中で電源が落ちたヘッダはCRCが一致しないため、1つ前のヘッダが使われる）
+    uint8_t buffer[SECTOR_SIZE];
+    FileHeader header = {};
+    bool found = false;
+    for (size_t i = 0; i < HEADER_SECTOR_COUNT; i++)
+    {
+        FileHeader candidate;
+        if (file.read(buffer, SECTOR_SIZE) != SECTOR_SIZE)
+        {
+            break;
+        }
+        memcpy(&candidate, buffer, sizeof(candidate));
+
+        if (isValidHeader(candidate) && (!found || static_cast<int32_t>(candidate.sequence - header.sequence) > 0))
+        {
+            header = candidate;
+            found = true;
+        }
+    }
+    file.close();
+
+    if (!found)
+    {
+        return false;
+    }
+    headerSequence = header.sequence;
+
+    data.head = header.head;
+    data.count = header.count;
+    data.newestTime = header.newestTime;
+
+    // 最新データを含むセクタから古い方へ向かって読み込む
+    loading = true;
+    loadHead = header.head;
+    loadCount = header.count;
+    loadStartSector = ((header.head + HumidityData::RECORD_SIZE - 1) % HumidityData::RECORD_SIZE) / SAMPLES_PER_SECTOR;
+    loadedSectors = 0;
+    corruptSectorCount = 0;
+    return true;
+}
+
+bool BinarySDHumidityRecorder::isValidHeader(const FileHeader &header)
+{
+    return header.magic == FILE_MAGIC && header.version == FILE_VERSION && header.crc == headerCrc(header) &&
+           header.sampleSize == sizeof(HumidityData::Sample) && header.recordSize == HumidityData::RECORD_SIZE &&
+           header.samplesPerSector == SAMPLES_PER_SECTOR && header.head < HumidityData::RECORD_SIZE;
+}
+
+bool BinarySDHumidityRecorder::readSector(fs::File &file, HumidityData &data, size_t sectorIndex)
+{
+    DataSector sector;
+    size_t first = sectorIndex * SAMPLES_PER_SECTOR;
+    size_t n = std::min(SAMPLES_PER_SECTOR, HumidityData::RECORD_SIZE - first);
+
+    if (!file.seek((HEADER_SECTOR_COUNT + sectorIndex) * SECTOR_SIZE) ||
+        file.read(reinterpret_cast<uint8_t *>(&sector), SECTOR_SIZE) != SECTOR_SIZE)
+    {
+        return false;
+    }
+
+    // CRCが一致しないセクタは破棄する
+    bool valid = sector.crc == sectorCrc(sector, sectorIndex);
+    if (!valid)
+    {
+        corruptSectorCount++;
+    }
+
+    // 読み込み開始後に追加されたデータは上書きしない
+    uint32_t pushed = data.count - loadCount;
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t index = first + i;
+        if ((index + HumidityData::RECORD_SIZE - loadHead) % HumidityData::RECORD_SIZE < pushed)
+        {
+            continue;
+        }
+        data.intervals[index] = valid ? sector.intervals[i] : HumidityData::INTERVAL_UNKNOWN;
+        data.items[index] = valid ? sector.samples[i] : 0;
+        data.events[index] = valid ? sector.events[i] : 0;
+    }
+    return true;
+}
+
+bool BinarySDHumidityRecorder::readSectors(HumidityData &data, size_t target)
+{
+    fs::File file = card.fs().open(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    while (ok && loadedSectors < DATA_SECTOR_COUNT && getLoadedCount() < target)
+    {
+        size_t sectorIndex = (loadStartSector + DATA_SECTOR_COUNT - loadedSectors) % DATA_SECTOR_COUNT;
+        ok = readSector(file, data, sectorIndex);
+        loadedSectors++;
+    }
+    file.close();
+
+    if (ok && loadedSectors == DATA_SECTOR_COUNT)
+    {
+        loading = false;
+
+        // 破損セクタがあった場合は次回の保存でファイル全体を書き直す
+        synced = corruptSectorCount == 0;
+        syncedGeneration = card.getMountGeneration();
+        savedHead = loadHead;
+        savedCount = loadCount;
+    }
+    return ok;
+}
+
+size_t BinarySDHumidityRecorder::getLoadedCount() const
+{
+    if (!loading)
+    {
+        return HumidityData::RECORD_SIZE;
+    }
+    if (loadedSectors == 0)
+    {
+        return 0;
+    }
+
+    // 最も古く読み込んだセクタの先頭から、読み込み開始時点のヘッドまで
+    size_t oldestSector = (loadStartSector + DATA_SECTOR_COUNT - (loadedSectors - 1)) % DATA_SECTOR_COUNT;
+    size_t oldestIndex = oldestSector * SAMPLES_PER_SECTOR;
+    return (loadHead + HumidityData::RECORD_SIZE - oldestIndex) % HumidityData::RECORD_SIZE;
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "humidity_recorder.h"
+#include "sd_card_manager.h"
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+
+/**
+ * @brief SDカード上のバイナリリングファイルを使用した湿度データレコーダー
+ *
+ * メモリ上のリングバッファと同じ構造の固定長バイナリファイルをSDカード上に確保し、
+ * 保存時は新しいデータを含む512バイトのセクタとヘッダセクタだけを書き換えます。
+ * 各セクタにはCRCを付与しており、書き込み途中で電源が落ちたセクタは読み込み時に破棄されます。
+ * ヘッダは2つのコピーを交互に書き換え、読み込み時はCRCが一致するうちシーケンス番号が新しい方を使うため、
+ * ヘッダの書き込み途中で電源が落ちても1つ前のヘッダでファイルを読み込めます。
+ *
+ * ファイル構成:
+ * - セクタ0・1: ヘッダの2つのコピー（マジック、バージョン、ヘッド位置、累計データ数、シーケンス番号）
+ * - セクタ2〜: データセクタ（SAMPLES_PER_SECTOR 個分の記録間隔・湿度・イベントの各列 + CRC）
+ *
+ * データセクタはメモリ上と同じく列ごとの配列で構成しており、保存時は同じ範囲の全列を1セクタで書き込みます。
+ */
+class BinarySDHumidityRecorder final : public IHumidityRecorder
+{
+public:
+    constexpr static size_t SECTOR_SIZE = 512;                                            ///< SDカードのセクタサイズ
+    constexpr static size_t SAMPLES_PER_SECTOR = (SECTOR_SIZE - sizeof(uint32_t)) / (sizeof(uint16_t) + sizeof(HumidityData::Sample) + sizeof(uint8_t)); ///< 1セクタあたりのデータ数
+    constexpr static size_t DATA_SECTOR_COUNT = (HumidityData::RECORD_SIZE + SAMPLES_PER_SECTOR - 1) / SAMPLES_PER_SECTOR; ///< データセクタ数
+    constexpr static size_t HEADER_SECTOR_COUNT = 2;   ///< ヘッダのコピーの数（交互に書き込む）
+    constexpr static uint32_t FILE_MAGIC = 0x52485447; ///< ファイル識別子（"GTHR"）
+    constexpr static uint16_t FILE_VERSION = 4;        ///< ファイルフォーマットのバージョン
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param card SDカードマネージャーへの参照
+     * @param path 保存先ファイルのパス
+     */
+    explicit BinarySDHumidityRecorder(SDCardManager &card, const char *path = "/humidity_log.bin") : card(card), path(path)
+    {
+    }
+
+    /**
+     * @brief 前回の保存以降に追加されたデータを含むセクタのみをSDカードへ書き込む
+     *
+     * ファイルが存在しない場合や、データがクリアされた場合、カードが再マウントされた場合はファイル全体を書き直します。
+     * カードがない間に追加されたデータはメモリ上に残り、再マウント後の保存でまとめて書き込まれます。
+     *
+     * @param data 保存する湿度データ
+     * @return true 保存成功
+     * @return false 保存失敗
+     */
+    bool save(const HumidityData &data) override;
+
+    /**
+     * @brief SDカードからデータを読み込む
+     *
+     * CRCが一致しないセクタは書き込み途中で破損したものとみなし、ゼロで埋めます。
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @return true 読み込み成功
+     * @return false 読み込み失敗（ファイルなし、またはヘッダ不正）
+     */
+    bool load(HumidityData &data) override;
+
+    /**
+     * @brief ヘッダと、最新データを含むセクタだけを読み込む
+     *
+     * 残りのセクタは loadOlder() で新しい順に読み込みます。
+     * すべて読み込み終えるまで save() は失敗します。
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @param recent 最低限読み込む最新データ数
+     * @return true 読み込み成功
+     * @return false 読み込み失敗（ファイルなし、またはヘッダ不正）
+     */
+    bool loadRecent(HumidityData &data, size_t recent) override;
+
+    /**
+     * @brief 未読み込みのセクタを新しい順に読み込む
+     *
+     * @param[out] data loadRecent() に渡した湿度データ構造体
+     * @param maxSamples 今回読み込む最大データ数の目安（セクタ単位に切り上げ）
+     * @return true すべて読み込み終えた（または中断した）
+     * @return false まだ読み込むセクタが残っている
+     */
+    bool loadOlder(HumidityData &data, size_t maxSamples) override;
+
+    /**
+     * @brief loadRecent() 時点の最新データから数えて、読み込み済みのデータ数を取得する
+     */
+    size_t getLoadedCount() const override;
+
+    /**
+     * @brief 直前の load() で破棄された破損セクタ数を取得する
+     */
+    size_t getCorruptSectorCount() const
+    {
+        return corruptSectorCount;
+    }
+
+private:
+    /**
+     * @brief ファイルヘッダ（セクタ0・1に交互に格納）
+     */
+    struct FileHeader
+    {
+        uint32_t magic;            ///< ファイル識別子
+        uint16_t version;          ///< フォーマットバージョン
+        uint16_t sampleSize;       ///< 1データあたりのバイト数
+        uint32_t recordSize;       ///< リングバッファの要素数
+        uint32_t samplesPerSector; ///< 1セクタあたりのデータ数
+        uint32_t head;             ///< リングバッファのヘッド
+        uint32_t count;            ///< 累計データ数
+        uint32_t newestTime;       ///< 最新データの時刻（秒）
+        uint32_t sequence;         ///< 書き込むたびに増える番号（奇数はセクタ1、偶数はセクタ0に格納）
+        uint32_t crc;              ///< ヘッダのCRC（このフィールドを除く）
+    };
+
+    /**
+     * @brief データセクタ
+     */
+    struct DataSector
+    {
+        uint16_t intervals[SAMPLES_PER_SECTOR];           ///< 前のデータからの経過秒数
+        HumidityData::Sample samples[SAMPLES_PER_SECTOR]; ///< 湿度データ（エンコード済み）
+        uint8_t events[SAMPLES_PER_SECTOR];               ///< イベントのビットフラグ
+        uint32_t crc;                                     ///< セクタのCRC（セクタ番号をシードに使用）
+    };
+
+    static_assert(sizeof(FileHeader) <= SECTOR_SIZE, "FileHeader must fit in one sector");
+    static_assert(sizeof(DataSector) == SECTOR_SIZE, "DataSector must be exactly one sector");
+
+    SDCardManager &card; ///< SDカードマネージャーへの参照
+    const char *path;    ///< 保存先ファイルのパス
+
+    bool synced = false;           ///< ファイルの内容がメモリ上のデータと同期済みかどうか
+    uint32_t syncedGeneration = 0; ///< 同期したときのマウント世代
+    uint32_t savedHead = 0;        ///< 最後に保存したときのヘッド位置
+    uint32_t savedCount = 0;       ///< 最後に保存したときの累計データ数
+    size_t corruptSectorCount = 0; ///< 直前の load() で破棄された破損セクタ数
+    uint32_t headerSequence = 0;   ///< 最後に書き込んだ（または読み込んだ）ヘッダのシーケンス番号
+
+    bool loading = false;       ///< 段階的な読み込みの途中かどうか
+    uint32_t loadHead = 0;      ///< 読み込み開始時点のヘッド位置
+    uint32_t loadCount = 0;     ///< 読み込み開始時点の累計データ数
+    size_t loadStartSector = 0; ///< 最新データを含むセクタ番号
+    size_t loadedSectors = 0;   ///< 読み込み済みのセクタ数
+
+    /**
+     * @brief 前回の保存以降の変更をファイルへ書き込む
+     */
+    bool write(const HumidityData &data);
+
+    /**
+     * @brief 2つのヘッダのうち有効で新しい方を読み込み、段階的な読み込みを開始する
+     */
+    bool readHeader(HumidityData &data);
+
+    /**
+     * @brief ヘッダのCRCとフォーマットが現在のビルドと一致するかどうか
+     */
+    static bool isValidHeader(const FileHeader &header);
+
+    /**
+     * @brief 読み込み済みのデータ数が target 以上になるまでセクタを新しい順に読み込む
+     */
+    bool readSectors(HumidityData &data, size_t target);
+
+    /**
+     * @brief 指定したデータセクタを読み込む
+     *
+     * CRCが一致しないセクタはゼロで埋め、読み込み開始後に追加されたデータは上書きしません。
+     */
+    bool readSector(fs::File &file, HumidityData &data, size_t sectorIndex);
+
+    /**
+     * @brief 指定したデータセクタを書き込む
+     *
+     * @param file 書き込み先ファイル
+     * @param data 湿度データ
+     * @param sectorIndex データセクタ番号（0始まり）
+     * @return true 書き込み成功
+     * @return false 書き込み失敗
+     */
+    bool writeDataSector(fs::File &file, const HumidityData &data, size_t sectorIndex);
+
+    /**
+     * @brief ヘッダセクタを書き込む
+     *
+     * 最後に書き込んだヘッダとは別のセクタに書き込み、書き込み途中で電源が落ちても前のヘッダが残るようにします。
+     *
+     * @param file 書き込み先ファイル
+     * @param data 湿度データ
+     * @return true 書き込み成功
+     * @return false 書き込み失敗
+     */
+    bool writeHeader(fs::File &file, const HumidityData &data);
+
+    /**
+     * @brief ファイル全体を書き直す
+     *
+     * @param data 湿度データ
+     * @return true 書き込み成功
+     * @return false 書き込み失敗
+     */
+    bool rewriteAll(const HumidityData &data);
+
+    /**
+     * @brief データセクタのCRCを計算する（crcフィールド自身は除く）
+     *
+     * @param sector データセクタ
+     * @param sectorIndex データセクタ番号（CRCのシードに使用）
+     */
+    static uint32_t sectorCrc(const DataSector &sector, size_t sectorIndex);
+};
@@ -0,0 +1,169 @@
+#include "button.h"
+#include <driver/gpio.h>
+
+// 割り込みハンドラを IRAM に置かないため、フラッシュへの書き込み中も動く IRAM の割り込みとしては登録できない
+#if CONFIG_ARDUINO_ISR_IRAM
+#error "Button does not support CONFIG_ARDUINO_ISR_IRAM"
+#endif
+
+bool Button::begin()
+{
+    pinMode(pin, INPUT_PULLUP);
+    pressed = digitalRead(pin) == LOW;
+    longPressed = false;
+    lastChange = millis();
+
+    if (!settleTimer)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = onSettle;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "button settle";
+        if (esp_timer_create(&args, &settleTimer) != ESP_OK)
+        {
+            settleTimer = nullptr;
+            return false;
+        }
+    }
+
+    if (!longPressTimer)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = onLongPress;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "button long";
+        if (esp_timer_create(&args, &longPressTimer) != ESP_OK)
+        {
+            longPressTimer = nullptr;
+            return false;
+        }
+    }
+
+    attachInterruptArg(pin, onEdge, this, CHANGE);
+    return true;
+}
+
+void Button::enableWakeup()
+{
+    // スリープ中に割り込みが起きないよう止め、今と逆のレベルになったときに復帰する
+    gpio_num_t gpio = static_cast<gpio_num_t>(pin);
+    gpio_intr_disable(gpio);
+    gpio_wakeup_enable(gpio, pressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+}
+
+void Button::disableWakeup()
+{
+    // gpio_wakeup_enable() で変わった割り込みの種類を両エッジに戻す
+    gpio_num_t gpio = static_cast<gpio_num_t>(pin);
+    gpio_wakeup_disable(gpio);
+    gpio_set_intr_type(gpio, GPIO_INTR_ANYEDGE);
+    gpio_intr_enable(gpio);
+
+    portENTER_CRITICAL(&lock);
+    bool changed = applyLevel(millis());
+    bool level = pressed;
+    portEXIT_CRITICAL(&lock);
+
+    if (changed)
+    {
+        rearmLongPress(level);
+    }
+}
+
+void Button::onEdge(void *arg)
+{
+    Button *self = static_cast<Button *>(arg);
+    uint32_t now = millis();
+    bool changed = false;
+
+    portENTER_CRITICAL_ISR(&self->lock);
+
+    // 前回の変化から DEBOUNCE_TIME 以内の変化はチャタリングとみなす
+    if (now - self->lastChange >= DEBOUNCE_TIME)
+    {
+        changed = self->applyLevel(now);
+    }
+    bool level = self->pressed;
+
+    portEXIT_CRITICAL_ISR(&self->lock);
+
+    // 最後の変化から DEBOUNCE_TIME 後に、落ち着いた状態を読み直す
+    // （esp_timer_stop() / esp_timer_start_once() は割り込みから呼び出せる。ESP32-C3 はシングルコアのため、
+    //   この間にタイマーのコールバックが割り込むことはない）
+    esp_timer_stop(self->settleTimer);
+    esp_timer_start_once(self->settleTimer, DEBOUNCE_TIME * 1000);
+
+    if (changed)
+    {
+        self->rearmLongPress(level);
+    }
+}
+
+void Button::onSettle(void *arg)
+{
+    Button *self = static_cast<Button *>(arg);
+    portENTER_CRITICAL(&self->lock);
+    bool changed = self->applyLevel(millis());
+    bool level = self->pressed;
+    portEXIT_CRITICAL(&self->lock);
+
+    if (changed)
+    {
+        self->rearmLongPress(level);
+    }
+}
+
+void Button::onLongPress(void *arg)
+{
+    Button *self = static_cast<Button *>(arg);
+    portENTER_CRITICAL(&self->lock);
+    if (self->pressed && !self->longPressed)
+    {
+        self->longPressed = true;
+        self->pushEvent(EVENT_LONG_PRESS, millis());
+    }
+    portEXIT_CRITICAL(&self->lock);
+}
+
+bool Button::applyLevel(uint32_t now)
+{
+    bool level = gpio_get_level(static_cast<gpio_num_t>(pin)) == 0;
+    if (level == pressed)
+    {
+        return false;
+    }
+
+    pressed = level;
+    lastChange = now;
+    if (level)
+    {
+        longPressed = false;
+        pushEvent(EVENT_PRESS, now);
+    }
+    else
+    {
+        pushEvent(EVENT_RELEASE, now);
+    }
+    return true;
+}
+
+void Button::rearmLongPress(bool level)
+{
+    // 押されたら長押しの判定を始め、離されたら止める
+    esp_timer_stop(longPressTimer);
+    if (level)
+    {
+        esp_timer_start_once(longPressTimer, static_cast<uint64_t>(longPressDuration) * 1000);
+    }
+}
+
+void Button::pushEvent(EventType type, uint32_t now)
+{
+    Event event = {type, type == EVENT_RELEASE && longPressed, now};
+    if (!events.push(event))
+    {
+        droppedCount++;
+    }
+}
@@ -1,133 +1,181 @@
 #ifndef BUTTON_H
 #define BUTTON_H
 
+#include "spsc_queue.h"
 #include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
 
 /**
- * @brief ボタン入力を管理するクラス
+ * @brief 割り込みでボタン入力を受け取るクラス
  *
- * チャタリング除去（デバウンス）や長押し判定などの機能を提供します。
+ * GPIO の割り込み（両エッジ）で状態の変化を受け取り、押された・離された・長押しのイベントを時刻付きで
+ * キューに入れます。アプリケーションは poll() でイベントを取り出すだけで、ピンを読み続ける必要はありません。
+ * ループがスリープやSD・I2Cの処理で止まっている間に押されても、イベントを取りこぼしません。
+ *
+ * チャタリング除去（デバウンス）は時間で行います。変化を受け付けてから DEBOUNCE_TIME の間の変化は無視し、
+ * 最後の変化から DEBOUNCE_TIME 後にタイマーで状態を読み直して、落ち着いた状態と食い違っていれば受け付けます。
+ * 長押しは押された時点で設定したワンショットタイマーで判定するため、押している間も読み取りは不要です。
+ *
+ * イベントのキューは SpscQueue です。書き込み側の割り込みハンドラとタイマーのコールバックはスピンロックで排他し、
+ * 読み出し側（poll()）はロックを使いません。タイマーの操作は esp_timer が内部でロックを取るため、スピンロックを解放してから行います。
+ *
+ * 割り込みは attachInterruptArg() で ESP_INTR_FLAG_IRAM なしに登録します（CONFIG_ARDUINO_ISR_IRAM が無効の既定の設定）。
+ * フラッシュへの書き込み中は割り込みが遅れるため、ハンドラと、そこから呼び出す esp_timer・GPIO の関数を IRAM に置く必要はありません。
+ * ライトスリープの前後に enableWakeup() / disableWakeup() を呼び出すと、ボタンを復帰要因として使えます。
  */
 class Button
 {
-private:
-    uint8_t pin;                ///< ボタンが接続されているGPIOピン番号
-    bool lastState;             ///< 前回のボタンの状態 (HIGH/LOW)
-    bool currentState;          ///< 現在のボタンの状態 (HIGH/LOW)
-    uint32_t pressStartTime;    ///< ボタンが押され始めた時刻 (millis)
-    uint32_t longPressDuration; ///< 長押しと判定するまでの時間 (ms)
-    bool longPressTriggered;    ///< 長押しイベントが既に発火したかどうか
-
 public:
+    constexpr static uint32_t DEBOUNCE_TIME = 20; ///< チャタリングとみなす時間（ミリ秒）
+    constexpr static size_t QUEUE_SIZE = 16;      ///< 取り出されるまで保持できるイベント数
+
+    /**
+     * @brief イベントの種類
+     */
+    enum EventType : uint8_t
+    {
+        EVENT_PRESS,      ///< 押された
+        EVENT_RELEASE,    ///< 離された
+        EVENT_LONG_PRESS, ///< 長押し判定時間を超えて押され続けている（1回の押下につき1回）
+    };
+
+    /**
+     * @brief ボタンのイベント
+     */
+    struct Event
+    {
+        EventType type;   ///< イベントの種類
+        bool longPressed; ///< 長押しの後に離されたかどうか（EVENT_RELEASE のみ）
+        uint32_t time;    ///< イベントの時刻（ミリ秒）
+    };
+
     /**
      * @brief コンストラクタ
      *
      * @param buttonPin ボタンが接続されているGPIOピン番号
      * @param longPressMs 長押しと判定するまでの時間（ミリ秒）。デフォルトは3000ms。
      */
-    Button(uint8_t buttonPin, uint32_t longPressMs = 3000)
-        : pin(buttonPin), lastState(HIGH), currentState(HIGH), pressStartTime(0), longPressDuration(longPressMs),
-          longPressTriggered(false)
+    Button(uint8_t buttonPin, uint32_t longPressMs = 3000) : pin(buttonPin), longPressDuration(longPressMs)
     {
     }
 
     /**
      * @brief ボタンの初期化
      *
-     * ピンモードをINPUT_PULLUPに設定し、初期状態を読み取ります。
+     * ピンモードをINPUT_PULLUPに設定して初期状態を読み取り、タイマーと割り込みを設定します。
      * setup() 関数内で呼び出してください。
+     *
+     * @return true 初期化成功
+     * @return false タイマーの作成に失敗
      */
-    void begin()
-    {
-        pinMode(pin, INPUT_PULLUP);
-        currentState = digitalRead(pin);
-        lastState = currentState;
-    }
+    bool begin();
 
     /**
-     * @brief ボタンの状態を更新
+     * @brief 最も古いイベントを取り出す
      *
-     * loop() 関数内で定期的に呼び出してください。
-     * 現在のボタンの状態を読み取り、長押し判定などを行います。
+     * @param[out] event 取り出したイベント
+     * @return true 取り出した
+     * @return false イベントがない
      */
-    void update()
+    bool poll(Event &event)
     {
-        lastState = currentState;
-        currentState = digitalRead(pin);
-
-        // ボタンが押され始めた
-        if (currentState == LOW && lastState == HIGH)
-        {
-            pressStartTime = millis();
-            longPressTriggered = false;
-        }
-
-        // 長押し判定（オーバーフロー対応の差分計算）
-        if (currentState == LOW && !longPressTriggered)
-        {
-            uint32_t elapsed = millis() - pressStartTime;
-            if (elapsed >= longPressDuration)
-            {
-                longPressTriggered = true;
-            }
-        }
+        return events.pop(event);
     }
 
     /**
-     * @brief ボタンが現在押されているかを確認
+     * @brief ボタンが現在押されているかを確認（チャタリング除去後の状態）
      *
      * @return true ボタンが押されている場合
      * @return false ボタンが離されている場合
      */
     bool isPressed() const
     {
-        return currentState == LOW;
+        return pressed;
     }
 
     /**
-     * @brief ボタンが押された瞬間かどうかを確認（立ち下がりエッジ）
+     * @brief 長押し判定時間を設定
      *
-     * @return true ボタンが押された瞬間の場合
-     * @return false それ以外の場合
+     * @param ms 長押しと判定するまでの時間（ミリ秒）
      */
-    bool wasPressed() const
+    void setLongPressDuration(uint32_t ms)
     {
-        return currentState == LOW && lastState == HIGH;
+        longPressDuration = ms;
     }
 
     /**
-     * @brief ボタンが離された瞬間かどうかを確認（立ち上がりエッジ）
+     * @brief ボタンの状態が変わったときにライトスリープから復帰するよう設定する
      *
-     * @return true ボタンが離された瞬間の場合
-     * @return false それ以外の場合
+     * esp_light_sleep_start() の直前に呼び出してください。スリープ中は割り込みを止めます。
      */
-    bool wasReleased() const
-    {
-        return currentState == HIGH && lastState == LOW;
-    }
+    void enableWakeup();
 
     /**
-     * @brief 長押しされたかどうかを確認
-     *
-     * 長押し判定時間を超えてボタンが押され続けている場合、一度だけtrueを返します。
+     * @brief スリープからの復帰の設定を解除し、割り込みを再開する
      *
-     * @return true 長押しが検知された場合
-     * @return false それ以外の場合
+     * esp_light_sleep_start() から戻った直後に呼び出してください。スリープ中の変化はここでイベントにします。
+     */
+    void disableWakeup();
+
+    /**
+     * @brief キューが満杯で捨てたイベント数を取得する
      */
-    bool wasLongPressed() const
+    uint32_t getDroppedCount() const
     {
-        return longPressTriggered && currentState == LOW;
+        return droppedCount;
     }
 
+private:
+    uint8_t pin;                ///< ボタンが接続されているGPIOピン番号
+    uint32_t longPressDuration; ///< 長押しと判定するまでの時間 (ms)
+
+    SpscQueue<Event, QUEUE_SIZE> events;              ///< 取り出されていないイベント
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; ///< 割り込みハンドラとタイマーのコールバックの排他
+    esp_timer_handle_t settleTimer = nullptr;         ///< チャタリングが収まった後に状態を読み直すタイマー
+    esp_timer_handle_t longPressTimer = nullptr;      ///< 長押しを判定するタイマー
+    volatile bool pressed = false;                    ///< チャタリング除去後の状態（押されている場合は true）
+    bool longPressed = false;                         ///< 今回の押下で長押しのイベントを出したかどうか
+    uint32_t lastChange = 0;                          ///< 最後に状態の変化を受け付けた時刻（ミリ秒）
+    volatile uint32_t droppedCount = 0;               ///< キューが満杯で捨てたイベント数
+
     /**
-     * @brief 長押し判定時間を設定
+     * @brief GPIO の割り込みハンドラ（両エッジ）
+     */
+    static void onEdge(void *arg);
+
+    /**
+     * @brief チャタリングが収まった後に状態を読み直すタイマーのコールバック
+     */
+    static void onSettle(void *arg);
+
+    /**
+     * @brief 長押しを判定するタイマーのコールバック
+     */
+    static void onLongPress(void *arg);
+
+    /**
+     * @brief ピンの状態を読み、変わっていればイベントにする（lock を取得して呼び出す）
      *
-     * @param ms 長押しと判定するまでの時間（ミリ秒）
+     * @param now 現在の時刻（ミリ秒）
+     * @return true 状態が変わった（lock を解放した後に rearmLongPress() を呼び出す）
+     * @return false 状態は変わっていない
      */
-    void setLongPressDuration(uint32_t ms)
-    {
-        longPressDuration = ms;
-    }
+    bool applyLevel(uint32_t now);
+
+    /**
+     * @brief 押されていれば長押しの判定を始め、離されていれば止める（lock を解放して呼び出す）
+     *
+     * 古い状態で設定し直しても、onLongPress() が lock を取得して状態を確かめるため誤ったイベントは出ません。
+     *
+     * @param level applyLevel() の後の状態（押されている場合は true）
+     */
+    void rearmLongPress(bool level);
+
+    /**
+     * @brief イベントをキューに入れる（lock を取得して呼び出す）
+     */
+    void pushEvent(EventType type, uint32_t now);
 };
 
 #endif // BUTTON_H
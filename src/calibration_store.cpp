@@ -0,0 +1,69 @@
+#include "calibration_store.h"
+#include <esp_rom_crc.h>
+
+namespace
+{
+/**
+ * @brief 保存内容のCRCを計算する（crcフィールド自身は除く）
+ */
+template <typename Content> uint32_t contentCrc(const Content &content)
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&content), offsetof(Content, crc));
+}
+} // namespace
+
+bool CalibrationStore::load(HumidityCalibration *calibrations, size_t channels)
+{
+    fs::File file = flash.open(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    Content content = {};
+    bool ok = file.read(reinterpret_cast<uint8_t *>(&content), sizeof(content)) == sizeof(content);
+    file.close();
+
+    if (!ok || content.magic != FILE_MAGIC || content.version != FILE_VERSION || content.crc != contentCrc(content))
+    {
+        return false;
+    }
+
+    // 校正点から変換テーブルを作り直す（2点未満のチャンネルは既定の校正値のまま）
+    for (size_t channel = 0; channel < std::min<size_t>(channels, content.channels); channel++)
+    {
+        size_t pointCount = content.pointCounts[channel];
+        if (pointCount < 2 || pointCount > HumidityCalibration::MAX_POINTS)
+        {
+            continue;
+        }
+
+        calibrations[channel] = HumidityCalibration(content.points[channel], pointCount);
+    }
+    return true;
+}
+
+bool CalibrationStore::save(const HumidityCalibration *calibrations, size_t channels)
+{
+    Content content = {};
+    content.magic = FILE_MAGIC;
+    content.version = FILE_VERSION;
+    content.channels = std::min(channels, MAX_CHANNELS);
+    for (size_t channel = 0; channel < content.channels; channel++)
+    {
+        content.pointCounts[channel] = calibrations[channel].getPointCount();
+        memcpy(content.points[channel], calibrations[channel].getPoints(),
+               calibrations[channel].getPointCount() * sizeof(CalibrationPoint));
+    }
+    content.crc = contentCrc(content);
+
+    fs::File file = flash.open(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool ok = file.write(reinterpret_cast<const uint8_t *>(&content), sizeof(content)) == sizeof(content);
+    file.close();
+    return ok;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "humidity_calibration.h"
+#include <Arduino.h>
+#include <FS.h>
+
+/**
+ * @brief センサーごとの校正点を内蔵フラッシュに保存するクラス
+ *
+ * 全チャンネルの校正点を1つの小さなファイルにまとめ、CRC付きで保存します。
+ * 変換テーブルは保存せず、読み込み時に校正点から作り直します。
+ */
+class CalibrationStore final
+{
+public:
+    constexpr static size_t MAX_CHANNELS = 8;          ///< 保存できる最大チャンネル数
+    constexpr static uint32_t FILE_MAGIC = 0x4C435447; ///< ファイル識別子（"GTCL"）
+    constexpr static uint16_t FILE_VERSION = 1;        ///< ファイルフォーマットのバージョン
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param flash 保存先のファイルシステム（LittleFS）
+     * @param path 保存先ファイルのパス
+     */
+    explicit CalibrationStore(fs::FS &flash, const char *path = "/calibration.bin") : flash(flash), path(path)
+    {
+    }
+
+    /**
+     * @brief 校正点を読み込む
+     *
+     * 保存されていないチャンネルの校正値は変更しません。
+     *
+     * @param[in,out] calibrations チャンネルごとの校正値
+     * @param channels チャンネル数（最大 MAX_CHANNELS）
+     * @return true 読み込めた
+     * @return false ファイルがない、または壊れている
+     */
+    bool load(HumidityCalibration *calibrations, size_t channels);
+
+    /**
+     * @brief 校正点を保存する
+     *
+     * @param calibrations チャンネルごとの校正値
+     * @param channels チャンネル数（最大 MAX_CHANNELS）
+     * @return true 保存成功
+     * @return false 保存失敗
+     */
+    bool save(const HumidityCalibration *calibrations, size_t channels);
+
+private:
+    /**
+     * @brief 保存するファイルの内容
+     */
+    struct Content
+    {
+        uint32_t magic;                                                        ///< ファイル識別子
+        uint16_t version;                                                      ///< フォーマットバージョン
+        uint8_t channels;                                                      ///< チャンネル数
+        uint8_t pointCounts[MAX_CHANNELS];                                     ///< チャンネルごとの校正点の数
+        CalibrationPoint points[MAX_CHANNELS][HumidityCalibration::MAX_POINTS]; ///< チャンネルごとの校正点
+        uint32_t crc;                                                          ///< CRC（このフィールドを除く）
+    };
+
+    fs::FS &flash;    ///< 保存先のファイルシステム
+    const char *path; ///< 保存先ファイルのパス
+};
@@ -0,0 +1,84 @@
+#include "cpu_frequency_governor.h"
+#include <esp_timer.h>
+
+bool CpuFrequencyGovernor::begin()
+{
+    if (!mutex)
+    {
+        mutex = xSemaphoreCreateMutex();
+    }
+
+    // 起動直後の周波数（既定 160MHz）から待機中の周波数に下げる
+    setCpuFrequencyMhz(IDLE_MHZ);
+    levelStart = esp_timer_get_time();
+    return mutex != nullptr;
+}
+
+void CpuFrequencyGovernor::boost()
+{
+    if (mutex)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+    }
+
+    if (boostCount++ == 0)
+    {
+        setLevel(LEVEL_BOOST);
+    }
+
+    if (mutex)
+    {
+        xSemaphoreGive(mutex);
+    }
+}
+
+void CpuFrequencyGovernor::release()
+{
+    if (mutex)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+    }
+
+    if (boostCount > 0 && --boostCount == 0)
+    {
+        setLevel(LEVEL_IDLE);
+    }
+
+    if (mutex)
+    {
+        xSemaphoreGive(mutex);
+    }
+}
+
+uint64_t CpuFrequencyGovernor::getTime(Level level) const
+{
+    uint64_t time = times[level];
+    if (level == this->level && levelStart != 0)
+    {
+        time += esp_timer_get_time() - levelStart;
+    }
+    return time;
+}
+
+void CpuFrequencyGovernor::setLevel(Level next)
+{
+    if (next == level)
+    {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (levelStart != 0)
+    {
+        times[level] += now - levelStart;
+    }
+    levelStart = now;
+    level = next;
+
+    // 同じ周波数の場合（IDLE_MHZ == BOOST_MHZ でガバナーを無効にした場合）は切り替えない
+    if (IDLE_MHZ != BOOST_MHZ)
+    {
+        setCpuFrequencyMhz(getFrequency(next));
+        switchCount++;
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#ifndef CPU_IDLE_MHZ
+#define CPU_IDLE_MHZ 80 ///< 待機中・センサー読み取り中のCPU周波数 (MHz)
+#endif
+
+#ifndef CPU_BOOST_MHZ
+#define CPU_BOOST_MHZ 160 ///< 描画・保存・履歴の読み込み中のCPU周波数 (MHz)
+#endif
+
+// ESP32-C3 の APB クロックは、CPU が 80MHz 以上なら 80MHz 固定で、それ未満では CPU と同じ周波数になる。
+// I2C（OLED）・SPI（SDカード）・ADCの連続変換のクロックは APB から作られるため、
+// 周波数を切り替えても APB が変わらないよう、両方とも 80MHz 以上に限る
+static_assert(CPU_IDLE_MHZ >= 80, "CPU_IDLE_MHZ below 80 MHz would change the APB clock used by I2C, SPI and ADC DMA");
+static_assert(CPU_BOOST_MHZ >= CPU_IDLE_MHZ, "CPU_BOOST_MHZ must not be lower than CPU_IDLE_MHZ");
+
+/**
+ * @brief 処理の重さに応じてCPU周波数を切り替えるガバナー
+ *
+ * 普段は IDLE_MHZ で動作し、描画・保存・履歴の読み込みなど計算量の多い処理の間だけ
+ * boost() で BOOST_MHZ に上げます。boost() は参照カウント式で、複数のタスクから入れ子に呼び出せます。
+ * 処理の範囲は CpuBoost で囲むと、抜けたときに自動で release() されます。
+ *
+ * 周波数ごとの滞在時間と切り替え回数を計測します（ライトスリープ中の時間は、スリープ前の周波数に含まれます）。
+ */
+class CpuFrequencyGovernor final
+{
+public:
+    constexpr static uint32_t IDLE_MHZ = CPU_IDLE_MHZ;   ///< 待機中のCPU周波数 (MHz)
+    constexpr static uint32_t BOOST_MHZ = CPU_BOOST_MHZ; ///< 処理中のCPU周波数 (MHz)
+
+    /**
+     * @brief 周波数の段階
+     */
+    enum Level : uint8_t
+    {
+        LEVEL_IDLE,  ///< IDLE_MHZ
+        LEVEL_BOOST, ///< BOOST_MHZ
+        LEVEL_COUNT, ///< 段階の数
+    };
+
+    /**
+     * @brief CPU周波数を IDLE_MHZ に下げ、計測を開始する
+     *
+     * setup() 関数の最初に呼び出してください。
+     *
+     * @return true 開始成功
+     * @return false ミューテックスの作成に失敗
+     */
+    bool begin();
+
+    /**
+     * @brief CPU周波数を BOOST_MHZ に上げる
+     *
+     * release() と対にして呼び出してください。
+     */
+    void boost();
+
+    /**
+     * @brief boost() を1回分解除し、解除されていない boost() がなければ IDLE_MHZ に戻す
+     */
+    void release();
+
+    /**
+     * @brief 指定した周波数の段階の周波数を取得する
+     *
+     * @return uint32_t 周波数 (MHz)
+     */
+    constexpr static uint32_t getFrequency(Level level)
+    {
+        return level == LEVEL_BOOST ? BOOST_MHZ : IDLE_MHZ;
+    }
+
+    /**
+     * @brief 指定した周波数の段階で動作していた時間を取得する（現在の段階は現在までの時間を含む）
+     *
+     * @return uint64_t 時間（マイクロ秒）
+     */
+    uint64_t getTime(Level level) const;
+
+    /**
+     * @brief 周波数を切り替えた回数を取得する
+     */
+    uint32_t getSwitchCount() const
+    {
+        return switchCount;
+    }
+
+private:
+    SemaphoreHandle_t mutex = nullptr; ///< 参照カウントと周波数の切り替えを保護するミューテックス
+    uint32_t boostCount = 0;           ///< 解除されていない boost() の数
+    Level level = LEVEL_IDLE;          ///< 現在の周波数の段階
+    int64_t levelStart = 0;            ///< 現在の段階になった時刻（マイクロ秒）
+    uint64_t times[LEVEL_COUNT] = {};  ///< 段階ごとに動作していた時間（マイクロ秒）
+    uint32_t switchCount = 0;          ///< 周波数を切り替えた回数
+
+    /**
+     * @brief 周波数の段階を切り替え、それまでの段階の時間を加算する
+     */
+    void setLevel(Level next);
+};
+
+/**
+ * @brief スコープの間だけCPU周波数を上げる
+ *
+ * 例: { CpuBoost boost(governor); oled.sendBuffer(); }
+ */
+class CpuBoost final
+{
+public:
+    explicit CpuBoost(CpuFrequencyGovernor &governor) : governor(governor)
+    {
+        governor.boost();
+    }
+
+    ~CpuBoost()
+    {
+        governor.release();
+    }
+
+    CpuBoost(const CpuBoost &) = delete;
+    CpuBoost &operator=(const CpuBoost &) = delete;
+
+private:
+    CpuFrequencyGovernor &governor; ///< 周波数を上げたガバナー
+};
@@ -0,0 +1,222 @@
+#include "deep_sleep_controller.h"
+#include "greenthumb_app.h"
+#include "humidity_reader.h"
+#include "pump_controller.h"
+#include <algorithm>
+#include <driver/gpio.h>
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <time.h>
+
+namespace
+{
+constexpr uint32_t RETAINED_MAGIC = 0x52535447; ///< RTCメモリの状態が有効であることを表す値（"GTSR"）
+
+/**
+ * @brief ディープスリープ中もRTCメモリに保持する状態
+ */
+struct RetainedState
+{
+    uint32_t magic;                                                 ///< 有効な状態かどうかの識別子
+    uint32_t lastWateringTime;                                      ///< 最後に水やりした時刻（秒、0 は未実施）
+    uint32_t lastTime;                                              ///< 最後に確認した壁時計の時刻（秒）
+    uint32_t sleepSeconds;                                          ///< 最後にスリープした時間（秒）
+    uint8_t graphScaleIndex;                                        ///< グラフの縮尺インデックス
+    uint16_t pendingCount;                                          ///< 溜まっている記録数
+    HumidityData::Sample samples[DeepSleepController::PENDING_CAPACITY]; ///< 湿度（エンコード済み）
+    uint32_t timestamps[DeepSleepController::PENDING_CAPACITY];     ///< 記録した時刻（秒）
+    uint8_t events[DeepSleepController::PENDING_CAPACITY];          ///< イベントのビットフラグ
+    HumidityCalibration calibration;                                ///< センサーの校正値
+    uint32_t crc;                                                   ///< このフィールドより前の内容のCRC
+};
+
+RTC_DATA_ATTR RetainedState retained; ///< ディープスリープ中も保持する状態
+
+/**
+ * @brief 保持している状態のCRCを計算する
+ */
+uint32_t retainedCrc()
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&retained), offsetof(RetainedState, crc));
+}
+
+/**
+ * @brief 状態を変更した後にCRCを更新する
+ *
+ * 起きている間のパニックやブラウンアウトでリセットされた場合も状態を引き継げるよう、変更のたびに更新する。
+ */
+void seal()
+{
+    retained.crc = retainedCrc();
+}
+} // namespace
+
+void DeepSleepController::begin()
+{
+    // スリープ中に LOW に固定していたポンプのピンを解放する
+    gpio_hold_dis(static_cast<gpio_num_t>(pumpPin));
+    gpio_deep_sleep_hold_dis();
+
+    // 電源投入時と、内容が壊れている場合だけ初期化する
+    // （パニック・ウォッチドッグ・ブラウンアウトによるリセットでは、溜まった記録と水やりの時刻を引き継ぐ）
+    if (esp_reset_reason() == ESP_RST_POWERON || retained.magic != RETAINED_MAGIC || retained.crc != retainedCrc())
+    {
+        retained = {};
+        retained.magic = RETAINED_MAGIC;
+        retained.calibration = HumidityCalibration();
+        seal();
+    }
+}
+
+bool DeepSleepController::isScheduledWakeup() const
+{
+    return retained.magic == RETAINED_MAGIC && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+}
+
+bool DeepSleepController::runCycle()
+{
+    uint32_t timestamp = now();
+    float humidity = readHumidity();
+    uint8_t events = 0;
+
+    // 水やりの判定（クールタイムは壁時計で判定する）
+    bool cooledDown = retained.lastWateringTime == 0 ||
+                      timestamp - retained.lastWateringTime >= GreenThumbApp::PUMP_MIN_INTERVAL / 1000;
+    if (humidity < GreenThumbApp::PUMP_ON_THRESHOLD && cooledDown)
+    {
+        GPIOPumpController pump(pumpPin);
+        pump.turnOn();
+
+        // 水やりの間だけ短い間隔で読み取り、停止閾値か最大稼働時間で止める
+        uint32_t start = millis();
+        while (humidity < GreenThumbApp::PUMP_OFF_THRESHOLD && millis() - start < GreenThumbApp::PUMP_MAX_DURATION)
+        {
+            delay(WATERING_INTERVAL);
+            humidity = readHumidity();
+        }
+
+        pump.turnOff();
+        retained.lastWateringTime = now();
+        seal();
+        events |= HumidityData::EVENT_PUMP;
+    }
+
+    record(humidity, timestamp, events);
+    if (retained.pendingCount < PENDING_CAPACITY)
+    {
+        sleep();
+    }
+    return true;
+}
+
+size_t DeepSleepController::drain(HumidityData &data)
+{
+    size_t count = retained.pendingCount;
+    for (size_t i = 0; i < count; i++)
+    {
+        data.pushSample(retained.samples[i], retained.timestamps[i], retained.events[i]);
+    }
+    retained.pendingCount = 0;
+    seal();
+    return count;
+}
+
+void DeepSleepController::sleep()
+{
+    // 次の記録の枠に復帰する（起きていた時間が記録間隔より長い場合も、すぐに復帰せず次の枠に合わせる）
+    uint32_t duration = interval - millis() % interval;
+    if (duration < MIN_SLEEP_TIME)
+    {
+        duration += interval;
+    }
+
+    // 起きていた時間は now() に含まれるため、スリープする時間だけを保持する
+    retained.lastTime = now();
+    retained.sleepSeconds = duration / 1000;
+    seal();
+
+    esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(duration) * 1000);
+    esp_deep_sleep_enable_gpio_wakeup(1ULL << wakeupPin, ESP_GPIO_WAKEUP_GPIO_LOW);
+
+    // スリープ中にポンプが動かないよう、ピンを LOW に固定する
+    digitalWrite(pumpPin, LOW);
+    gpio_hold_en(static_cast<gpio_num_t>(pumpPin));
+    gpio_deep_sleep_hold_en();
+
+    esp_deep_sleep_start();
+}
+
+uint32_t DeepSleepController::getLastWateringTime() const
+{
+    return retained.lastWateringTime;
+}
+
+void DeepSleepController::setLastWateringTime(uint32_t timestamp)
+{
+    retained.lastWateringTime = timestamp;
+    seal();
+}
+
+uint8_t DeepSleepController::getGraphScaleIndex() const
+{
+    return retained.graphScaleIndex;
+}
+
+void DeepSleepController::setGraphScaleIndex(uint8_t index)
+{
+    retained.graphScaleIndex = index;
+    seal();
+}
+
+const HumidityCalibration &DeepSleepController::getCalibration() const
+{
+    return retained.calibration;
+}
+
+void DeepSleepController::setCalibration(const HumidityCalibration &calibration)
+{
+    retained.calibration = calibration;
+    seal();
+}
+
+uint32_t DeepSleepController::now() const
+{
+    // RTCのタイマーはディープスリープ中も進むため、通常は time() がそのまま使える
+    uint32_t current = static_cast<uint32_t>(time(nullptr));
+    if (current >= retained.lastTime)
+    {
+        return current;
+    }
+
+    // RTCの時刻が失われた場合は、前回の時刻にスリープした時間を足して復元する
+    return retained.lastTime + retained.sleepSeconds + millis() / 1000;
+}
+
+float DeepSleepController::readHumidity() const
+{
+    // 起動直後は ADC の連続変換を待たず、単発の読み取りの中央値でノイズを除く
+    GPIOHumidityReader reader(sensorPin, retained.calibration);
+    float values[SENSOR_READS];
+    for (size_t i = 0; i < SENSOR_READS; i++)
+    {
+        values[i] = reader.readHumidity();
+    }
+    std::nth_element(values, values + SENSOR_READS / 2, values + SENSOR_READS);
+    return values[SENSOR_READS / 2];
+}
+
+void DeepSleepController::record(float humidity, uint32_t timestamp, uint8_t events)
+{
+    if (retained.pendingCount >= PENDING_CAPACITY)
+    {
+        return;
+    }
+
+    size_t index = retained.pendingCount++;
+    retained.samples[index] = HumidityEncoding::encode(humidity);
+    retained.timestamps[index] = timestamp;
+    retained.events[index] = events;
+    seal();
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "humidity_calibration.h"
+#include "humidity_data.h"
+#include <Arduino.h>
+
+#ifndef DEEP_SLEEP_ENABLED
+#define DEEP_SLEEP_ENABLED 0 ///< 記録の間にディープスリープするかどうか（1 で有効、1鉢のみ）
+#endif
+
+/**
+ * @brief 記録の間にディープスリープする無人運用モードの制御クラス
+ *
+ * タイマーで復帰した場合は、setup() の最初で runCycle() を呼び出すと、センサーの読み取り・ポンプの判定・
+ * RTCメモリへの記録だけを行ってすぐにディープスリープに戻ります（OLEDの初期化やログの読み込みは行いません）。
+ * ボタンで復帰した場合は通常どおり起動し、RTCメモリに溜まった記録を drain() で湿度データに移してから保存します。
+ *
+ * ディープスリープ中はRAMが失われるため、次の状態をRTCメモリに保持します。
+ * - スリープ中の記録（最大 PENDING_CAPACITY 件、満杯になった場合は画面を使わずに保存する）
+ * - 最後に水やりした時刻（壁時計の秒）とグラフの縮尺
+ * - センサーの校正値
+ * - 最後に確認した壁時計の時刻と、スリープした時間（RTCの時刻が失われた場合の復元用）
+ */
+class DeepSleepController final
+{
+public:
+    constexpr static size_t PENDING_CAPACITY = 288;          ///< RTCメモリに保持できる記録数（5分間隔で1日分）
+    constexpr static uint32_t AWAKE_TIMEOUT = 2 * 60 * 1000; ///< ボタン操作がない場合にディープスリープに戻るまでの時間（2分）
+    constexpr static uint32_t WATERING_INTERVAL = 20;        ///< 水やり中のセンサー読み取り間隔（20ミリ秒）
+    constexpr static size_t SENSOR_READS = 5;                ///< 1回の読み取りで中央値をとる回数
+    constexpr static uint32_t MIN_SLEEP_TIME = 10 * 1000;    ///< 最短のスリープ時間（10秒、次の枠までがこれより短い場合はその次の枠まで眠る）
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param sensorPin 湿度センサーのアナログピン
+     * @param pumpPin ポンプ制御用GPIOピン（スリープ中は LOW に固定する）
+     * @param wakeupPin スリープから復帰させるボタンのピン（LOW で復帰、RTC GPIO のみ）
+     * @param interval 復帰する間隔（ミリ秒）
+     */
+    DeepSleepController(uint8_t sensorPin, uint8_t pumpPin, uint8_t wakeupPin, uint32_t interval)
+        : sensorPin(sensorPin), pumpPin(pumpPin), wakeupPin(wakeupPin), interval(interval)
+    {
+    }
+
+    /**
+     * @brief RTCメモリの状態を確認し、スリープ中に固定していたポンプのピンを解放する
+     *
+     * setup() 関数の最初に呼び出してください。電源投入時と、RTCメモリの状態が壊れている場合（識別子・CRCが一致しない場合）は
+     * 初期化します。それ以外のリセット（パニック・ウォッチドッグ・ブラウンアウトなど）では状態を引き継ぎます。
+     */
+    void begin();
+
+    /**
+     * @brief タイマーでディープスリープから復帰したかどうか
+     */
+    bool isScheduledWakeup() const;
+
+    /**
+     * @brief タイマーで復帰したときの処理を行う
+     *
+     * センサーを読み取って必要なら水やりをし、RTCメモリに記録します。
+     * 記録が満杯でなければそのままディープスリープし、戻りません。
+     *
+     * @return true 記録が満杯のため、保存してからスリープする必要がある
+     */
+    bool runCycle();
+
+    /**
+     * @brief RTCメモリに溜まった記録を湿度データに移す
+     *
+     * @param[in,out] data 履歴をすべて読み込んだ湿度データ
+     * @return size_t 移した記録数
+     */
+    size_t drain(HumidityData &data);
+
+    /**
+     * @brief ディープスリープする（戻らない）
+     *
+     * 次の記録の時刻にタイマーで、ボタンが押されたときにGPIOで復帰するよう設定します。
+     * 記録の時刻は起動から interval ごとの枠で、起きていた時間が長い場合も次の枠に合わせます。
+     */
+    [[noreturn]] void sleep();
+
+    /**
+     * @brief 最後に水やりした時刻を取得する
+     *
+     * @return uint32_t 壁時計の時刻（秒）。水やりしていない場合は0
+     */
+    uint32_t getLastWateringTime() const;
+
+    /**
+     * @brief 最後に水やりした時刻を設定する
+     *
+     * @param timestamp 壁時計の時刻（秒）
+     */
+    void setLastWateringTime(uint32_t timestamp);
+
+    /**
+     * @brief 保持しているグラフの縮尺インデックスを取得する
+     */
+    uint8_t getGraphScaleIndex() const;
+
+    /**
+     * @brief グラフの縮尺インデックスを保持する
+     */
+    void setGraphScaleIndex(uint8_t index);
+
+    /**
+     * @brief 保持しているセンサーの校正値を取得する
+     */
+    const HumidityCalibration &getCalibration() const;
+
+    /**
+     * @brief タイマーで復帰したときに使うセンサーの校正値を保持する
+     */
+    void setCalibration(const HumidityCalibration &calibration);
+
+    /**
+     * @brief 現在の壁時計の時刻を取得する
+     *
+     * RTCの時刻が失われていた場合（前回より戻っている場合）は、前回の時刻とスリープした時間から求めます。
+     *
+     * @return uint32_t 時刻（秒）
+     */
+    uint32_t now() const;
+
+private:
+    uint8_t sensorPin; ///< 湿度センサーのアナログピン
+    uint8_t pumpPin;   ///< ポンプ制御用GPIOピン
+    uint8_t wakeupPin; ///< スリープから復帰させるボタンのピン
+    uint32_t interval; ///< 復帰する間隔（ミリ秒）
+
+    /**
+     * @brief センサーを複数回読み取り、中央値を求める
+     *
+     * @return float 湿度値（%）
+     */
+    float readHumidity() const;
+
+    /**
+     * @brief 記録をRTCメモリに追加する
+     */
+    void record(float humidity, uint32_t timestamp, uint8_t events);
+};
@@ -0,0 +1,91 @@
+#include "frame_differ.h"
+#include <string.h>
+
+void FrameDiffer::send(const uint8_t *frame)
+{
+    size_t tileWidth = oled.getBufferTileWidth();
+    size_t tileHeight = oled.getBufferTileHeight();
+    size_t frameBytes = tileWidth * tileHeight * TILE_BYTES;
+
+    // 写しがない場合と、写しに収まらないディスプレイでは全体を送る
+    bool fits = tileWidth <= MAX_TILE_WIDTH && tileHeight <= MAX_TILE_HEIGHT;
+    if (!valid || !fits)
+    {
+        for (size_t row = 0; row < tileHeight; row++)
+        {
+            sendTiles(frame, 0, row, tileWidth, tileWidth);
+        }
+        u8x8_RefreshDisplay(oled.getU8x8());
+
+        if (fits)
+        {
+            memcpy(previous, frame, frameBytes);
+            valid = true;
+        }
+        fullFrameCount++;
+        bytesSent += frameBytes;
+        return;
+    }
+
+    size_t sentTiles = 0;
+    for (size_t row = 0; row < tileHeight; row++)
+    {
+        // 変化したタイルが連続する範囲ごとに送る（離れたタイルをまとめると、変化していない間のタイルも送ることになる）
+        uint16_t dirty = diffRow(frame, row, tileWidth);
+        while (dirty)
+        {
+            size_t start = __builtin_ctz(dirty);
+            size_t end = start;
+            while (end < tileWidth && (dirty & (1u << end)))
+            {
+                end++;
+            }
+            sendTiles(frame, start, row, end - start, tileWidth);
+            sentTiles += end - start;
+            dirty &= ~(((1u << (end - start)) - 1) << start);
+        }
+    }
+
+    size_t sent = sentTiles * TILE_BYTES;
+    if (sentTiles == 0)
+    {
+        skippedFrameCount++;
+    }
+    else
+    {
+        u8x8_RefreshDisplay(oled.getU8x8());
+        partialFrameCount++;
+    }
+    bytesSent += sent;
+    bytesSaved += frameBytes - sent;
+}
+
+uint16_t FrameDiffer::diffRow(const uint8_t *frame, size_t row, size_t tileWidth)
+{
+    size_t offset = row * tileWidth * TILE_BYTES;
+
+    // タイル行全体が同じなら、タイルごとに比べない
+    if (memcmp(previous + offset, frame + offset, tileWidth * TILE_BYTES) == 0)
+    {
+        return 0;
+    }
+
+    uint16_t dirty = 0;
+    for (size_t tile = 0; tile < tileWidth; tile++)
+    {
+        size_t position = offset + tile * TILE_BYTES;
+        if (memcmp(previous + position, frame + position, TILE_BYTES) != 0)
+        {
+            memcpy(previous + position, frame + position, TILE_BYTES);
+            dirty |= 1u << tile;
+        }
+    }
+    return dirty;
+}
+
+void FrameDiffer::sendTiles(const uint8_t *frame, size_t x, size_t row, size_t count, size_t tileWidth)
+{
+    // タイル行の中のタイルは連続して並んでいるため、そのまま渡せる（u8x8_DrawTile() は読み取るだけ）
+    uint8_t *tiles = const_cast<uint8_t *>(frame) + (row * tileWidth + x) * TILE_BYTES;
+    u8x8_DrawTile(oled.getU8x8(), x, row, count, tiles);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+/**
+ * @brief 前回送ったフレームと比べて、変化した 8x8 タイルだけをOLEDに送る
+ *
+ * U8G2 のフルバッファは、8ピクセル高さのタイル行ごとに、1列1バイト（縦8ピクセル）を横に並べた形をしています。
+ * send() は描画後のバッファを前回送ったフレームの写しとタイル単位で比べ、タイル行ごとに変化したタイルの
+ * ビットマスクを作ります。変化したタイルが連続する範囲だけを u8x8_DrawTile() で送り、
+ * 変化がなければI2Cの転送を行いません（128x64 の全画面は1KB、400kHz で約25ミリ秒かかります）。
+ * 送るフレームは U8G2 のバッファに限らないため、描画用と転送用のバッファを分ける AsyncDisplay からも使えます。
+ *
+ * 写しのために MAX_BUFFER_SIZE バイトのRAMを使います。これより大きいディスプレイでは毎回全体を送ります。
+ */
+class FrameDiffer final
+{
+public:
+    constexpr static size_t TILE_BYTES = 8;                                                  ///< 1タイルのバイト数
+    constexpr static size_t MAX_TILE_WIDTH = 16;                                             ///< 差分を取れる最大の横タイル数（128ピクセル）
+    constexpr static size_t MAX_TILE_HEIGHT = 8;                                             ///< 差分を取れる最大の縦タイル数（64ピクセル）
+    constexpr static size_t MAX_BUFFER_SIZE = MAX_TILE_WIDTH * MAX_TILE_HEIGHT * TILE_BYTES; ///< 写しのバイト数
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param oled OLEDディスプレイオブジェクトへの参照
+     */
+    explicit FrameDiffer(U8G2 &oled) : oled(oled)
+    {
+    }
+
+    /**
+     * @brief 描画したバッファのうち、前回から変化したタイルだけを送る
+     *
+     * oled.sendBuffer() の代わりに呼び出してください。
+     */
+    void send()
+    {
+        send(oled.getBufferPtr());
+    }
+
+    /**
+     * @brief U8G2 のバッファと同じ形のフレームのうち、前回から変化したタイルだけを送る
+     *
+     * @param frame 送るフレーム（U8G2 のバッファと同じ大きさ）
+     */
+    void send(const uint8_t *frame);
+
+    /**
+     * @brief 次の send() で全体を送るようにする
+     *
+     * clearDisplay() や setPowerSave() などで、ディスプレイ側の内容が写しと一致しなくなったときに呼び出します。
+     */
+    void invalidate()
+    {
+        valid = false;
+    }
+
+    /**
+     * @brief 全体を送ったフレーム数を取得する
+     */
+    uint32_t getFullFrameCount() const
+    {
+        return fullFrameCount;
+    }
+
+    /**
+     * @brief 変化したタイルだけを送ったフレーム数を取得する
+     */
+    uint32_t getPartialFrameCount() const
+    {
+        return partialFrameCount;
+    }
+
+    /**
+     * @brief 変化がなく、転送しなかったフレーム数を取得する
+     */
+    uint32_t getSkippedFrameCount() const
+    {
+        return skippedFrameCount;
+    }
+
+    /**
+     * @brief 送ったバイト数を取得する
+     */
+    uint32_t getBytesSent() const
+    {
+        return bytesSent;
+    }
+
+    /**
+     * @brief 毎回全体を送った場合と比べて、送らずに済んだバイト数を取得する
+     */
+    uint32_t getBytesSaved() const
+    {
+        return bytesSaved;
+    }
+
+private:
+    U8G2 &oled;                             ///< OLEDディスプレイ
+    uint8_t previous[MAX_BUFFER_SIZE] = {}; ///< 前回送ったフレームの写し
+    bool valid = false;                     ///< 写しがディスプレイの内容と一致しているかどうか
+    uint32_t fullFrameCount = 0;            ///< 全体を送ったフレーム数
+    uint32_t partialFrameCount = 0;         ///< 変化したタイルだけを送ったフレーム数
+    uint32_t skippedFrameCount = 0;         ///< 転送しなかったフレーム数
+    uint32_t bytesSent = 0;                 ///< 送ったバイト数
+    uint32_t bytesSaved = 0;                ///< 送らずに済んだバイト数
+
+    /**
+     * @brief タイル行の中で変化したタイルのビットマスクを求め、写しを更新する
+     *
+     * @param frame 送るフレーム
+     * @param row タイル行の番号
+     * @param tileWidth 横タイル数
+     * @return uint16_t 変化したタイルのビットマスク（ビット i が横 i 番目のタイル）
+     */
+    uint16_t diffRow(const uint8_t *frame, size_t row, size_t tileWidth);
+
+    /**
+     * @brief タイル行の連続したタイルを送る
+     *
+     * @param frame 送るフレーム
+     * @param x 最初のタイルの横位置
+     * @param row タイル行の番号
+     * @param count タイル数
+     * @param tileWidth 横タイル数
+     */
+    void sendTiles(const uint8_t *frame, size_t x, size_t row, size_t count, size_t tileWidth);
+};
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstring>
+
+/**
+ * @brief Gorilla 方式による時系列データの圧縮エンコーダー
+ *
+ * タイムスタンプと値（HumidityEncoding で量子化した整数）は、どちらも差分の差分（delta-of-delta）を可変長ビット列で格納します。
+ * 一定間隔で記録され、変化の緩やかな湿度データでは1サンプルあたり数ビットに圧縮されます。
+ * 出力先は固定長のバッファで、容量が足りなくなった時点で append() が false を返します。
+ */
+class GorillaEncoder
+{
+public:
+    constexpr static size_t MAX_BITS_PER_SAMPLE = 4 + 32 + 4 + 32; ///< 1サンプルあたりの最大ビット数
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param buffer 出力先バッファ
+     * @param capacity バッファのバイト数
+     */
+    GorillaEncoder(uint8_t *buffer, size_t capacity) : buffer(buffer), capacityBits(capacity * 8)
+    {
+        reset();
+    }
+
+    /**
+     * @brief エンコーダーを初期状態に戻す
+     */
+    void reset()
+    {
+        memset(buffer, 0, capacityBits / 8);
+        bitLength = 0;
+        count = 0;
+        prevTimestamp = 0;
+        prevDelta = 0;
+        prevValue = 0;
+        prevValueDelta = 0;
+    }
+
+    /**
+     * @brief サンプルを追加する
+     *
+     * @param timestamp タイムスタンプ（秒）。直前の値以上であること
+     * @param value 量子化した湿度値
+     * @return true 追加成功
+     * @return false バッファの容量不足
+     */
+    bool append(uint32_t timestamp, uint16_t value)
+    {
+        if (bitLength + MAX_BITS_PER_SAMPLE > capacityBits)
+        {
+            return false;
+        }
+
+        if (count == 0)
+        {
+            // 先頭のサンプルはそのまま格納
+            writeBits(timestamp, 32);
+            writeBits(value, 16);
+            prevDelta = 0;
+            prevValueDelta = 0;
+        }
+        else
+        {
+            writeTimestamp(timestamp);
+            writeValue(value);
+        }
+
+        prevTimestamp = timestamp;
+        prevValue = value;
+        count++;
+        return true;
+    }
+
+    /**
+     * @brief 書き込んだビット数を取得する
+     */
+    size_t getBitLength() const
+    {
+        return bitLength;
+    }
+
+    /**
+     * @brief 書き込んだサンプル数を取得する
+     */
+    uint16_t getCount() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief 最後に追加したサンプルのタイムスタンプを取得する
+     */
+    uint32_t getLastTimestamp() const
+    {
+        return prevTimestamp;
+    }
+
+private:
+    friend class GorillaDecoder;
+
+    uint8_t *buffer;     ///< 出力先バッファ
+    size_t capacityBits; ///< バッファの容量（ビット）
+    size_t bitLength;    ///< 書き込み済みビット数
+    uint16_t count;      ///< 書き込み済みサンプル数
+
+    uint32_t prevTimestamp; ///< 直前のタイムスタンプ
+    int32_t prevDelta;      ///< 直前のタイムスタンプ差分
+    uint16_t prevValue;     ///< 直前の値
+    int32_t prevValueDelta; ///< 直前の値の差分
+
+    /**
+     * @brief 上位ビットから順に書き込む
+     */
+    void writeBits(uint32_t value, uint8_t bits)
+    {
+        for (int i = bits - 1; i >= 0; i--)
+        {
+            if ((value >> i) & 1)
+            {
+                buffer[bitLength / 8] |= 0x80 >> (bitLength % 8);
+            }
+            bitLength++;
+        }
+    }
+
+    /**
+     * @brief タイムスタンプを delta-of-delta で書き込む
+     */
+    void writeTimestamp(uint32_t timestamp)
+    {
+        int32_t delta = static_cast<int32_t>(timestamp - prevTimestamp);
+        int32_t dod = delta - prevDelta;
+        prevDelta = delta;
+
+        if (dod == 0)
+        {
+            writeBits(0b0, 1);
+        }
+        else if (dod >= -63 && dod <= 64)
+        {
+            writeBits(0b10, 2);
+            writeBits(static_cast<uint32_t>(dod + 63), 7);
+        }
+        else if (dod >= -255 && dod <= 256)
+        {
+            writeBits(0b110, 3);
+            writeBits(static_cast<uint32_t>(dod + 255), 9);
+        }
+        else if (dod >= -2047 && dod <= 2048)
+        {
+            writeBits(0b1110, 4);
+            writeBits(static_cast<uint32_t>(dod + 2047), 12);
+        }
+        else
+        {
+            writeBits(0b1111, 4);
+            writeBits(static_cast<uint32_t>(dod), 32);
+        }
+    }
+
+    /**
+     * @brief 値を delta-of-delta で書き込む
+     *
+     * 湿度は0〜10000（HUMIDITY_SAMPLE_BITS=8 では0〜200）のため、差分の差分は通常4ビットか7ビットに収まります。
+     */
+    void writeValue(uint16_t value)
+    {
+        int32_t delta = static_cast<int32_t>(value) - prevValue;
+        int32_t dod = delta - prevValueDelta;
+        prevValueDelta = delta;
+
+        if (dod == 0)
+        {
+            writeBits(0b0, 1);
+        }
+        else if (dod >= -7 && dod <= 8)
+        {
+            writeBits(0b10, 2);
+            writeBits(static_cast<uint32_t>(dod + 7), 4);
+        }
+        else if (dod >= -63 && dod <= 64)
+        {
+            writeBits(0b110, 3);
+            writeBits(static_cast<uint32_t>(dod + 63), 7);
+        }
+        else if (dod >= -511 && dod <= 512)
+        {
+            writeBits(0b1110, 4);
+            writeBits(static_cast<uint32_t>(dod + 511), 10);
+        }
+        else
+        {
+            writeBits(0b1111, 4);
+            writeBits(static_cast<uint32_t>(dod), 32);
+        }
+    }
+};
+
+/**
+ * @brief GorillaEncoder で圧縮したビット列のデコーダー
+ */
+class GorillaDecoder
+{
+public:
+    /**
+     * @brief コンストラクタ
+     *
+     * @param buffer 圧縮データ
+     * @param bitLength 圧縮データのビット数
+     * @param count 格納されているサンプル数
+     */
+    GorillaDecoder(const uint8_t *buffer, size_t bitLength, uint16_t count)
+        : buffer(buffer), bitLength(bitLength), remaining(count)
+    {
+    }
+
+    /**
+     * @brief 次のサンプルを取り出す
+     *
+     * @param[out] timestamp タイムスタンプ
+     * @param[out] value 量子化した湿度値
+     * @return true 取り出し成功
+     * @return false 終端に達した、またはデータ不正
+     */
+    bool next(uint32_t &timestamp, uint16_t &value)
+    {
+        if (remaining == 0)
+        {
+            return false;
+        }
+
+        if (decoded == 0)
+        {
+            timestamp = readBits(32);
+            prevValue = readBits(16);
+        }
+        else
+        {
+            timestamp = readTimestamp();
+            readValue();
+        }
+        if (bitPos > bitLength)
+        {
+            return false;
+        }
+
+        prevTimestamp = timestamp;
+        value = prevValue;
+        remaining--;
+        decoded++;
+        return true;
+    }
+
+    /**
+     * @brief 全サンプルを読み終えた時点の状態をエンコーダーに引き継ぐ
+     *
+     * 書きかけのブロックへ追記を再開する際に使用します。
+     *
+     * @param encoder 引き継ぎ先のエンコーダー（同じバッファを指していること）
+     */
+    void resume(GorillaEncoder &encoder) const
+    {
+        encoder.bitLength = bitPos;
+        encoder.count = decoded;
+        encoder.prevTimestamp = prevTimestamp;
+        encoder.prevDelta = prevDelta;
+        encoder.prevValue = prevValue;
+        encoder.prevValueDelta = prevValueDelta;
+    }
+
+private:
+    const uint8_t *buffer; ///< 圧縮データ
+    size_t bitLength;      ///< 圧縮データのビット数
+    size_t bitPos = 0;     ///< 読み込み位置（ビット）
+    uint16_t remaining;    ///< 未読のサンプル数
+    uint16_t decoded = 0;  ///< 読み込み済みのサンプル数
+
+    uint32_t prevTimestamp = 0; ///< 直前のタイムスタンプ
+    int32_t prevDelta = 0;      ///< 直前のタイムスタンプ差分
+    uint16_t prevValue = 0;     ///< 直前の値
+    int32_t prevValueDelta = 0; ///< 直前の値の差分
+
+    /**
+     * @brief 上位ビットから順に読み込む
+     */
+    uint32_t readBits(uint8_t bits)
+    {
+        uint32_t value = 0;
+        for (uint8_t i = 0; i < bits; i++)
+        {
+            uint32_t bit = 0;
+            if (bitPos < bitLength)
+            {
+                bit = (buffer[bitPos / 8] >> (7 - bitPos % 8)) & 1;
+            }
+            value = (value << 1) | bit;
+            bitPos++;
+        }
+        return value;
+    }
+
+    /**
+     * @brief delta-of-delta 形式のタイムスタンプを読み込む
+     */
+    uint32_t readTimestamp()
+    {
+        int32_t dod;
+        if (readBits(1) == 0)
+        {
+            dod = 0;
+        }
+        else if (readBits(1) == 0)
+        {
+            dod = static_cast<int32_t>(readBits(7)) - 63;
+        }
+        else if (readBits(1) == 0)
+        {
+            dod = static_cast<int32_t>(readBits(9)) - 255;
+        }
+        else if (readBits(1) == 0)
+        {
+            dod = static_cast<int32_t>(readBits(12)) - 2047;
+        }
+        else
+        {
+            dod = static_cast<int32_t>(readBits(32));
+        }
+
+        prevDelta += dod;
+        return prevTimestamp + prevDelta;
+    }
+
+    /**
+     * @brief delta-of-delta 形式の値を読み込む
+     */
+    void readValue()
+    {
+        int32_t dod;
+        if (readBits(1) == 0)
+        {
+            dod = 0;
+        }
+        else if (readBits(1) == 0)
+        {
+            dod = static_cast<int32_t>(readBits(4)) - 7;
+        }
+        else if (readBits(1) == 0)
+        {
+            dod = static_cast<int32_t>(readBits(7)) - 63;
+        }
+        else if (readBits(1) == 0)
+        {
+            dod = static_cast<int32_t>(readBits(10)) - 511;
+        }
+        else
+        {
+            dod = static_cast<int32_t>(readBits(32));
+        }
+
+        prevValueDelta += dod;
+        prevValue = static_cast<uint16_t>(prevValue + prevValueDelta);
+    }
+};
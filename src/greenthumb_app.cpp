@@ -1,104 +1,254 @@
 #include "greenthumb_app.h"
+#include "profiler.h"
+#include <time.h>
 
 void GreenThumbApp::begin()
 {
-    // ボタンの初期化
-    button.begin();
+    bootTime = millis();
+    lastInteractionTime = bootTime;
 
-    // OLEDの初期化
-    oled.initDisplay();
-    oled.setPowerSave(0);
-    oled.clearDisplay();
+    // OLEDの初期化と転送タスクの起動
+    if (!display.begin())
+    {
+        Serial.println("display: synchronous transfer");
+    }
 
-    // 過去のログを読み込み
-    recorder.load(data);
+    // 周期的な処理の登録（同時に期限が来た場合は優先度の高い順に実行する）
+    sampleJob = scheduler.add<&GreenThumbApp::sample>("sample", this, SAMPLE_INTERVAL, 5);
+    controlJob = scheduler.add<&GreenThumbApp::control>("control", this, CONTROL_INTERVAL, 4);
+    inputJob = scheduler.add<&GreenThumbApp::handleInput>("input", this, INPUT_INTERVAL, 3);
+    recordJob = scheduler.add<&GreenThumbApp::record>("record", this, RECORD_CHECK_INTERVAL, 2);
+    renderJob = scheduler.add<&GreenThumbApp::render>("render", this, DISPLAY_INTERVAL, 1);
+    historyJob = scheduler.add<&GreenThumbApp::loadOlderHistory>("history", this, HISTORY_LOAD_INTERVAL, 0);
+
+    // 過去のログのうち、現在の縮尺のグラフに必要な分だけを先に読み込み、残りは履歴のジョブで少しずつ読み込む
+    CpuBoost boost(governor);
+    historyLoading = recorder.loadRecent(data, oled.getDisplayWidth() * getGraphScale());
+    pyramid.rebuild(data);
+    if (!historyLoading)
+    {
+        onHistoryLoaded();
+    }
 }
 
-void GreenThumbApp::update()
+bool GreenThumbApp::loadHistory(size_t required)
 {
-    static uint32_t lastRecordTime = 0;
-    static uint32_t lastDisplayTime = 0;
+    CpuBoost boost(governor);
+    while (historyLoading && recorder.getLoadedCount() < required)
+    {
+        // 保存タスクが保存中で読み込めなかった場合は、保存を待たずに戻る
+        size_t loaded = recorder.getLoadedCount();
+        loadOlderHistory();
+        if (historyLoading && recorder.getLoadedCount() == loaded)
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-    float humidity = reader.readHumidity();
+void GreenThumbApp::loadOlderHistory()
+{
+    PROFILE_PHASE(PHASE_HISTORY);
 
-    // ポンプ制御
-    if (shouldStartWatering(humidity))
+    CpuBoost boost(governor);
+    size_t loaded = recorder.getLoadedCount();
+    if (recorder.loadOlder(data, HISTORY_LOAD_CHUNK))
+    {
+        onHistoryLoaded();
+    }
+    else if (recorder.getLoadedCount() == loaded)
+    {
+        // 保存タスクが保存中で読み込めなかった（次のジョブで再び読み込む）
+        return;
+    }
+
+    // 記録間隔が一定でないため、読み込んだ履歴がグラフの表示範囲に掛かるかは記録間隔をたどらないと分からない。
+    // 作り直しは表示範囲の時間分のデータだけをたどるため、読み込むたびに作り直す
+    pyramid.rebuild(data);
+}
+
+void GreenThumbApp::onHistoryLoaded()
+{
+    historyLoading = false;
+    scheduler.setEnabled(historyJob, false);
+    timeToFullHistory = millis() - bootTime;
+}
+
+uint32_t GreenThumbApp::update()
+{
+    return scheduler.run();
+}
+
+void GreenThumbApp::sample()
+{
+    PROFILE_PHASE(PHASE_SAMPLE);
+
+    latestHumidity = reader.readHumidity();
+}
+
+void GreenThumbApp::control()
+{
+    PROFILE_PHASE(PHASE_CONTROL);
+
+    if (shouldStartWatering(latestHumidity))
     {
         // ポンプの稼働を開始
         pumpController.turnOn();
         pumpStartTime = millis();
+        watering = true;
+        pendingEvents |= HumidityData::EVENT_PUMP;
+
+        // 稼働中は湿度の変化が速いため、読み取りと制御の間隔を短くする
+        scheduler.setPeriod(sampleJob, WATERING_INTERVAL);
+        scheduler.setPeriod(controlJob, WATERING_INTERVAL);
+
+        // 稼働中の画面にすぐ切り替え、稼働の瞬間を記録する
+        scheduler.trigger(renderJob);
+        scheduler.trigger(recordJob);
     }
-    else if (shouldStopWatering(humidity))
+    else if (shouldStopWatering(latestHumidity))
     {
         // ポンプの稼働を終了
         pumpController.turnOff();
         lastWateringTime = millis();
+        watering = false;
+
+        scheduler.setPeriod(sampleJob, SAMPLE_INTERVAL);
+        scheduler.setPeriod(controlJob, CONTROL_INTERVAL);
+
+        scheduler.trigger(renderJob);
+        scheduler.trigger(recordJob);
     }
+}
 
-    // ボタンの状態更新
-    button.update();
+void GreenThumbApp::handleInput()
+{
+    PROFILE_PHASE(PHASE_INPUT);
 
-    // 長押し検知でリセット
-    if (button.wasLongPressed())
+    // 保存中で履歴を読み込めずに延期したリセットを再び試みる
+    if (resetPending)
     {
         resetHumidityData();
+        scheduler.trigger(renderJob);
     }
 
-    // シングルクリックで縮尺切り替え
-    if (button.wasReleased() && !button.wasLongPressed())
+    // 割り込みで受け取ったボタンのイベントを古い順に処理する
+    Button::Event event;
+    while (button.poll(event))
     {
-        nextGraphScale();
-    }
+        lastInteractionTime = millis();
 
-    // 記録処理（オーバーフロー対応の差分計算）
-    uint32_t currentTime = millis();
-    if (currentTime - lastRecordTime >= RECORD_INTERVAL)
+        // 長押し検知でリセット
+        if (event.type == Button::EVENT_LONG_PRESS)
+        {
+            resetHumidityData();
+            scheduler.trigger(renderJob);
+        }
+
+        // シングルクリックで縮尺切り替え（長押しの後に離した場合を除く）
+        if (event.type == Button::EVENT_RELEASE && !event.longPressed)
+        {
+            nextGraphScale();
+
+            // 拡大した縮尺の表示に必要な履歴をすぐに読み込み、すぐに表示する（保存中で読み込めない分は履歴のジョブが読み込む）
+            loadHistory(oled.getDisplayWidth() * getGraphScale());
+            scheduler.trigger(renderJob);
+        }
+    }
+    if (button.isPressed())
     {
-        data.record[data.head] = humidity;
-        data.head = (data.head + 1) % HumidityData::RECORD_SIZE;
+        lastInteractionTime = millis();
+    }
 
-        // ログの保存
-        recorder.save(data);
+    // ボタンで復帰できる場合、離されている間はイベントを取り出す間隔を延ばしてスリープできる時間を長くする
+    // （押されている間は、離したときのイベントにすぐ応えられるよう短い間隔で取り出す）
+    scheduler.setPeriod(inputJob, buttonWakeup && !button.isPressed() ? INPUT_IDLE_INTERVAL : INPUT_INTERVAL);
+}
 
-        lastRecordTime = currentTime;
+void GreenThumbApp::record()
+{
+    PROFILE_PHASE(PHASE_RECORD);
+
+    // 起動後最初の記録は、最初の画面表示か履歴の読み込み完了を待ってから行う
+    // （記録の前に履歴をすべて読み込むため、表示より先に記録すると起動時の表示が全履歴の読み込みを待ってしまう）
+    if (historyLoading && !firstFrameSent)
+    {
+        return;
+    }
+
+    // 湿度の変化量とポンプの状態に応じて記録間隔を変える
+    uint32_t currentTime = millis();
+    bool pumpOn = pumpController.isOn();
+    if (!recordingPolicy.shouldRecord(currentTime, &latestHumidity, 1, pumpOn))
+    {
+        return;
     }
 
-    // 表示処理（オーバーフロー対応の差分計算）
-    if (currentTime - lastDisplayTime >= DISPLAY_INTERVAL)
+    // 保存前に履歴をすべて読み込み、未読み込みの古いデータを上書きしないようにする
+    // （保存タスクが保存中で読み込めなかった場合は、記録せずに次の確認で再び試みる）
+    CpuBoost boost(governor);
+    if (!loadHistory(HumidityData::RECORD_SIZE))
     {
-        oled.clearBuffer();
+        return;
+    }
 
-        int w = oled.getDisplayWidth();
-        int h = oled.getDisplayHeight();
-        drawHumidityValue(0, 32, humidity);
+    // 記録間隔の途中で稼働・停止したポンプも次のデータのイベントとして残す
+    uint8_t events = pendingEvents | (pumpOn ? HumidityData::EVENT_PUMP : 0);
+    data.push(latestHumidity, static_cast<uint32_t>(time(nullptr)), events);
+    pendingEvents = 0;
+    pyramid.update(data);
 
-        if (pumpController.isOn())
-        {
-            drawWateringView(0, 33, w, h - 33);
-        }
-        else
-        {
-            drawHumidityGraph(0, 33, w, h - 33, getGraphScale());
-        }
+    // ログの保存
+    recorder.save(data);
 
-        oled.sendBuffer();
+    recordingPolicy.onRecorded(currentTime, &latestHumidity, 1, pumpOn);
+}
+
+void GreenThumbApp::render()
+{
+    PROFILE_PHASE(PHASE_RENDER);
+
+    // グラフの描画の間だけCPU周波数を上げる（I2C の転送は転送タスクが行い、転送速度はCPU周波数によらない）
+    CpuBoost boost(governor);
+    display.beginFrame();
 
-        lastDisplayTime = currentTime;
+    int w = oled.getDisplayWidth();
+    int h = oled.getDisplayHeight();
+    drawHumidityValue(0, 32, latestHumidity);
+
+    if (pumpController.isOn())
+    {
+        drawWateringView(0, 33, w, h - 33);
+    }
+    else
+    {
+        graphView.draw(pyramid, 0, 33, w, h - 33, graphScaleIndex);
+    }
+
+    // 転送タスクに渡し、転送を待たずに戻る（変化したタイルだけが送られる）
+    display.present();
+
+    if (!firstFrameSent)
+    {
+        firstFrameSent = true;
+        timeToFirstFrame = millis() - bootTime;
     }
 }
 
 inline bool GreenThumbApp::shouldStartWatering(float humidity) const
 {
     return humidity < PUMP_ON_THRESHOLD &&                   // ポンプ起動閾値よりも現在の土壌水分が少ない
-           !pumpController.isOn() &&                         // ポンプが起動していない
+           !watering &&                                      // ポンプが起動していない
            millis() - lastWateringTime >= PUMP_MIN_INTERVAL; // 最後に水やりした時間から一定時間経過している
 }
 
 inline bool GreenThumbApp::shouldStopWatering(float humidity) const
 {
-    return pumpController.isOn() &&                           // ポンプが起動している
-           (humidity >= PUMP_OFF_THRESHOLD ||                 // ポンプ停止閾値以上の湿度
-            (millis() - pumpStartTime >= PUMP_MAX_DURATION)); // または最大稼働時間を超過
+    return watering &&                                         // ポンプが起動している
+           (humidity >= PUMP_OFF_THRESHOLD ||                  // ポンプ停止閾値以上の湿度
+            (millis() - pumpStartTime >= PUMP_MAX_DURATION) || // または最大稼働時間を超過
+            !pumpController.isOn());                           // またはタイマーで停止済み
 }
 
 void GreenThumbApp::drawHumidityValue(const int x, const int y, const float humidity)
@@ -128,78 +278,6 @@ void GreenThumbApp::drawHumidityValue(const int x, const int y, const float humi
     oled.drawStr(x + 12, y, timeStr);
 }
 
-void GreenThumbApp::drawHumidityGraph(const int x, const int y, const int w, const int h, const int scale)
-{
-    // 表示範囲内の最大値・最小値を取得
-    float minVal = 100.0f;
-    float maxVal = 0.0f;
-    int dataCount = w * scale; // 表示するデータポイント数
-
-    for (int i = 0; i < dataCount; i++)
-    {
-        float value = data[i];
-
-        if (value > maxVal)
-        {
-            maxVal = value;
-        }
-        if (value < minVal)
-        {
-            minVal = value;
-        }
-    }
-
-    float range = maxVal - minVal;
-
-    // 最小値・最大値・縮尺を描画
-    char minStr[8], maxStr[8], scaleStr[8];
-    sprintf(minStr, "%.1f", minVal);
-    sprintf(maxStr, "%.1f", maxVal);
-    sprintf(scaleStr, "1/%dx", scale);
-
-    oled.setFont(u8g2_font_04b_03b_tr);
-    oled.drawStr(x, y + 6, maxStr);
-    oled.drawStr(x, y + h, minStr);
-
-    // 右上に縮尺を表示
-    int scaleStrWidth = oled.getStrWidth(scaleStr);
-    oled.drawStr(x + w - scaleStrWidth, y + 6, scaleStr);
-
-    // グラフの描画
-    int prevX, prevY;
-
-    for (int i = 0; i < w; i++)
-    {
-        // scale倍のデータポイントの平均値を計算
-        float sum = 0.0f;
-        for (int j = 0; j < scale; j++)
-        {
-            sum += data[i * scale + j];
-        }
-        float value = sum / scale;
-
-        int currentX = w - 1 - i;
-        int currentY;
-
-        if (range == 0)
-        {
-            currentY = y + h / 2;
-        }
-        else
-        {
-            float normalized = (value - minVal) / range;
-            currentY = y + (h - 1) - (int)(normalized * (h - 1));
-        }
-
-        if (i != 0)
-        {
-            oled.drawLine(prevX, prevY, currentX, currentY);
-        }
-        prevX = currentX;
-        prevY = currentY;
-    }
-}
-
 void GreenThumbApp::drawWateringView(const int x, const int y, const int w, const int h)
 {
     oled.setFont(u8g2_font_profont17_tf);
@@ -211,8 +289,20 @@ void GreenThumbApp::drawWateringView(const int x, const int y, const int w, cons
 
 void GreenThumbApp::resetHumidityData()
 {
+    // 読み込み途中の履歴が後からクリア後のデータを上書きしないよう、先に読み込みを終える
+    // （保存タスクが保存中で読み込めなかった場合は、次のボタン読み取りのジョブまで延期する）
+    CpuBoost boost(governor);
+    resetPending = !loadHistory(HumidityData::RECORD_SIZE);
+    if (resetPending)
+    {
+        return;
+    }
+
     // データをリセット
     data.clear();
+    pyramid.update(data);
+    pendingEvents |= HumidityData::EVENT_RESET;
+
     // ログの保存
     recorder.save(data);
 }
\ No newline at end of file
@@ -1,10 +1,16 @@
 #pragma once
 
+#include "async_display.h"
 #include "button.h"
+#include "cpu_frequency_governor.h"
 #include "humidity_data.h"
+#include "humidity_graph_view.h"
+#include "humidity_pyramid.h"
 #include "humidity_reader.h"
 #include "humidity_recorder.h"
+#include "job_scheduler.h"
 #include "pump_controller.h"
+#include "recording_policy.h"
 #include <Arduino.h>
 #include <U8g2lib.h>
 
@@ -13,6 +19,8 @@
  *
  * センサーからの読み取り、データの記録、OLEDディスプレイへの表示、
  * ユーザー入力（ボタン）の処理など、アプリケーション全体のロジックを統括します。
+ *
+ * 各処理は周期の異なるジョブとして JobScheduler に登録し、期限が来たものだけを実行します。
  */
 class GreenThumbApp final
 {
@@ -23,9 +31,12 @@ public:
      * @param reader 湿度リーダーへの参照
      * @param recorder 湿度レコーダーへの参照
      * @param oled OLEDディスプレイオブジェクトへの参照
+     * @param governor 描画・保存・履歴の読み込みの間にCPU周波数を上げるガバナーへの参照
+     * @param button 割り込みで入力を受け取るボタンへの参照（begin() 済み）
      */
-    GreenThumbApp(IHumidityReader &reader, IHumidityRecorder &recorder, IPumpController &pumpController, U8G2 &oled)
-        : reader(reader), recorder(recorder), pumpController(pumpController), oled(oled), button(USR_BTN_PIN), data()
+    GreenThumbApp(IHumidityReader &reader, IHumidityRecorder &recorder, IPumpController &pumpController, U8G2 &oled,
+                  CpuFrequencyGovernor &governor, Button &button)
+        : reader(reader), recorder(recorder), pumpController(pumpController), oled(oled), governor(governor), button(button), data(), pyramid(RECORD_INTERVAL / 1000), graphView(oled), display(oled)
     {
     }
 
@@ -42,30 +53,251 @@ public:
     /**
      * @brief アプリケーションの更新処理
      *
-     * センサー読み取り、画面更新、ボタン入力処理などを定期的に行います。
-     * loop() 関数内で呼び出してください。
+     * センサー読み取り、画面更新、ボタン入力処理などのうち、期限が来たジョブを実行します。
+     * loop() 関数内で呼び出し、戻り値の時間だけ delay() してください。
+     *
+     * @return uint32_t 次のジョブの期限までの時間（ミリ秒）
      */
-    void update();
+    uint32_t update();
+
+    /**
+     * @brief ポンプが稼働中かどうか（稼働中はスリープせず、制御の周期を短くする）
+     */
+    bool isWatering() const
+    {
+        return pumpController.isOn();
+    }
+
+    /**
+     * @brief ボタンでスリープから復帰できるかどうかを設定する
+     *
+     * 復帰できる場合は、ボタンが離されている間の読み取り間隔を INPUT_IDLE_INTERVAL に延ばし、
+     * スリープできる時間を長くします。
+     *
+     * @param enabled ボタンで復帰できる場合は true
+     */
+    void setButtonWakeup(bool enabled)
+    {
+        buttonWakeup = enabled;
+    }
+
+    /**
+     * @brief ボタンでスリープから復帰したときの処理（すぐにボタンを読み取る）
+     */
+    void onButtonWakeup()
+    {
+        scheduler.trigger(inputJob);
+    }
+
+    /**
+     * @brief 最後にポンプを作動させた時間を取得する
+     *
+     * @return uint32_t millis() の値（ミリ秒）
+     */
+    uint32_t getLastWateringTime() const
+    {
+        return lastWateringTime;
+    }
+
+    /**
+     * @brief 最後にポンプを作動させた時間を設定する（ディープスリープからの復帰時に使用）
+     *
+     * @param time millis() の値（ミリ秒）
+     */
+    void setLastWateringTime(uint32_t time)
+    {
+        lastWateringTime = time;
+    }
+
+    /**
+     * @brief グラフ縮尺インデックスを取得する
+     */
+    uint8_t getGraphScaleIndex() const
+    {
+        return graphScaleIndex;
+    }
+
+    /**
+     * @brief グラフ縮尺インデックスを設定する（ディープスリープからの復帰時に使用）
+     *
+     * 拡大した縮尺の表示に必要な履歴をすぐに読み込みます。
+     */
+    void setGraphScaleIndex(uint8_t index)
+    {
+        graphScaleIndex = index % HumidityPyramid::LEVEL_COUNT;
+        loadHistory(oled.getDisplayWidth() * getGraphScale());
+        scheduler.trigger(renderJob);
+    }
+
+    /**
+     * @brief 最後にボタンが操作された時間を取得する
+     *
+     * @return uint32_t millis() の値（ミリ秒）。操作されていない場合は begin() を呼び出した時間
+     */
+    uint32_t getLastInteractionTime() const
+    {
+        return lastInteractionTime;
+    }
+
+    /**
+     * @brief 読み込んだ履歴の後ろにデータを追加して保存する
+     *
+     * 履歴をすべて読み込んでから append を呼び出し、追加があればグラフを作り直して保存します。
+     * ディープスリープ中にRTCメモリに溜めた記録を、ボタンで復帰したときに履歴へ移すために使用します。
+     * 保存タスクの起動前に呼び出してください（起動後は、保存中で履歴を読み込めない場合に append を呼び出さずに戻ります）。
+     *
+     * @param append 湿度データを受け取り、追加したデータ数を返す関数
+     */
+    template <typename F> void appendHistory(F append)
+    {
+        CpuBoost boost(governor);
+        if (!loadHistory(HumidityData::RECORD_SIZE) || append(data) == 0)
+        {
+            return;
+        }
+
+        pyramid.rebuild(data);
+        recorder.save(data);
+        scheduler.trigger(renderJob);
+    }
+
+    /**
+     * @brief 画面を使わずに、保存されている履歴の後ろにデータを追加して保存する
+     *
+     * begin() の代わりに呼び出します。ディープスリープのタイマーで復帰したときに、RTCメモリに溜めた記録を
+     * 保存するために使用し、アプリケーションの湿度データの領域をそのまま使うため、別の領域を確保しません。
+     *
+     * 保存済みの履歴がまだない場合（読み込みに失敗した場合）は、追加したデータだけを保存します。
+     *
+     * @param append 湿度データを受け取り、追加したデータ数を返す関数
+     * @return true 保存成功（追加するデータがない場合を含む）
+     * @return false 保存に失敗
+     */
+    template <typename F> bool appendHistoryWithoutDisplay(F append)
+    {
+        CpuBoost boost(governor);
+        recorder.load(data);
+        if (append(data) == 0)
+        {
+            return true;
+        }
+        return recorder.save(data);
+    }
+
+    /**
+     * @brief ディスプレイを取得する（描画・転送統計の表示用）
+     */
+    const AsyncDisplay &getDisplay() const
+    {
+        return display;
+    }
+
+    /**
+     * @brief 履歴グラフの描画を取得する（描画統計の表示用）
+     */
+    const HumidityGraphView &getGraphView() const
+    {
+        return graphView;
+    }
+
+    /**
+     * @brief 画面の転送中かどうか（転送中はスリープしない）
+     */
+    bool isDisplayBusy() const
+    {
+        return display.isBusy();
+    }
+
+    /**
+     * @brief 転送が終わるのを待ってから、ディスプレイの省電力モードを切り替える
+     *
+     * @param enabled 省電力モードにする（表示を消す）場合は true
+     */
+    void setDisplayPowerSave(bool enabled)
+    {
+        display.setPowerSave(enabled);
+    }
+
+    /**
+     * @brief ジョブスケジューラーを取得する（実行統計の表示用）
+     */
+    const JobScheduler &getJobScheduler() const
+    {
+        return scheduler;
+    }
+
+    /**
+     * @brief 起動から最初の画面表示までの時間を取得する
+     *
+     * @return 経過時間（ミリ秒）。まだ表示していない場合は0
+     */
+    uint32_t getTimeToFirstFrame() const
+    {
+        return timeToFirstFrame;
+    }
+
+    /**
+     * @brief 起動から履歴をすべて読み込み終えるまでの時間を取得する
+     *
+     * @return 経過時間（ミリ秒）。まだ読み込み中の場合は0
+     */
+    uint32_t getTimeToFullHistory() const
+    {
+        return timeToFullHistory;
+    }
 
-private:
-    constexpr static uint8_t USR_BTN_PIN = D1;                 ///< ユーザーボタンのピン番号
-    constexpr static uint32_t RECORD_INTERVAL = 5 * 60 * 1000; ///< データ記録間隔（5分）
-    constexpr static uint32_t DISPLAY_INTERVAL = 2000;         ///< ディスプレイ更新間隔（2秒）
     constexpr static uint32_t PUMP_MIN_INTERVAL = 3 * 24 * 60 * 60 * 1000; ///< ポンプ再稼働までの最短クールタイム（3日）
     constexpr static uint32_t PUMP_MAX_DURATION = 15 * 1000;               ///< ポンプの最大稼働時間（15秒）
-    constexpr static float PUMP_ON_THRESHOLD = 5.0f;           ///< ポンプを作動させる湿度閾値 (%)
-    constexpr static float PUMP_OFF_THRESHOLD = 75.0f;         ///< ポンプを停止させる湿度閾値 (%)
+    constexpr static float PUMP_ON_THRESHOLD = 5.0f;                       ///< ポンプを作動させる湿度閾値 (%)
+    constexpr static float PUMP_OFF_THRESHOLD = 75.0f;                     ///< ポンプを停止させる湿度閾値 (%)
+    constexpr static uint8_t USR_BTN_PIN = D1;                             ///< ユーザーボタンのピン番号
+    constexpr static uint32_t RECORD_INTERVAL = 5 * 60 * 1000;             ///< 基準の記録間隔（5分、グラフの1列分の時間。記録間隔が不明なデータにも使う）
+
+private:
+    constexpr static uint32_t DISPLAY_INTERVAL = 2000;                     ///< ディスプレイ更新間隔（2秒）
+    constexpr static uint32_t SAMPLE_INTERVAL = 1000;                      ///< センサー読み取り間隔（1秒）
+    constexpr static uint32_t CONTROL_INTERVAL = 1000;                     ///< ポンプ制御間隔（1秒）
+    constexpr static uint32_t WATERING_INTERVAL = 20;                      ///< ポンプ稼働中のセンサー読み取り・ポンプ制御間隔（20ミリ秒）
+    constexpr static uint32_t INPUT_INTERVAL = 20;                         ///< ボタン読み取り間隔（20ミリ秒）
+    constexpr static uint32_t INPUT_IDLE_INTERVAL = 1000;                  ///< ボタンで復帰できる場合の、離されている間のボタン読み取り間隔（1秒）
+    constexpr static uint32_t RECORD_CHECK_INTERVAL = 1000;                ///< 記録するかどうかの判定間隔（1秒）
+    constexpr static uint32_t HISTORY_LOAD_INTERVAL = 10;                  ///< 古い履歴を少しずつ読み込む間隔（10ミリ秒）
+    constexpr static size_t HISTORY_LOAD_CHUNK = 1024;                     ///< 1回あたりに読み込む履歴データ数
+
+    IHumidityReader &reader;                 ///< 湿度リーダー
+    IHumidityRecorder &recorder;             ///< 湿度レコーダー
+    IPumpController &pumpController;         ///< ポンプコントローラー
+    U8G2 &oled;                              ///< OLEDディスプレイ
+    CpuFrequencyGovernor &governor;          ///< CPU周波数のガバナー
+    Button &button;                          ///< ボタンコントローラー
+    HumidityData data;                       ///< 湿度データ
+    HumidityPyramid pyramid;                 ///< グラフ表示用の多段ダウンサンプル
+    HumidityGraphView graphView;             ///< 履歴グラフの描画
+    AsyncDisplay display;                    ///< 描画と転送を分けたディスプレイ
+    AdaptiveRecordingPolicy recordingPolicy; ///< 記録間隔を決める記録ポリシー
+    JobScheduler scheduler;                  ///< 周期的な処理のスケジューラー
 
-    IHumidityReader &reader;         ///< 湿度リーダー
-    IHumidityRecorder &recorder;     ///< 湿度レコーダー
-    IPumpController &pumpController; ///< ポンプコントローラー
-    U8G2 &oled;                      ///< OLEDディスプレイ
-    Button button;                   ///< ボタンコントローラー
-    HumidityData data;               ///< 湿度データ
+    uint32_t lastWateringTime = 0;                    ///< 最後にポンプを作動させた時間（ミリ秒）
+    uint32_t pumpStartTime = 0;                       ///< ポンプを作動開始した時間（ミリ秒）
+    bool watering = false;                            ///< ポンプを作動させてから、停止を判定するまでの間かどうか
+    uint8_t graphScaleIndex = 0;                      ///< グラフ縮尺インデックス
+    uint8_t pendingEvents = HumidityData::EVENT_BOOT; ///< 次に記録するデータに付けるイベント
+    float latestHumidity = 0.0f;                      ///< 最後に読み取った湿度値（%）
+    int sampleJob = JobScheduler::INVALID_JOB;        ///< センサー読み取りのジョブ番号
+    int controlJob = JobScheduler::INVALID_JOB;       ///< ポンプ制御のジョブ番号
+    int inputJob = JobScheduler::INVALID_JOB;         ///< ボタン読み取りのジョブ番号
+    int recordJob = JobScheduler::INVALID_JOB;        ///< 記録のジョブ番号
+    int renderJob = JobScheduler::INVALID_JOB;        ///< 画面表示のジョブ番号
+    bool buttonWakeup = false;                        ///< ボタンでスリープから復帰できるかどうか
+    int historyJob = JobScheduler::INVALID_JOB;       ///< 古い履歴を読み込むジョブ番号
 
-    uint32_t lastWateringTime = 0; ///< 最後にポンプを作動させた時間（ミリ秒）
-    uint32_t pumpStartTime = 0;    ///< ポンプを作動開始した時間（ミリ秒）
-    uint8_t graphScaleIndex = 0;   ///< グラフ縮尺インデックス
+    uint32_t bootTime = 0;            ///< begin() を呼び出した時間（ミリ秒）
+    uint32_t timeToFirstFrame = 0;    ///< 起動から最初の画面表示までの時間（ミリ秒）
+    uint32_t timeToFullHistory = 0;   ///< 起動から履歴をすべて読み込むまでの時間（ミリ秒）
+    uint32_t lastInteractionTime = 0; ///< 最後にボタンが操作された時間（ミリ秒）
+    bool firstFrameSent = false;      ///< 最初の画面表示を行ったかどうか
+    bool historyLoading = false;      ///< 古い履歴を読み込み中かどうか
+    bool resetPending = false;        ///< 保存中で履歴を読み込めず、リセットを延期しているかどうか
 
     /**
      * @brief 現在のグラフ縮尺を取得
@@ -73,8 +305,7 @@ private:
      */
     int getGraphScale() const
     {
-        constexpr int scales[] = {1, 4, 16, 64};
-        return scales[graphScaleIndex];
+        return HumidityPyramid::getScale(graphScaleIndex);
     }
 
     /**
@@ -82,9 +313,57 @@ private:
      */
     void nextGraphScale()
     {
-        graphScaleIndex = (graphScaleIndex + 1) % 4;
+        graphScaleIndex = (graphScaleIndex + 1) % HumidityPyramid::LEVEL_COUNT;
     }
 
+    /**
+     * @brief センサーから湿度を読み取る（ジョブ）
+     */
+    void sample();
+
+    /**
+     * @brief 湿度に応じてポンプを稼働・停止させる（ジョブ）
+     */
+    void control();
+
+    /**
+     * @brief ボタンの状態を読み取り、操作に応じた処理を行う（ジョブ）
+     */
+    void handleInput();
+
+    /**
+     * @brief 記録ポリシーに従って湿度を記録・保存する（ジョブ）
+     */
+    void record();
+
+    /**
+     * @brief 画面を描画する（ジョブ）
+     */
+    void render();
+
+    /**
+     * @brief 指定した数の最新データが揃うまで履歴を読み込む
+     *
+     * 保存タスクが保存中で読み込めなかった場合は、保存を待たずに戻ります。
+     *
+     * @param required 必要な最新データ数（RECORD_SIZE ですべて）
+     * @return true 揃った（または読み込む履歴が残っていない）
+     * @return false 保存中のため揃わなかった
+     */
+    bool loadHistory(size_t required);
+
+    /**
+     * @brief 古い履歴を1回分読み込む（ジョブ）
+     *
+     * 記録間隔が一定でないため、読み込むたびにダウンサンプルを作り直します。
+     */
+    void loadOlderHistory();
+
+    /**
+     * @brief 履歴の読み込みを完了したときの処理
+     */
+    void onHistoryLoaded();
+
     /**
      * @brief ポンプを稼働開始させるかどうか判定する
      */
@@ -104,17 +383,6 @@ private:
      */
     void drawHumidityValue(const int x, const int y, const float humidity);
 
-    /**
-     * @brief 湿度の履歴グラフを描画する
-     *
-     * @param x 描画領域の左上X座標
-     * @param y 描画領域の左上Y座標
-     * @param w 描画領域の幅
-     * @param h 描画領域の高さ
-     * @param scale 縮尺（1ピクセルあたりのデータポイント数）
-     */
-    void drawHumidityGraph(const int x, const int y, const int w, const int h, const int scale = 1);
-
     /**
      * @brief ポンプ作動中の画面を描画する
      *
@@ -0,0 +1,355 @@
+#include "humidity_archive.h"
+#include "wall_clock.h"
+#include <algorithm>
+#include <esp_rom_crc.h>
+
+uint32_t HumidityArchive::blockCrc(const Block &block)
+{
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&block.header), offsetof(BlockHeader, crc));
+    return esp_rom_crc32_le(crc, block.payload, sizeof(block.payload));
+}
+
+void HumidityArchive::segmentPath(char *buffer, size_t length, const IndexEntry &entry) const
+{
+    // 世代0は以前の形式と同じ名前にする
+    if (entry.epoch == 0)
+    {
+        snprintf(buffer, length, "%s/%05u.seg", directory, static_cast<unsigned>(entry.day));
+    }
+    else
+    {
+        snprintf(buffer, length, "%s/%05u_%u.seg", directory, static_cast<unsigned>(entry.day),
+                 static_cast<unsigned>(entry.epoch));
+    }
+}
+
+void HumidityArchive::indexPath(char *buffer, size_t length) const
+{
+    snprintf(buffer, length, "%s/index.bin", directory);
+}
+
+bool HumidityArchive::readIndexEntry(fs::File &file, uint32_t position, IndexEntry &entry)
+{
+    if (!file.seek(sizeof(IndexHeader) + position * sizeof(IndexEntry)))
+    {
+        return false;
+    }
+    return file.read(reinterpret_cast<uint8_t *>(&entry), sizeof(entry)) == sizeof(entry);
+}
+
+bool HumidityArchive::openIndex()
+{
+    fs::FS &fs = card.fs();
+    char path[32];
+    indexPath(path, sizeof(path));
+
+    uint16_t nextEpoch = 0;
+    if (fs.exists(path))
+    {
+        fs::File index = fs.open(path, "r");
+        if (!index)
+        {
+            return false;
+        }
+
+        IndexHeader header = {};
+        bool hasHeader = index.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                         header.magic == FILE_MAGIC;
+        if (hasHeader && header.version == FILE_VERSION && header.sampleBits == HUMIDITY_SAMPLE_BITS)
+        {
+            firstEpoch = header.firstEpoch;
+            indexCount = (index.size() - sizeof(header)) / sizeof(IndexEntry);
+            bool ok = indexCount == 0 || readIndexEntry(index, indexCount - 1, current);
+            index.close();
+            return ok;
+        }
+
+        // 形式が異なるインデックスは、最後の世代の次の世代から新しいインデックスを始める
+        // （セグメントファイルの名前が世代で分かれるため、以前のセグメントを上書きしない）
+        nextEpoch = hasHeader ? header.firstEpoch : 0;
+        bool empty = true;
+        IndexEntry entry;
+        index.seek(hasHeader ? sizeof(header) : 0);
+        while (index.read(reinterpret_cast<uint8_t *>(&entry), sizeof(entry)) == sizeof(entry))
+        {
+            nextEpoch = std::max<uint16_t>(nextEpoch, entry.epoch + 1);
+            empty = false;
+        }
+        index.close();
+
+        // 以前のインデックスは、どの世代から新しいインデックスに移ったかが分かる名前で残す（空の場合は残すものがない）
+        char oldPath[32];
+        snprintf(oldPath, sizeof(oldPath), "%s/index_%u.bin", directory, static_cast<unsigned>(nextEpoch));
+        if (empty ? !fs.remove(path) : !fs.rename(path, oldPath))
+        {
+            return false;
+        }
+    }
+
+    fs::File index = fs.open(path, "w");
+    if (!index)
+    {
+        return false;
+    }
+    IndexHeader header = {FILE_MAGIC, FILE_VERSION, static_cast<uint8_t>(HUMIDITY_SAMPLE_BITS), nextEpoch};
+    bool ok = index.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header);
+    index.close();
+    firstEpoch = nextEpoch;
+    return ok;
+}
+
+bool HumidityArchive::open()
+{
+    fs::FS &fs = card.fs();
+    if (!fs.exists(directory) && !fs.mkdir(directory))
+    {
+        return false;
+    }
+
+    indexCount = 0;
+    current = {};
+    encoder.reset();
+    block.header = {};
+    unwritten = 0;
+    if (!openIndex())
+    {
+        return false;
+    }
+
+    if (indexCount > 0 && current.blockCount > 0)
+    {
+        // 書きかけのブロックを読み込み、エンコーダーの状態を復元する
+        char path[32];
+        segmentPath(path, sizeof(path), current);
+        fs::File segment = fs.open(path, "r");
+        bool valid = segment && segment.seek((current.blockCount - 1) * BLOCK_SIZE) &&
+                     segment.read(reinterpret_cast<uint8_t *>(&block), BLOCK_SIZE) == BLOCK_SIZE &&
+                     block.header.crc == blockCrc(block);
+        if (segment)
+        {
+            segment.close();
+        }
+
+        if (valid)
+        {
+            GorillaDecoder decoder(block.payload, block.header.bitLength, block.header.count);
+            uint32_t timestamp;
+            uint16_t sample;
+            while (decoder.next(timestamp, sample))
+            {
+            }
+            decoder.resume(encoder);
+        }
+        else
+        {
+            // 書き込み途中で破損したブロックは空のブロックとして書き直す
+            encoder.reset();
+            block.header = {};
+        }
+    }
+
+    opened = true;
+    openedGeneration = card.getMountGeneration();
+    return true;
+}
+
+bool HumidityArchive::writeBlock()
+{
+    char path[32];
+    segmentPath(path, sizeof(path), current);
+
+    fs::FS &fs = card.fs();
+    fs::File file = fs.open(path, fs.exists(path) ? "r+" : "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    block.header.crc = blockCrc(block);
+    bool ok = file.seek((current.blockCount - 1) * BLOCK_SIZE) &&
+              file.write(reinterpret_cast<const uint8_t *>(&block), BLOCK_SIZE) == BLOCK_SIZE;
+    file.close();
+    return ok;
+}
+
+bool HumidityArchive::writeIndexEntry()
+{
+    char path[32];
+    indexPath(path, sizeof(path));
+
+    // インデックスは open() でヘッダとともに作成済み（消えていた場合は失敗させ、次の追記で作り直す）
+    fs::File file = card.fs().open(path, "r+");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool ok = file.seek(sizeof(IndexHeader) + (indexCount - 1) * sizeof(IndexEntry)) &&
+              file.write(reinterpret_cast<const uint8_t *>(&current), sizeof(current)) == sizeof(current);
+    file.close();
+    return ok;
+}
+
+bool HumidityArchive::writeCurrent()
+{
+    // ブロックを先に書き込み、インデックスが未書き込みのデータを指さないようにする
+    uint32_t start = micros();
+    bool ok = writeBlock() && writeIndexEntry();
+    card.recordLatency(micros() - start);
+
+    if (!ok)
+    {
+        // 次回の追記でファイルから状態を読み込み直す
+        opened = false;
+        card.reportFailure();
+        return false;
+    }
+    unwritten = 0;
+    return true;
+}
+
+bool HumidityArchive::append(uint32_t timestamp, HumidityData::Sample sample)
+{
+    if (!card.ensureMounted())
+    {
+        return false;
+    }
+
+    // 再マウントされた場合はカードが差し替えられた可能性があるため読み込み直す
+    if (!opened || openedGeneration != card.getMountGeneration())
+    {
+        if (!open())
+        {
+            card.reportFailure();
+            return false;
+        }
+    }
+
+    // 時計が戻った場合は、前回の時刻に揃えずに世代を進めて新しいセグメントを始める
+    // （揃えると以降のサンプルがすべて同じ時刻・同じセグメントに重なってしまう）
+    uint16_t day = timestamp / SEGMENT_SPAN;
+    bool rewound = indexCount > 0 && timestamp < current.lastTimestamp;
+    if (indexCount == 0 || rewound || day != current.day)
+    {
+        // 前のセグメントを書き終えてから新しいセグメントを開始
+        if (unwritten > 0 && !writeCurrent())
+        {
+            return false;
+        }
+        uint16_t epoch = indexCount == 0 ? firstEpoch : current.epoch + (rewound ? 1 : 0);
+        current = {day, epoch, timestamp, timestamp, 1};
+        indexCount++;
+        encoder.reset();
+        block.header = {};
+    }
+    else if (current.blockCount == 0)
+    {
+        current.blockCount = 1;
+    }
+
+    if (!encoder.append(timestamp, sample))
+    {
+        // ブロックが一杯になったら書き込んで次のブロックへ
+        if (unwritten > 0 && !writeCurrent())
+        {
+            return false;
+        }
+        current.blockCount++;
+        encoder.reset();
+        block.header = {};
+        encoder.append(timestamp, sample);
+    }
+
+    if (encoder.getCount() == 1)
+    {
+        block.header.firstTimestamp = timestamp;
+    }
+    block.header.lastTimestamp = timestamp;
+    block.header.count = encoder.getCount();
+    block.header.bitLength = encoder.getBitLength();
+    current.lastTimestamp = timestamp;
+    unwritten++;
+    return true;
+}
+
+bool HumidityArchive::flush()
+{
+    if (unwritten == 0)
+    {
+        return true;
+    }
+
+    // 追記の後に再マウントされた場合、書き込み中のブロックは前のカードの続きのため書き込まずに捨てる
+    if (!card.ensureMounted() || openedGeneration != card.getMountGeneration())
+    {
+        opened = false;
+        return false;
+    }
+    return writeCurrent();
+}
+
+bool ArchivingHumidityRecorder::save(const HumidityData &data)
+{
+    bool ok = inner.save(data);
+
+    // クリアされた場合もアーカイブは残し、以降のデータを追記する
+    if (data.count < archivedCount)
+    {
+        archivedCount = 0;
+    }
+
+    // 追加されたデータを古い順に追記（時刻はデータの記録時刻、間隔が不明な箇所は既定の記録間隔とみなす）
+    // 時計が設定される前のデータ（最新データからさかのぼって時刻が設定前に戻るものを含む）は時刻が分からないため読み飛ばす
+    // 書き込みはブロックが一杯になったときと最後の flush() だけで行い、書き込み済みのデータ数を written に数える
+    uint32_t newSamples = std::min<uint32_t>(data.count - archivedCount, HumidityData::RECORD_SIZE);
+    bool clockValid = WallClock::isValid(data.newestTime);
+    size_t visited = 0;
+    size_t written = 0;
+    size_t appended = data.visitNewest(newSamples, interval, [&](size_t index, uint32_t timestamp) {
+        size_t position = visited++;
+        if (!clockValid || !WallClock::isValid(timestamp) || timestamp > data.newestTime)
+        {
+            if (archive.getUnwrittenCount() == 0)
+            {
+                written = position + 1;
+            }
+            return true;
+        }
+        if (!archive.append(timestamp, data.items[index]))
+        {
+            return false;
+        }
+
+        // 前のブロックを書き込んだ直後（書き込んでいないのがこのデータだけ）なら、これより前はすべて書き込み済み
+        if (archive.getUnwrittenCount() == 1)
+        {
+            written = position;
+        }
+        return true;
+    });
+    if (appended == newSamples && archive.flush())
+    {
+        written = newSamples;
+    }
+    if (written < newSamples)
+    {
+        // 書き込めなかったデータは次回の保存で再度追記する
+        archivedCount = data.count - (newSamples - written);
+        return false;
+    }
+    archivedCount = data.count;
+
+    return ok;
+}
+
+bool ArchivingHumidityRecorder::load(HumidityData &data)
+{
+    return loadRecent(data, HumidityData::RECORD_SIZE);
+}
+
+bool ArchivingHumidityRecorder::loadRecent(HumidityData &data, size_t recent)
+{
+    bool ok = inner.loadRecent(data, recent);
+    archivedCount = data.count;
+    return ok;
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include "gorilla_codec.h"
+#include "humidity_recorder.h"
+#include "sd_card_manager.h"
+#include <Arduino.h>
+#include <FS.h>
+
+/**
+ * @brief SDカード上の長期アーカイブ
+ *
+ * リングバッファの容量（約57日分）を超えた履歴を保持するため、
+ * 量子化した湿度データ（HumidityEncoding の整数値）を1日ごとのセグメントファイルに Gorilla 方式で圧縮して追記します。
+ * インデックスファイルが各セグメントの時間範囲を保持しており、カードをPCで読む際は
+ * 該当するセグメントだけを開けば期間を絞り込めます（各ブロックのヘッダにも時間範囲があります）。
+ *
+ * ファイル構成（directory 配下）:
+ * - index.bin: IndexHeader と、それに続く IndexEntry の配列（追記順。世代の中では時刻順）
+ * - NNNNN.seg: 世代0の日ごとのファイル。512バイトの圧縮ブロックの配列
+ * - NNNNN_E.seg: 世代 E（1以上）の日ごとのファイル
+ *
+ * 時計が戻った場合（設定し直した場合など）は、前回の時刻に揃えずに世代を1つ進めて新しいセグメントを始めます。
+ * 世代が変わると同じ日のファイルも別になるため、戻る前のデータを上書きしません。
+ *
+ * インデックスが以前の形式（ヘッダがなく、値を float のビット列で格納していたもの）や、
+ * 別の HUMIDITY_SAMPLE_BITS で書いたものだった場合は、index_E.bin に名前を変えて残し、
+ * 世代 E から新しいインデックスを始めます（以前のセグメントファイルは上書きしません）。
+ *
+ * サンプルはRAM上のブロックに追記し、ブロックが一杯になったときと flush() のときにだけ
+ * ブロックとインデックスのエントリを書き込みます。append() と flush() は同じタスクから呼び出してください。
+ */
+class HumidityArchive
+{
+public:
+    constexpr static uint32_t SEGMENT_SPAN = 24 * 60 * 60; ///< 1セグメントあたりの期間（1日、秒）
+    constexpr static size_t BLOCK_SIZE = 512;              ///< 圧縮ブロックのサイズ
+    constexpr static uint32_t FILE_MAGIC = 0x41485447;     ///< インデックスの識別子（"GTHA"）
+    constexpr static uint8_t FILE_VERSION = 2;             ///< アーカイブのフォーマットのバージョン
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param card SDカードマネージャーへの参照
+     * @param directory アーカイブを格納するディレクトリ
+     */
+    explicit HumidityArchive(SDCardManager &card, const char *directory = "/archive")
+        : card(card), directory(directory), encoder(block.payload, sizeof(block.payload))
+    {
+    }
+
+    /**
+     * @brief サンプルを書き込み中のブロックへ追記する
+     *
+     * タイムスタンプが前回より小さい場合は、世代を進めて新しいセグメントに追記します。
+     * ブロックが一杯になった場合とセグメントが変わる場合は、それまでのブロックを書き込んでから追記します。
+     *
+     * @param timestamp タイムスタンプ（秒）
+     * @param sample 量子化した湿度値
+     * @return true 追記成功
+     * @return false SDカードが利用不可、または書き込み失敗（書き込んでいなかったサンプルは破棄される）
+     */
+    bool append(uint32_t timestamp, HumidityData::Sample sample);
+
+    /**
+     * @brief 書き込み中のブロックとインデックスのエントリを書き込む
+     *
+     * @return true 書き込み成功、または書き込むサンプルがない
+     * @return false SDカードが利用不可、または書き込み失敗（書き込んでいなかったサンプルは破棄される）
+     */
+    bool flush();
+
+    /**
+     * @brief 書き込み中のブロックのうち、まだ書き込んでいないサンプル数を取得する
+     */
+    uint16_t getUnwrittenCount() const
+    {
+        return unwritten;
+    }
+
+private:
+    /**
+     * @brief 圧縮ブロックのヘッダ
+     */
+    struct BlockHeader
+    {
+        uint32_t firstTimestamp; ///< ブロック内の最初のタイムスタンプ
+        uint32_t lastTimestamp;  ///< ブロック内の最後のタイムスタンプ
+        uint16_t count;          ///< ブロック内のサンプル数
+        uint16_t bitLength;      ///< 圧縮データのビット数
+        uint32_t crc;            ///< ヘッダ（このフィールドを除く）と圧縮データのCRC
+    };
+
+    /**
+     * @brief 圧縮ブロック
+     */
+    struct Block
+    {
+        BlockHeader header;                              ///< ヘッダ
+        uint8_t payload[BLOCK_SIZE - sizeof(BlockHeader)]; ///< 圧縮データ
+    };
+
+    /**
+     * @brief インデックスのヘッダ
+     */
+    struct IndexHeader
+    {
+        uint32_t magic;      ///< ファイル識別子
+        uint8_t version;     ///< フォーマットのバージョン
+        uint8_t sampleBits;  ///< 湿度値のビット数（HUMIDITY_SAMPLE_BITS。値の単位が分かる）
+        uint16_t firstEpoch; ///< このインデックスの最初の世代（以前のインデックスから移行した場合は0以外）
+    };
+
+    /**
+     * @brief インデックスのエントリ（1セグメントに1つ）
+     */
+    struct IndexEntry
+    {
+        uint16_t day;            ///< 日（タイムスタンプ / SEGMENT_SPAN）
+        uint16_t epoch;          ///< 世代（時計が戻るたびに1つ増える）
+        uint32_t firstTimestamp; ///< セグメント内の最初のタイムスタンプ
+        uint32_t lastTimestamp;  ///< セグメント内の最後のタイムスタンプ
+        uint32_t blockCount;     ///< セグメント内のブロック数
+    };
+
+    static_assert(sizeof(Block) == BLOCK_SIZE, "Block must be exactly BLOCK_SIZE bytes");
+    static_assert(sizeof(IndexHeader) == 8, "IndexHeader must keep the on-card layout");
+    static_assert(sizeof(IndexEntry) == 16, "IndexEntry must keep the on-card layout");
+
+    SDCardManager &card;   ///< SDカードマネージャーへの参照
+    const char *directory; ///< アーカイブのディレクトリ
+
+    bool opened = false;           ///< インデックスと書きかけのブロックを読み込み済みか
+    uint32_t openedGeneration = 0; ///< 読み込んだときのマウント世代
+    uint32_t indexCount = 0;       ///< インデックスのエントリ数
+    uint16_t firstEpoch = 0;       ///< インデックスの最初の世代
+    IndexEntry current = {};       ///< 書き込み中のセグメントのエントリ
+    Block block = {};              ///< 書き込み中のブロック
+    GorillaEncoder encoder;        ///< 書き込み中のブロックのエンコーダー
+    uint16_t unwritten = 0;        ///< 書き込み中のブロックのうち、まだ書き込んでいないサンプル数
+
+    /**
+     * @brief インデックスの末尾と書きかけのブロックを読み込み、追記を再開できる状態にする
+     */
+    bool open();
+
+    /**
+     * @brief インデックスのヘッダを確かめ、ない場合は作成する
+     *
+     * 形式が異なる場合は、以前のインデックスの名前を変えて新しいインデックスを作成します。
+     */
+    bool openIndex();
+
+    /**
+     * @brief 書き込み中のブロックをセグメントファイルへ書き込む
+     */
+    bool writeBlock();
+
+    /**
+     * @brief 書き込み中のセグメントのエントリをインデックスへ書き込む
+     */
+    bool writeIndexEntry();
+
+    /**
+     * @brief 書き込み中のブロックとエントリを書き込む（失敗した場合は次の追記でファイルから読み込み直す）
+     */
+    bool writeCurrent();
+
+    /**
+     * @brief インデックスの指定位置のエントリを読み込む
+     */
+    static bool readIndexEntry(fs::File &file, uint32_t position, IndexEntry &entry);
+
+    /**
+     * @brief ブロックのCRCを計算する
+     */
+    static uint32_t blockCrc(const Block &block);
+
+    /**
+     * @brief セグメントファイルのパスを生成する
+     */
+    void segmentPath(char *buffer, size_t length, const IndexEntry &entry) const;
+
+    /**
+     * @brief インデックスファイルのパスを生成する
+     */
+    void indexPath(char *buffer, size_t length) const;
+};
+
+/**
+ * @brief 保存のたびに新しいデータを長期アーカイブへ追記する湿度レコーダーのデコレーター
+ *
+ * ラップ対象のレコーダーでリングバッファを保存したあと、前回以降に追加されたデータを
+ * HumidityArchive へ追記します。タイムスタンプには各データの記録時刻を使用します。
+ * 時計が設定される前に記録したデータは時刻が分からないため、アーカイブには追記しません（リングバッファには残ります）。
+ * データがクリアされてもアーカイブは削除されません。
+ */
+class ArchivingHumidityRecorder final : public IHumidityRecorder
+{
+public:
+    /**
+     * @brief コンストラクタ
+     *
+     * @param inner リングバッファの保存を行うレコーダーへの参照
+     * @param archive 追記先のアーカイブ
+     * @param interval 記録間隔が不明なデータ（再起動直後など）に使う記録間隔（秒）
+     */
+    ArchivingHumidityRecorder(IHumidityRecorder &inner, HumidityArchive &archive, uint32_t interval)
+        : inner(inner), archive(archive), interval(interval)
+    {
+    }
+
+    /**
+     * @brief リングバッファを保存し、新しいデータをアーカイブへ追記する
+     *
+     * 追加されたデータをまとめて追記してから1回だけ書き込みます。
+     * アーカイブへの書き込みに失敗したデータは次回の保存で再度追記されます。
+     *
+     * @param data 保存する湿度データ
+     * @return true 両方に成功
+     * @return false いずれかに失敗
+     */
+    bool save(const HumidityData &data) override;
+
+    /**
+     * @brief ラップ対象のレコーダーからデータを読み込む
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @return true 読み込み成功
+     * @return false 読み込み失敗
+     */
+    bool load(HumidityData &data) override;
+
+    /**
+     * @brief ラップ対象のレコーダーから最新のデータだけを読み込む
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @param recent 最低限読み込む最新データ数
+     * @return true 読み込み成功
+     * @return false 読み込み失敗
+     */
+    bool loadRecent(HumidityData &data, size_t recent) override;
+
+    /**
+     * @brief ラップ対象のレコーダーから古いデータを読み込む
+     *
+     * @param[out] data loadRecent() に渡した湿度データ構造体
+     * @param maxSamples 今回読み込む最大データ数の目安
+     * @return true すべて読み込み終えた
+     * @return false まだ読み込むデータが残っている
+     */
+    bool loadOlder(HumidityData &data, size_t maxSamples) override
+    {
+        return inner.loadOlder(data, maxSamples);
+    }
+
+    /**
+     * @brief 読み込み済みのデータ数を取得する
+     */
+    size_t getLoadedCount() const override
+    {
+        return inner.getLoadedCount();
+    }
+
+private:
+    IHumidityRecorder &inner;   ///< リングバッファの保存を行うレコーダー
+    HumidityArchive &archive;   ///< 追記先のアーカイブ
+    uint32_t interval;          ///< 記録間隔が不明なデータに使う記録間隔（秒）
+    uint32_t archivedCount = 0; ///< アーカイブへ追記済みの累計データ数
+};
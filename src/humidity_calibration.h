@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief センサーの校正点（電圧と、そのときの湿度）
+ */
+struct CalibrationPoint
+{
+    uint16_t millivolts; ///< センサーの出力電圧 (mV)
+    uint8_t humidity;    ///< 湿度（%）
+};
+
+/**
+ * @brief センサーごとの校正点から作る、電圧→湿度の変換テーブル
+ *
+ * 静電容量式の土壌湿度センサーは乾燥しているほど出力電圧が高く、電圧と湿度の関係も直線ではありません。
+ * 校正点（最低限、乾燥時と水没時の2点）を折れ線で結んだ変換を、SEGMENT_MV ごとの表にしておきます。
+ *
+ * 表の作成は constexpr のため、既定の校正点の表はコンパイル時に作られます。
+ * 変換は表の2要素を読んで整数で線形補間するだけで、浮動小数点の除算（ESP32-C3 ではソフトウェア演算）を行いません。
+ * 電圧はADCのキャリブレーション済みの値を使うため、基板を交換しても校正点をそのまま使えます。
+ */
+class HumidityCalibration final
+{
+public:
+    constexpr static size_t MAX_POINTS = 4;                            ///< 保持できる最大の校正点数
+    constexpr static size_t SEGMENT_BITS = 4;                          ///< 表の1区間の電圧幅のビット数
+    constexpr static uint32_t SEGMENT_MV = 1 << SEGMENT_BITS;          ///< 表の1区間の電圧幅（16mV）
+    constexpr static uint32_t MAX_MV = 4095;                           ///< 変換できる最大の電圧 (mV)
+    constexpr static size_t TABLE_SIZE = (MAX_MV >> SEGMENT_BITS) + 2; ///< 表の要素数
+    constexpr static int32_t SCALE = 100;                              ///< 表の値の単位（1/100 %）
+    constexpr static uint16_t DEFAULT_DRY_MV = 2200;                   ///< 既定の乾燥時（湿度 0%）の電圧 (mV)
+    constexpr static uint16_t DEFAULT_WET_MV = 1000;                   ///< 既定の水没時（湿度 100%）の電圧 (mV)
+
+    /**
+     * @brief 既定の校正点（静電容量式センサー v1.2 を 3.3V で使用した場合の目安）で作成する
+     */
+    constexpr HumidityCalibration() : HumidityCalibration(DEFAULT_DRY_MV, DEFAULT_WET_MV)
+    {
+    }
+
+    /**
+     * @brief 乾燥時と水没時の2点で作成する
+     *
+     * @param dryMillivolts 乾燥時（湿度 0%）の電圧 (mV)
+     * @param wetMillivolts 水没時（湿度 100%）の電圧 (mV)
+     */
+    constexpr HumidityCalibration(uint16_t dryMillivolts, uint16_t wetMillivolts) : points{}, pointCount(0), table{}
+    {
+        setPoint(0, dryMillivolts);
+        setPoint(100, wetMillivolts);
+    }
+
+    /**
+     * @brief 任意の数の校正点で作成する
+     *
+     * @param calibrationPoints 校正点の配列（順不同）
+     * @param count 校正点の数（MAX_POINTS を超えた分は無視する）
+     */
+    constexpr HumidityCalibration(const CalibrationPoint *calibrationPoints, size_t count)
+        : points{}, pointCount(0), table{}
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            setPoint(calibrationPoints[i].humidity, calibrationPoints[i].millivolts);
+        }
+    }
+
+    /**
+     * @brief 湿度を変換する
+     *
+     * @param millivolts センサーの出力電圧 (mV)
+     * @return float 湿度値（0.0 〜 100.0 %）
+     */
+    float toHumidity(uint32_t millivolts) const
+    {
+        if (millivolts > MAX_MV)
+        {
+            millivolts = MAX_MV;
+        }
+
+        // 区間の両端の値を、区間内の位置でシフトだけを使って補間する
+        size_t index = millivolts >> SEGMENT_BITS;
+        int32_t offset = millivolts & (SEGMENT_MV - 1);
+        int32_t value = table[index] + (((table[index + 1] - table[index]) * offset) >> SEGMENT_BITS);
+        return value * (1.0f / SCALE);
+    }
+
+    /**
+     * @brief 校正点を設定し、表を作り直す
+     *
+     * 同じ湿度の校正点があれば電圧を置き換え、なければ追加します。
+     *
+     * @param humidity 湿度（0 〜 100 %）
+     * @param millivolts その湿度でのセンサーの出力電圧 (mV)
+     * @return true 設定した
+     * @return false 校正点が MAX_POINTS 個あり、追加できない
+     */
+    constexpr bool setPoint(uint8_t humidity, uint16_t millivolts)
+    {
+        if (humidity > 100)
+        {
+            humidity = 100;
+        }
+
+        size_t found = pointCount;
+        for (size_t i = 0; i < pointCount; i++)
+        {
+            if (points[i].humidity == humidity)
+            {
+                found = i;
+            }
+        }
+        if (found == pointCount)
+        {
+            if (pointCount == MAX_POINTS)
+            {
+                return false;
+            }
+            pointCount++;
+        }
+        points[found] = {millivolts, humidity};
+
+        // 電圧の昇順に並べる（挿入ソート）
+        for (size_t i = 1; i < pointCount; i++)
+        {
+            for (size_t j = i; j > 0 && points[j - 1].millivolts > points[j].millivolts; j--)
+            {
+                CalibrationPoint tmp = points[j - 1];
+                points[j - 1] = points[j];
+                points[j] = tmp;
+            }
+        }
+
+        build();
+        return true;
+    }
+
+    /**
+     * @brief 校正点を電圧の昇順で取得する
+     */
+    constexpr const CalibrationPoint *getPoints() const
+    {
+        return points;
+    }
+
+    /**
+     * @brief 校正点の数を取得する
+     */
+    constexpr size_t getPointCount() const
+    {
+        return pointCount;
+    }
+
+private:
+    CalibrationPoint points[MAX_POINTS]; ///< 校正点（電圧の昇順）
+    size_t pointCount;                   ///< 校正点の数
+    int16_t table[TABLE_SIZE];           ///< 区間の境界の電圧ごとの湿度（1/100 %）
+
+    /**
+     * @brief 校正点を結んだ折れ線から表を作る
+     */
+    constexpr void build()
+    {
+        for (size_t i = 0; i < TABLE_SIZE; i++)
+        {
+            table[i] = interpolate(i << SEGMENT_BITS);
+        }
+    }
+
+    /**
+     * @brief 校正点を結んだ折れ線上の湿度を求める（校正点の範囲外は端の校正点の湿度）
+     *
+     * @param millivolts 電圧 (mV)
+     * @return int16_t 湿度（1/100 %）
+     */
+    constexpr int16_t interpolate(int32_t millivolts) const
+    {
+        if (pointCount == 0)
+        {
+            return 0;
+        }
+
+        const CalibrationPoint &first = points[0];
+        const CalibrationPoint &last = points[pointCount - 1];
+        if (millivolts <= first.millivolts)
+        {
+            return first.humidity * SCALE;
+        }
+        if (millivolts >= last.millivolts)
+        {
+            return last.humidity * SCALE;
+        }
+
+        size_t i = 1;
+        while (points[i].millivolts < millivolts)
+        {
+            i++;
+        }
+        const CalibrationPoint &low = points[i - 1];
+        const CalibrationPoint &high = points[i];
+        int32_t span = high.millivolts - low.millivolts;
+        int32_t delta = (high.humidity - low.humidity) * SCALE;
+        return low.humidity * SCALE + delta * (millivolts - low.millivolts) / span;
+    }
+};
+
+// 既定の校正点の表がコンパイル時に作れることを確認する
+static_assert(HumidityCalibration().getPointCount() == 2, "default calibration must have dry and wet points");
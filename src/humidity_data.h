@@ -1,50 +1,258 @@
 #pragma once
 
-#include <cstring>
+#include "ring_buffer.h"
+#include <cstdint>
+
+#ifndef HUMIDITY_SAMPLE_BITS
+#define HUMIDITY_SAMPLE_BITS 16 ///< 湿度データ1件あたりのビット数（16 または 8）
+#endif
+
+/**
+ * @brief 湿度を 0.01% 単位の16bit整数で格納するエンコーディング
+ *
+ * センサーの分解能は12bit（約0.025%）のため、精度は失われません。
+ */
+struct Centipercent16Encoding
+{
+    using Sample = uint16_t; ///< 格納する型
+
+    /**
+     * @brief 湿度値を格納値に変換する（0〜100% に丸める）
+     */
+    constexpr static Sample encode(float humidity)
+    {
+        return humidity <= 0.0f ? 0 : humidity >= 100.0f ? 10000 : static_cast<Sample>(humidity * 100.0f + 0.5f);
+    }
+
+    /**
+     * @brief 格納値を湿度値に変換する
+     */
+    constexpr static float decode(Sample sample)
+    {
+        return sample * 0.01f;
+    }
+};
+
+/**
+ * @brief 湿度を 0.5% 単位の8bit整数で格納するエンコーディング
+ */
+struct HalfPercent8Encoding
+{
+    using Sample = uint8_t; ///< 格納する型
+
+    /**
+     * @brief 湿度値を格納値に変換する（0〜100% に丸める）
+     */
+    constexpr static Sample encode(float humidity)
+    {
+        return humidity <= 0.0f ? 0 : humidity >= 100.0f ? 200 : static_cast<Sample>(humidity * 2.0f + 0.5f);
+    }
+
+    /**
+     * @brief 格納値を湿度値に変換する
+     */
+    constexpr static float decode(Sample sample)
+    {
+        return sample * 0.5f;
+    }
+};
+
+#if HUMIDITY_SAMPLE_BITS == 16
+using HumidityEncoding = Centipercent16Encoding; ///< 湿度データのエンコーディング
+#elif HUMIDITY_SAMPLE_BITS == 8
+using HumidityEncoding = HalfPercent8Encoding; ///< 湿度データのエンコーディング
+#else
+#error "HUMIDITY_SAMPLE_BITS must be 16 or 8"
+#endif
 
 /**
  * @brief 湿度データの保持構造体
  *
- * リングバッファとして使用される配列と、現在の書き込み位置（ヘッド）を管理します。
+ * 同じ位置に対応する3つの列（湿度・前回からの記録間隔・イベント）をリングバッファとして保持します（構造体の配列ではなく配列の構造体）。
+ * 1つの列だけを走査する処理は、その列の配列だけを連続して読みます。
+ * 湿度値は HumidityEncoding で整数に変換して格納します（ビルドフラグ HUMIDITY_SAMPLE_BITS で選択）。
+ *
+ * 時刻は最新データの時刻（newestTime）と、各データの前のデータからの経過秒数（intervals）で表します。
+ * 経過秒数が分からない場合（再起動で時計が戻った場合など）は INTERVAL_UNKNOWN が入り、それより古いデータの時刻は求められません。
+ *
+ * 要素数はグラフの最も粗い縮尺の表示に必要な数（HumidityPyramid::WINDOW）です。1件あたり湿度・記録間隔・イベントの
+ * 5バイト（HUMIDITY_SAMPLE_BITS=8 では4バイト）で、1つあたり40KB（32KB）になります。AsyncHumidityRecorder の
+ * ミラーと合わせて2つ分を確保するため、これより古いデータは HumidityArchive に任せます。
  */
-struct HumidityData
+struct HumidityData : RingBuffer<HumidityEncoding::Sample, 8192>
 {
-    constexpr static size_t RECORD_SIZE = 16384; ///< 記録可能な最大データ数
+    using Sample = HumidityEncoding::Sample; ///< 格納する型
+
+    constexpr static size_t RECORD_SIZE = CAPACITY;       ///< 記録可能な最大データ数
+    constexpr static uint16_t INTERVAL_UNKNOWN = 0xFFFF; ///< 前のデータからの経過秒数が分からないことを表す値
+
+    /**
+     * @brief データに付随するイベント（ビットフラグ）
+     */
+    enum Event : uint8_t
+    {
+        EVENT_PUMP = 1 << 0,  ///< 前回の記録以降にポンプが稼働した
+        EVENT_RESET = 1 << 1, ///< 直前にデータがリセットされた
+        EVENT_BOOT = 1 << 2,  ///< 起動後最初のデータ
+    };
 
-    float record[RECORD_SIZE]; ///< 湿度データ配列
-    int head;                  ///< 現在の書き込み位置（リングバッファのヘッド）
+    uint16_t intervals[RECORD_SIZE]; ///< 前のデータからの経過秒数（items と同じ位置）
+    uint8_t events[RECORD_SIZE];     ///< イベントのビットフラグ（items と同じ位置）
+    uint32_t newestTime;             ///< 最新データの時刻（秒）
 
     /**
      * @brief コンストラクタ
      *
      * データをゼロ初期化します。
      */
-    HumidityData() : record{}, head(0)
+    HumidityData() : intervals{}, events{}, newestTime(0)
     {
     }
 
     /**
      * @brief インデックス演算子オーバーロード
      *
-     * リングバッファとして動作するようにインデックスを計算します。
+     * @param index アクセスするデータのインデックス（0 が最新）
+     * @return float 指定インデックスの湿度値（%）
+     */
+    float operator[](size_t index) const
+    {
+        return HumidityEncoding::decode(at(index));
+    }
+
+    /**
+     * @brief 配列上の位置のエンコード済み湿度値を取得する
      *
-     * @param index アクセスするデータのインデックス
-     * @return float& 指定インデックスの湿度データへの参照
+     * @param position 配列上の位置（getRanges() の区間内）
      */
-    const float &operator[](size_t index) const
+    Sample sampleAt(size_t position) const
     {
-        return record[(head - 1 - index + RECORD_SIZE) % RECORD_SIZE];
+        return items[position];
+    }
+
+    /**
+     * @brief 配列上の位置のイベントを取得する
+     *
+     * @param position 配列上の位置（getRanges() の区間内）
+     */
+    uint8_t eventsAt(size_t position) const
+    {
+        return events[position];
+    }
+
+    /**
+     * @brief 配列上の位置の、前のデータからの経過秒数を取得する
+     *
+     * @param position 配列上の位置（getRanges() の区間内）
+     */
+    uint16_t intervalAt(size_t position) const
+    {
+        return intervals[position];
     }
 
     /**
      * @brief 湿度データを追加
      *
-     * @param humidity 追加する湿度値
+     * @param humidity 追加する湿度値（%）
+     * @param timestamp 記録した時刻（秒）
+     * @param flags イベントのビットフラグ
+     */
+    void push(float humidity, uint32_t timestamp, uint8_t flags = 0)
+    {
+        pushSample(HumidityEncoding::encode(humidity), timestamp, flags);
+    }
+
+    /**
+     * @brief エンコード済みの湿度データを追加
+     *
+     * @param sample 追加するエンコード済みの湿度値
+     * @param timestamp 記録した時刻（秒）
+     * @param flags イベントのビットフラグ
      */
-    void push(float humidity)
+    void pushSample(Sample sample, uint32_t timestamp, uint8_t flags)
     {
-        record[head] = humidity;
-        head = (head + 1) % RECORD_SIZE;
+        // 時計が戻った場合や、間隔が列に収まらない場合は経過秒数を不明とする
+        uint32_t interval = timestamp - newestTime;
+        bool known = count > 0 && timestamp >= newestTime && interval < INTERVAL_UNKNOWN;
+        pushRecord(sample, timestamp, known ? interval : INTERVAL_UNKNOWN, flags);
+    }
+
+    /**
+     * @brief 記録間隔を指定してエンコード済みの湿度データを追加
+     *
+     * 保存済みのデータを復元する場合に使用します。
+     *
+     * @param sample 追加するエンコード済みの湿度値
+     * @param timestamp 記録した時刻（秒）
+     * @param interval 前のデータからの経過秒数
+     * @param flags イベントのビットフラグ
+     */
+    void pushRecord(Sample sample, uint32_t timestamp, uint16_t interval, uint8_t flags)
+    {
+        intervals[head] = interval;
+        events[head] = flags;
+        newestTime = timestamp;
+        RingBuffer::push(sample);
+    }
+
+    /**
+     * @brief 指定したデータから最新データまでの経過秒数を取得する
+     *
+     * 記録間隔の列だけを走査します。
+     *
+     * @param index データのインデックス（0 が最新）
+     * @param fallback 経過秒数が不明な間隔に使う値
+     * @return uint32_t 経過秒数
+     */
+    uint32_t getElapsed(size_t index, uint32_t fallback = 0) const
+    {
+        uint32_t elapsed = 0;
+        for (size_t i = 0; i < index; i++)
+        {
+            uint16_t interval = intervals[(head - 1 - i) & MASK];
+            elapsed += interval == INTERVAL_UNKNOWN ? fallback : interval;
+        }
+        return elapsed;
+    }
+
+    /**
+     * @brief 最新の指定件数のデータを古い順に列挙する
+     *
+     * 列を配列上の連続した区間ごとに走査し、各データの位置と時刻をコールバックに渡します。
+     *
+     * @param newest 列挙する最新データ数
+     * @param fallback 経過秒数が不明な間隔に使う値
+     * @param visitor bool(size_t index, uint32_t timestamp) の形のコールバック。false を返すと中断
+     * @return size_t 列挙を終えたデータ数
+     */
+    template <typename Visitor> size_t visitNewest(size_t newest, uint32_t fallback, Visitor visitor) const
+    {
+        Range ranges[2];
+        getRanges(ranges[0], ranges[1], newest);
+        size_t n = ranges[0].size + ranges[1].size;
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        uint32_t timestamp = newestTime - getElapsed(n - 1, fallback);
+        size_t visited = 0;
+        for (const Range &range : ranges)
+        {
+            for (size_t index = range.start; index < range.start + range.size; index++)
+            {
+                if (visited > 0)
+                {
+                    timestamp += intervals[index] == INTERVAL_UNKNOWN ? fallback : intervals[index];
+                }
+                if (!visitor(index, timestamp))
+                {
+                    return visited;
+                }
+                visited++;
+            }
+        }
+        return visited;
     }
 
     /**
@@ -52,7 +260,9 @@ struct HumidityData
      */
     void clear()
     {
-        memset(record, 0, sizeof(record));
-        head = 0;
+        RingBuffer::clear();
+        memset(intervals, 0, sizeof(intervals));
+        memset(events, 0, sizeof(events));
+        newestTime = 0;
     }
-};
\ No newline at end of file
+};
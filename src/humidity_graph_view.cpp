@@ -0,0 +1,229 @@
+#include "humidity_graph_view.h"
+#include <algorithm>
+#include <string.h>
+
+void HumidityGraphView::draw(const HumidityPyramid &pyramid, const int x, const int y, const int w, const int h, const size_t level)
+{
+    // 1列につき1つの平均値を読むだけで描画する（記録済みのデータがある列のみ）
+    int columns = std::min<int>(w, pyramid.getColumnCount(level));
+    int scale = HumidityPyramid::getScale(level);
+
+    char scaleStr[8];
+    sprintf(scaleStr, "1/%dx", scale);
+
+    // 右上に縮尺を表示
+    oled.setFont(u8g2_font_04b_03b_tr);
+    int scaleStrWidth = oled.getStrWidth(scaleStr);
+    oled.drawStr(x + w - scaleStrWidth, y + 6, scaleStr);
+
+    // 表示範囲内の最大値・最小値を取得（記録済みのデータがなければグラフは描かない）
+    float minVal;
+    float maxVal;
+    if (columns == 0 || !pyramid.getBounds(level, minVal, maxVal))
+    {
+        valid = false;
+        return;
+    }
+
+    // 最小値・最大値を描画
+    char minStr[8], maxStr[8];
+    sprintf(minStr, "%.1f", minVal);
+    sprintf(maxStr, "%.1f", maxVal);
+    oled.drawStr(x, y + 6, maxStr);
+    oled.drawStr(x, y + h, minStr);
+
+    // キャッシュした折れ線を重ねる（文字の後に重ねるため、折れ線が文字より手前になる）
+    if (updateCache(pyramid, x, y, w, h, level, columns, minVal, maxVal))
+    {
+        blit();
+        return;
+    }
+
+    // キャッシュに収まらない描画領域では、毎回すべての列を描く
+    float range = maxVal - minVal;
+    int prevX, prevY;
+    for (int i = 0; i < columns; i++)
+    {
+        int currentX = x + w - 1 - i;
+        int currentY;
+
+        if (range == 0)
+        {
+            currentY = y + h / 2;
+        }
+        else
+        {
+            float normalized = (pyramid.getColumn(level, i) - minVal) / range;
+            currentY = y + (h - 1) - (int)(normalized * (h - 1));
+        }
+
+        if (i != 0)
+        {
+            oled.drawLine(prevX, prevY, currentX, currentY);
+        }
+
+        // ポンプが稼働した列には下端に目印を描く
+        if (pyramid.getColumnEvents(level, i) & HumidityData::EVENT_PUMP)
+        {
+            oled.drawVLine(currentX, y + h - 2, 2);
+        }
+        prevX = currentX;
+        prevY = currentY;
+    }
+}
+
+bool HumidityGraphView::updateCache(const HumidityPyramid &pyramid, int x, int y, int w, int h, size_t level, int columns,
+                                    float minVal, float maxVal)
+{
+    int bufferWidth = oled.getBufferTileWidth() * 8;
+    int bufferHeight = oled.getBufferTileHeight() * 8;
+    if (x < 0 || y < 0 || h < 2 || x + w > std::min<int>(bufferWidth, MAX_WIDTH) || y + h > bufferHeight)
+    {
+        valid = false;
+        return false;
+    }
+
+    float range = maxVal - minVal;
+    uint32_t pushed = pyramid.getPushedCount(level);
+    uint32_t shift = pushed - cachedPushed;
+
+    // 縦軸・縮尺・描画領域が変わった場合や、作り直された場合は全体を描き直す
+    bool full = !valid || x != cachedX || y != cachedY || w != cachedW || h != cachedH || level != cachedLevel ||
+                minVal != cachedMin || maxVal != cachedMax || pyramid.getGeneration() != cachedGeneration ||
+                shift >= static_cast<uint32_t>(columns) || columns != std::min<int>(w, cachedColumns + shift);
+
+    cachedX = x;
+    cachedY = y;
+    cachedW = w;
+    cachedH = h;
+    cachedLevel = level;
+    cachedMin = minVal;
+    cachedMax = maxVal;
+    cachedGeneration = pyramid.getGeneration();
+    cachedPushed = pushed;
+    cachedColumns = columns;
+    valid = true;
+
+    if (full)
+    {
+        memset(cache, 0, sizeof(cache));
+        for (int i = 0; i < columns; i++)
+        {
+            computeColumn(pyramid, i, minVal, range);
+        }
+        for (int i = 0; i < columns; i++)
+        {
+            renderColumn(i);
+        }
+        fullRenderCount++;
+        return true;
+    }
+
+    // 確定した列の数だけ古い方へずらす（最新の列は確定して1つ古い列になる）
+    if (shift > 0)
+    {
+        size_t rows = (y + h - 1) / 8 - y / 8 + 1;
+        for (size_t row = 0; row < rows; row++)
+        {
+            memmove(&cache[row][x], &cache[row][x + shift], w - shift);
+        }
+        memmove(plotY + shift, plotY, (columns - shift) * sizeof(plotY[0]));
+        memmove(pumped + shift, pumped, (columns - shift) * sizeof(pumped[0]));
+
+        // 表示範囲から外れた列につながっていた、最も古い列の線を消す
+        renderColumn(columns - 1);
+    }
+
+    // 新しい列（と値が変わり得る最新の列）の値を求め、その隣の列までを描き直す
+    for (uint32_t i = 0; i <= shift; i++)
+    {
+        computeColumn(pyramid, i, minVal, range);
+    }
+    for (uint32_t i = 0; i <= shift + 1 && i < static_cast<uint32_t>(columns); i++)
+    {
+        renderColumn(i);
+    }
+    incrementalRenderCount++;
+    return true;
+}
+
+void HumidityGraphView::computeColumn(const HumidityPyramid &pyramid, int column, float minVal, float range)
+{
+    if (range == 0)
+    {
+        plotY[column] = cachedY + cachedH / 2;
+    }
+    else
+    {
+        // 丸め誤差で描画領域からはみ出さないようにする
+        float normalized = (pyramid.getColumn(cachedLevel, column) - minVal) / range;
+        normalized = std::min(std::max(normalized, 0.0f), 1.0f);
+        plotY[column] = cachedY + (cachedH - 1) - (int)(normalized * (cachedH - 1));
+    }
+    pumped[column] = pyramid.getColumnEvents(cachedLevel, column) & HumidityData::EVENT_PUMP;
+}
+
+void HumidityGraphView::renderColumn(int column)
+{
+    int px = cachedX + cachedW - 1 - column;
+    clearColumn(px);
+
+    // 隣の列との中点までを縦線で結ぶ（列が1つだけの場合は線を描かない）
+    int py = plotY[column];
+    int top = py;
+    int bottom = py;
+    bool connected = false;
+    for (int neighbor : {column - 1, column + 1})
+    {
+        if (neighbor < 0 || neighbor >= cachedColumns)
+        {
+            continue;
+        }
+
+        int end = py + (plotY[neighbor] - py) / 2;
+        top = std::min(top, end);
+        bottom = std::max(bottom, end);
+        connected = true;
+    }
+    if (connected)
+    {
+        for (int i = top; i <= bottom; i++)
+        {
+            setPixel(px, i);
+        }
+    }
+
+    // ポンプが稼働した列には下端に目印を描く
+    if (pumped[column])
+    {
+        setPixel(px, cachedY + cachedH - 2);
+        setPixel(px, cachedY + cachedH - 1);
+    }
+}
+
+void HumidityGraphView::clearColumn(int px)
+{
+    size_t rows = (cachedY + cachedH - 1) / 8 - cachedY / 8 + 1;
+    for (size_t row = 0; row < rows; row++)
+    {
+        cache[row][px] = 0;
+    }
+}
+
+void HumidityGraphView::blit()
+{
+    // キャッシュは描画領域の列・タイル行だけを持つため、その範囲だけを論理和で重ねる
+    uint8_t *buffer = oled.getBufferPtr();
+    size_t bufferWidth = oled.getBufferTileWidth() * 8;
+    size_t firstRow = cachedY / 8;
+    size_t rows = (cachedY + cachedH - 1) / 8 - firstRow + 1;
+    for (size_t row = 0; row < rows; row++)
+    {
+        uint8_t *dst = buffer + (firstRow + row) * bufferWidth + cachedX;
+        const uint8_t *src = &cache[row][cachedX];
+        for (int i = 0; i < cachedW; i++)
+        {
+            dst[i] |= src[i];
+        }
+    }
+}
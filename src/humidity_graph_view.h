@@ -0,0 +1,129 @@
+#pragma once
+
+#include "humidity_pyramid.h"
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+/**
+ * @brief 湿度の履歴グラフの描画
+ *
+ * HumidityPyramid の指定した段を、1列につき1つの平均値を読むだけで描画します。
+ * 単一の植木鉢の画面（GreenThumbApp）と、複数の植木鉢の画面（MultiPlantApp）で共用します。
+ *
+ * 折れ線は U8G2 のバッファと同じ形（8ピクセル高さのタイル行ごとに、1列1バイト）のキャッシュに描いておき、
+ * 毎回の描画ではキャッシュをバッファに重ねるだけです。新しい列が確定した場合はキャッシュを左へずらし、
+ * 新しい列と隣の列だけを描き直します（最新の列は記録のたびに値が変わるため、毎回描き直します）。
+ * 表示範囲の最大値・最小値、縮尺、描画領域が変わった場合や、ダウンサンプルが作り直された場合は全体を描き直します。
+ */
+class HumidityGraphView final
+{
+public:
+    constexpr static size_t MAX_WIDTH = HumidityPyramid::COLUMNS; ///< キャッシュできる最大の幅（ピクセル）
+    constexpr static size_t MAX_TILE_ROWS = 8;                    ///< キャッシュできる最大のタイル行数（64ピクセル）
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param oled OLEDディスプレイオブジェクトへの参照
+     */
+    explicit HumidityGraphView(U8G2 &oled) : oled(oled)
+    {
+    }
+
+    /**
+     * @brief 湿度の履歴グラフを描画する
+     *
+     * 右上に縮尺、左側に表示範囲の最大値・最小値を描き、ポンプが稼働した列には下端に目印を描きます。
+     *
+     * @param pyramid 表示するダウンサンプル
+     * @param x 描画領域の左上X座標
+     * @param y 描画領域の左上Y座標
+     * @param w 描画領域の幅
+     * @param h 描画領域の高さ
+     * @param level 縮尺の段（HumidityPyramid の段、0 が 1x）
+     */
+    void draw(const HumidityPyramid &pyramid, const int x, const int y, const int w, const int h, const size_t level = 0);
+
+    /**
+     * @brief 全体を描き直した回数を取得する
+     */
+    uint32_t getFullRenderCount() const
+    {
+        return fullRenderCount;
+    }
+
+    /**
+     * @brief 新しい列だけを描き直した回数を取得する（キャッシュをそのまま使った回数を含む）
+     */
+    uint32_t getIncrementalRenderCount() const
+    {
+        return incrementalRenderCount;
+    }
+
+private:
+    U8G2 &oled; ///< OLEDディスプレイ
+
+    uint8_t cache[MAX_TILE_ROWS][MAX_WIDTH] = {}; ///< 折れ線を描いたキャッシュ（タイル行ごとに、1列1バイト）
+    uint8_t plotY[MAX_WIDTH] = {};                ///< 列ごとの折れ線のY座標（0 が最新の列）
+    bool pumped[MAX_WIDTH] = {};                  ///< 列ごとのポンプの稼働の有無（0 が最新の列）
+
+    bool valid = false;            ///< キャッシュが使えるかどうか
+    int cachedX = 0;               ///< キャッシュした描画領域の左上X座標
+    int cachedY = 0;               ///< キャッシュした描画領域の左上Y座標
+    int cachedW = 0;               ///< キャッシュした描画領域の幅
+    int cachedH = 0;               ///< キャッシュした描画領域の高さ
+    size_t cachedLevel = 0;        ///< キャッシュした縮尺の段
+    float cachedMin = 0.0f;        ///< キャッシュした表示範囲の最小値（%）
+    float cachedMax = 0.0f;        ///< キャッシュした表示範囲の最大値（%）
+    uint32_t cachedGeneration = 0; ///< キャッシュしたときのダウンサンプルの作り直し回数
+    uint32_t cachedPushed = 0;     ///< キャッシュしたときの確定したバケットの累計数
+    int cachedColumns = 0;         ///< キャッシュした列数
+
+    uint32_t fullRenderCount = 0;        ///< 全体を描き直した回数
+    uint32_t incrementalRenderCount = 0; ///< 新しい列だけを描き直した回数
+
+    /**
+     * @brief キャッシュを更新する
+     *
+     * @return true キャッシュを使える
+     * @return false キャッシュに収まらない描画領域
+     */
+    bool updateCache(const HumidityPyramid &pyramid, int x, int y, int w, int h, size_t level, int columns, float minVal,
+                     float maxVal);
+
+    /**
+     * @brief 列の値と目印の有無を求める
+     *
+     * @param column 列（0 が最新）
+     */
+    void computeColumn(const HumidityPyramid &pyramid, int column, float minVal, float range);
+
+    /**
+     * @brief キャッシュの1列を描き直す
+     *
+     * 隣の列との中点までを縦線で結び、隣り合う列で1本の折れ線になるようにします。
+     *
+     * @param column 列（0 が最新）
+     */
+    void renderColumn(int column);
+
+    /**
+     * @brief キャッシュの1列を消す
+     *
+     * @param px 列のX座標
+     */
+    void clearColumn(int px);
+
+    /**
+     * @brief キャッシュの1ピクセルを描く
+     */
+    void setPixel(int px, int py)
+    {
+        cache[py / 8 - cachedY / 8][px] |= 1 << (py % 8);
+    }
+
+    /**
+     * @brief キャッシュを U8G2 のバッファに重ねる
+     */
+    void blit();
+};
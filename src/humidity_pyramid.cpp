@@ -0,0 +1,212 @@
+#include "humidity_pyramid.h"
+
+void HumidityPyramid::clear()
+{
+    for (Level &level : levels)
+    {
+        level.head = 0;
+        level.size = 0;
+        level.partialSamples = 0;
+        level.minWindow.clear();
+        level.maxWindow.clear();
+    }
+    syncedCount = 0;
+    generation++;
+    openSamples = 0;
+    openTick = 0;
+    clock = 0;
+}
+
+void HumidityPyramid::pushSample(HumidityData::Sample sample, uint8_t events, uint16_t interval)
+{
+    if (openSamples > 0)
+    {
+        clock += getInterval(interval);
+        uint32_t tick = clock / tickSeconds;
+        if (tick != openTick)
+        {
+            // それまでの列を平均値で確定する（最小値・最大値は列内のデータのまま）
+            Bucket closed = open;
+            closed.sum = (open.sum + openSamples / 2) / openSamples;
+            push(closed);
+
+            // データのなかった列は直前の値で埋める（表示範囲を超える分は最上段の縮尺の倍数単位で省く）
+            constexpr uint32_t topScale = getScale(LEVEL_COUNT - 1);
+            uint32_t gap = tick - openTick - 1;
+            if (gap > WINDOW)
+            {
+                gap -= (gap - WINDOW) / topScale * topScale;
+            }
+            Bucket held = {lastSample, lastSample, lastSample, 0};
+            for (uint32_t i = 0; i < gap; i++)
+            {
+                push(held);
+            }
+
+            openTick = tick;
+            openSamples = 0;
+        }
+    }
+
+    if (openSamples == 0)
+    {
+        open = {sample, sample, sample, events};
+    }
+    else
+    {
+        open.sum += sample;
+        open.min = std::min(open.min, sample);
+        open.max = std::max(open.max, sample);
+        open.events |= events;
+    }
+    openSamples++;
+    lastSample = sample;
+}
+
+void HumidityPyramid::push(const Bucket &column)
+{
+    // 下の段でバケットが埋まったときだけ上の段へ繰り上げる
+    Bucket bucket = column;
+    for (size_t i = 0; i < LEVEL_COUNT; i++)
+    {
+        Level &level = levels[i];
+        if (i > 0)
+        {
+            if (level.partialSamples == 0)
+            {
+                level.partial = bucket;
+            }
+            else
+            {
+                level.partial.sum += bucket.sum;
+                level.partial.min = std::min(level.partial.min, bucket.min);
+                level.partial.max = std::max(level.partial.max, bucket.max);
+                level.partial.events |= bucket.events;
+            }
+            level.partialSamples += getScale(i - 1);
+            if (level.partialSamples < getScale(i))
+            {
+                return;
+            }
+
+            bucket = level.partial;
+            level.partialSamples = 0;
+        }
+
+        level.buckets[level.head] = bucket;
+        level.head = (level.head + 1) % COLUMNS;
+        level.size = std::min(level.size + 1, COLUMNS);
+        level.pushed++;
+        level.minWindow.push(bucket.min);
+        level.maxWindow.push(bucket.max);
+    }
+}
+
+void HumidityPyramid::getPartial(size_t level, Bucket &partial, uint32_t &samples) const
+{
+    // 最新の列（まだ確定していない列）は平均値を1列分として含める
+    partial = {};
+    samples = 0;
+    if (openSamples > 0)
+    {
+        partial = open;
+        partial.sum = (open.sum + openSamples / 2) / openSamples;
+        samples = 1;
+    }
+
+    for (size_t i = 1; i <= level; i++)
+    {
+        const Level &l = levels[i];
+        if (l.partialSamples == 0)
+        {
+            continue;
+        }
+
+        if (samples == 0)
+        {
+            partial = l.partial;
+        }
+        else
+        {
+            partial.sum += l.partial.sum;
+            partial.min = std::min(partial.min, l.partial.min);
+            partial.max = std::max(partial.max, l.partial.max);
+            partial.events |= l.partial.events;
+        }
+        samples += l.partialSamples;
+    }
+}
+
+float HumidityPyramid::getColumn(size_t level, size_t column) const
+{
+    const Level &l = levels[level];
+    Bucket partial;
+    uint32_t samples;
+    getPartial(level, partial, samples);
+
+    // 最新の列は埋まっていないバケット（あれば）
+    if (samples > 0 && column == 0)
+    {
+        return HumidityEncoding::decode((partial.sum + samples / 2) / samples);
+    }
+    if (samples > 0)
+    {
+        column--;
+    }
+
+    samples = getScale(level);
+    uint32_t sum = l.buckets[(l.head + COLUMNS - 1 - column) % COLUMNS].sum;
+    return HumidityEncoding::decode((sum + samples / 2) / samples);
+}
+
+bool HumidityPyramid::getBounds(size_t level, float &minVal, float &maxVal) const
+{
+    const Level &l = levels[level];
+    Bucket edge;
+    uint32_t samples;
+    getPartial(level, edge, samples);
+
+    // 単調キューに含まれない1列（埋まっていないバケット、なければ最も古いバケット）を合わせる
+    bool hasEdge = samples > 0;
+    if (!hasEdge && l.size == COLUMNS)
+    {
+        edge = l.buckets[l.head];
+        hasEdge = true;
+    }
+
+    if (l.minWindow.empty() && !hasEdge)
+    {
+        return false;
+    }
+
+    HumidityData::Sample minSample = l.minWindow.empty() ? edge.min : l.minWindow.get();
+    HumidityData::Sample maxSample = l.maxWindow.empty() ? edge.max : l.maxWindow.get();
+    if (hasEdge)
+    {
+        minSample = std::min(minSample, edge.min);
+        maxSample = std::max(maxSample, edge.max);
+    }
+
+    minVal = HumidityEncoding::decode(minSample);
+    maxVal = HumidityEncoding::decode(maxSample);
+    return true;
+}
+
+uint8_t HumidityPyramid::getColumnEvents(size_t level, size_t column) const
+{
+    const Level &l = levels[level];
+    Bucket partial;
+    uint32_t samples;
+    getPartial(level, partial, samples);
+
+    if (samples > 0 && column == 0)
+    {
+        return partial.events;
+    }
+    if (samples > 0)
+    {
+        column--;
+    }
+
+    return l.buckets[(l.head + COLUMNS - 1 - column) % COLUMNS].events;
+}
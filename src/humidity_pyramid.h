@@ -0,0 +1,259 @@
+#pragma once
+
+#include "humidity_data.h"
+#include "sliding_extremum.h"
+#include <Arduino.h>
+
+/**
+ * @brief グラフ表示用の多段ダウンサンプル（1x/4x/16x/64x）
+ *
+ * 最下段（1x）の1列は一定の時間（tickSeconds 秒）で、記録間隔が一定でないデータも時間軸が均等なグラフになります。
+ * 1列の間に複数のデータがある場合は平均し、データのない列は直前のデータの値で埋めます
+ * （値が変わらない間は記録を間引くため、次のデータまで値は保たれているとみなします）。
+ *
+ * 縮尺ごとに、一定数の列をまとめたバケット（グラフの1列分）の合計値を COLUMNS 個ずつ保持します。
+ * 新しい列を追加したときは、下の段でバケットが埋まった場合だけ上の段へ繰り上げるため、
+ * 1列あたりの更新は O(1) です。どの縮尺でもグラフの1列につき1つの値を読むだけで描画できます。
+ *
+ * バケットの境界は作り直したときの最初のデータからの経過時間で揃えており、
+ * 最新の列はまだ埋まっていないバケット（時間が縮尺未満）になることがあります。
+ * 値はエンコード済みの整数のまま合計するため、浮動小数点演算は読み出し時だけです。
+ *
+ * 各段は表示範囲内の最小値・最大値も単調キューで保持しており、グラフの上下限を O(1) で取得できます。
+ * 記録されたことのないスロット（クリア直後や起動直後の空き）はバケットに含めません。
+ */
+class HumidityPyramid final
+{
+public:
+    constexpr static size_t LEVEL_COUNT = 4; ///< 段数（1x, 4x, 16x, 64x）
+    constexpr static size_t FACTOR = 4;      ///< 1段上がるごとの縮尺の倍率
+    constexpr static size_t COLUMNS = 128;   ///< 各段で保持するバケット数（ディスプレイの幅）
+
+    /**
+     * @brief 指定した段の縮尺（1バケットあたりの最下段の列数）を取得する
+     */
+    constexpr static uint32_t getScale(size_t level)
+    {
+        return level == 0 ? 1 : FACTOR * getScale(level - 1);
+    }
+
+    constexpr static size_t WINDOW = COLUMNS * 64; ///< 最上段（64x）の表示に必要な最下段の列数
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param tickSeconds 最下段（1x）の1列あたりの時間（秒）
+     */
+    explicit HumidityPyramid(uint32_t tickSeconds) : tickSeconds(tickSeconds)
+    {
+    }
+
+    /**
+     * @brief 前回以降に追加されたデータを反映する
+     *
+     * データがクリアされた場合や、追加されたデータがすでに上書きされている場合は作り直します。
+     *
+     * @param data 湿度データ（HumidityData、または MultiHumidityData::ChannelView）
+     */
+    template <typename Source> void update(const Source &data)
+    {
+        // クリアされた場合や、差分がリングバッファに残っていない場合は作り直す
+        if (data.count < syncedCount || data.count - syncedCount > data.size())
+        {
+            rebuild(data);
+            return;
+        }
+
+        pushNewest(data, data.count - syncedCount);
+        syncedCount = data.count;
+    }
+
+    /**
+     * @brief 湿度データから作り直す
+     *
+     * 履歴を読み込んだときや表示するチャンネルを切り替えたときなど、
+     * push() を経由せずにデータが変わった場合に呼び出してください。
+     *
+     * @param data 湿度データ（HumidityData、または MultiHumidityData::ChannelView）
+     */
+    template <typename Source> void rebuild(const Source &data)
+    {
+        clear();
+
+        // 最上段の表示範囲の時間に掛かるデータ数を、最新のデータから記録間隔をたどって求め、古い順に追加する
+        // （記録されたことのないスロットは含めない）
+        const uint32_t span = WINDOW * tickSeconds;
+        size_t samples = 0;
+        uint32_t age = 0;
+        while (samples < data.size() && age < span)
+        {
+            age += getInterval(data.intervalAt(data.position(samples)));
+            samples++;
+        }
+        pushNewest(data, samples);
+        syncedCount = data.count;
+    }
+
+    /**
+     * @brief 指定した段で表示できる列数を取得する
+     *
+     * @param level 段（0 が 1x）
+     * @return size_t 列数（最大 COLUMNS）
+     */
+    size_t getColumnCount(size_t level) const
+    {
+        Bucket partial;
+        uint32_t samples;
+        getPartial(level, partial, samples);
+        return std::min(COLUMNS, levels[level].size + (samples > 0 ? 1 : 0));
+    }
+
+    /**
+     * @brief 指定した列の平均値を取得する
+     *
+     * @param level 段（0 が 1x）
+     * @param column 列（0 が最新）
+     * @return float 平均湿度（%）
+     */
+    float getColumn(size_t level, size_t column) const;
+
+    /**
+     * @brief 指定した段で表示される範囲の最小値と最大値を取得する
+     *
+     * @param level 段（0 が 1x）
+     * @param[out] minVal 最小湿度（%）
+     * @param[out] maxVal 最大湿度（%）
+     * @return true 取得成功
+     * @return false 記録済みのデータがない
+     */
+    bool getBounds(size_t level, float &minVal, float &maxVal) const;
+
+    /**
+     * @brief 指定した列に含まれるイベントを取得する
+     *
+     * @param level 段（0 が 1x）
+     * @param column 列（0 が最新）
+     * @return uint8_t 列内のデータのイベントの論理和（HumidityData::Event）
+     */
+    uint8_t getColumnEvents(size_t level, size_t column) const;
+
+    /**
+     * @brief 指定した段で確定したバケットの累計数を取得する
+     *
+     * 前回から増えた数だけ、グラフの列が古い方へずれています。
+     *
+     * @param level 段（0 が 1x）
+     */
+    uint32_t getPushedCount(size_t level) const
+    {
+        return levels[level].pushed;
+    }
+
+    /**
+     * @brief 作り直した回数を取得する
+     *
+     * 値が変わった場合、確定済みのバケットも入れ替わっています。
+     */
+    uint32_t getGeneration() const
+    {
+        return generation;
+    }
+
+private:
+    /**
+     * @brief まとめたデータの合計値・最小値・最大値
+     */
+    struct Bucket
+    {
+        uint32_t sum;             ///< 合計値
+        HumidityData::Sample min; ///< 最小値
+        HumidityData::Sample max; ///< 最大値
+        uint8_t events;           ///< イベントの論理和
+    };
+
+    /**
+     * @brief 1段分のバケット
+     */
+    struct Level
+    {
+        Bucket buckets[COLUMNS]; ///< 埋まったバケット（リングバッファ）
+        size_t head;             ///< 次に書き込む位置
+        size_t size;             ///< 埋まったバケット数（最大 COLUMNS）
+        Bucket partial;          ///< 埋まっていないバケット
+        uint32_t partialSamples; ///< 埋まっていないバケットの最下段の列数
+        uint32_t pushed;         ///< 確定したバケットの累計数
+
+        // 表示する COLUMNS 列のうち、埋まっていないバケット（なければ最も古いバケット）を除いた列の極値
+        SlidingExtremum<HumidityData::Sample, COLUMNS - 1, std::less<HumidityData::Sample>> minWindow;    ///< 直近のバケットの最小値
+        SlidingExtremum<HumidityData::Sample, COLUMNS - 1, std::greater<HumidityData::Sample>> maxWindow; ///< 直近のバケットの最大値
+    };
+
+    uint32_t tickSeconds;           ///< 最下段の1列あたりの時間（秒）
+    Level levels[LEVEL_COUNT] = {}; ///< 各段のバケット
+    uint32_t syncedCount = 0;       ///< 反映済みの累計データ数
+    uint32_t generation = 0;        ///< 作り直した回数
+
+    Bucket open = {};                    ///< 最新の列（まだ時間が経過していない列）のデータの合計値・最小値・最大値
+    uint32_t openSamples = 0;            ///< 最新の列のデータ数（0 は作り直してからデータがないことを表す）
+    uint32_t openTick = 0;               ///< 最新の列の番号（作り直したときの最初のデータの列が 0）
+    uint32_t clock = 0;                  ///< 最後に追加したデータの時刻（作り直したときの最初のデータからの秒数）
+    HumidityData::Sample lastSample = 0; ///< 最後に追加したデータ（データのない列を埋める値）
+
+    /**
+     * @brief 記録間隔を秒数に変換する（不明な場合は1列分とみなす）
+     */
+    uint32_t getInterval(uint16_t interval) const
+    {
+        return interval == HumidityData::INTERVAL_UNKNOWN ? tickSeconds : interval;
+    }
+
+    /**
+     * @brief 最下段の1列分のバケットを追加し、埋まったバケットを上の段へ繰り上げる
+     */
+    void push(const Bucket &column);
+
+    /**
+     * @brief エンコード済みのデータを1件追加する
+     *
+     * 前のデータから列が変わった場合は、それまでの列を確定し、データのなかった列を埋めます。
+     *
+     * @param sample エンコード済みの湿度値
+     * @param events イベントのビットフラグ
+     * @param interval 前のデータからの経過秒数
+     */
+    void pushSample(HumidityData::Sample sample, uint8_t events, uint16_t interval);
+
+    /**
+     * @brief 最新のデータを指定した数だけ古い順に追加する
+     *
+     * データ側は getRanges() と、配列上の位置を受け取る sampleAt()・eventsAt()・intervalAt() を持つ必要があります。
+     */
+    template <typename Source> void pushNewest(const Source &data, size_t samples)
+    {
+        typename Source::Range ranges[2];
+        data.getRanges(ranges[0], ranges[1], samples);
+        for (const typename Source::Range &range : ranges)
+        {
+            for (size_t i = range.start; i < range.start + range.size; i++)
+            {
+                pushSample(data.sampleAt(i), data.eventsAt(i), data.intervalAt(i));
+            }
+        }
+    }
+
+    /**
+     * @brief 指定した段の埋まっていないバケットと、最下段の列数を取得する
+     *
+     * 最新の列と、下の段で埋まっていないバケットも含めます。
+     */
+    void getPartial(size_t level, Bucket &partial, uint32_t &samples) const;
+
+    /**
+     * @brief すべての段を空にする
+     */
+    void clear();
+};
+
+static_assert(HumidityPyramid::WINDOW == HumidityPyramid::COLUMNS * HumidityPyramid::getScale(HumidityPyramid::LEVEL_COUNT - 1),
+              "WINDOW must cover the top level");
+static_assert(HumidityData::RECORD_SIZE >= HumidityPyramid::WINDOW, "HumidityData must hold the whole top level");
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "button.h"
+#include "humidity_calibration.h"
 #include <Arduino.h>
 
 /**
@@ -24,7 +25,7 @@ public:
 /**
  * @brief GPIO（アナログ入力）を使用した湿度読み取りの実装
  *
- * アナログピンから値を読み取り、0〜100%の湿度値に変換します。
+ * アナログピンからキャリブレーション済みの電圧を読み取り、校正値の変換テーブルで0〜100%の湿度値に変換します。
  */
 class GPIOHumidityReader final : public IHumidityReader
 {
@@ -33,26 +34,94 @@ public:
      * @brief コンストラクタ
      *
      * @param sensorPin センサーが接続されているアナログピン番号
+     * @param calibration センサーの校正値
      */
-    explicit GPIOHumidityReader(int sensorPin) : sensorPin(sensorPin)
+    explicit GPIOHumidityReader(int sensorPin, const HumidityCalibration &calibration = HumidityCalibration())
+        : sensorPin(sensorPin), calibration(calibration)
     {
     }
 
     /**
-     * @brief アナログピンから値を読み取り、湿度を計算する
-     *
-     * 12bit ADC (0-4095) を想定して計算しています。
+     * @brief アナログピンから電圧を読み取り、湿度を計算する
      *
      * @return float 湿度値（%）
      */
     float readHumidity() override
     {
-        const int sensorValue = analogRead(sensorPin);
-        return static_cast<float>(sensorValue) / 4096.0f * 100.0f;
+        return calibration.toHumidity(analogReadMilliVolts(sensorPin));
+    }
+
+private:
+    int sensorPin;                   ///< センサーピン番号
+    HumidityCalibration calibration; ///< センサーの校正値
+};
+
+/**
+ * @brief 複数の湿度センサーをまとめて読み取るインターフェース
+ *
+ * 複数の植木鉢を1台で管理する場合に、全チャンネルの湿度を1回の呼び出しで取得します。
+ */
+class IMultiHumidityReader
+{
+public:
+    virtual ~IMultiHumidityReader() = default;
+
+    /**
+     * @brief チャンネル数を取得する
+     */
+    virtual size_t getChannelCount() const = 0;
+
+    /**
+     * @brief 全チャンネルの湿度を読み取る
+     *
+     * @param[out] humidity チャンネルごとの湿度値（0.0 〜 100.0 %、getChannelCount() 個）
+     */
+    virtual void readAll(float *humidity) = 0;
+};
+
+/**
+ * @brief 複数のアナログピンをまとめて読み取る湿度リーダーの実装
+ *
+ * 各ピンを続けて読み取り、GPIOHumidityReader と同じ換算で湿度値に変換します。
+ */
+class GPIOMultiHumidityReader final : public IMultiHumidityReader
+{
+public:
+    /**
+     * @brief コンストラクタ
+     *
+     * @param sensorPins センサーが接続されているアナログピン番号の配列（チャンネル順）
+     * @param channelCount チャンネル数
+     * @param calibration 全センサーに共通の校正値
+     */
+    GPIOMultiHumidityReader(const uint8_t *sensorPins, size_t channelCount,
+                            const HumidityCalibration &calibration = HumidityCalibration())
+        : sensorPins(sensorPins), channelCount(channelCount), calibration(calibration)
+    {
+    }
+
+    size_t getChannelCount() const override
+    {
+        return channelCount;
+    }
+
+    /**
+     * @brief 全ピンから電圧を読み取り、湿度を計算する
+     *
+     * @param[out] humidity チャンネルごとの湿度値（%）
+     */
+    void readAll(float *humidity) override
+    {
+        for (size_t i = 0; i < channelCount; i++)
+        {
+            humidity[i] = calibration.toHumidity(analogReadMilliVolts(sensorPins[i]));
+        }
     }
 
 private:
-    int sensorPin; ///< センサーピン番号
+    const uint8_t *sensorPins;       ///< センサーピン番号の配列
+    size_t channelCount;             ///< チャンネル数
+    HumidityCalibration calibration; ///< 全センサーに共通の校正値
 };
 
 /**
@@ -63,6 +132,15 @@ private:
 class MockHumidityReader final : public IHumidityReader
 {
 public:
+    /**
+     * @brief コンストラクタ
+     *
+     * @param button 湿度変動をトリガーするボタン（アプリケーションと共有し、状態を読むだけでイベントは取り出さない）
+     */
+    explicit MockHumidityReader(const Button &button) : button(button)
+    {
+    }
+
     /**
      * @brief ランダムな湿度値を生成して返す
      *
@@ -70,8 +148,10 @@ public:
      */
     float readHumidity() override
     {
-        button.update();
-        if (button.wasPressed())
+        bool pressed = button.isPressed();
+        bool wasPressed = lastPressed;
+        lastPressed = pressed;
+        if (pressed && !wasPressed)
         {
             currentHumidity += 10.0f;
             if (currentHumidity > 100.0f)
@@ -83,6 +163,7 @@ public:
     }
 
 private:
-    Button button = Button(D1);    ///< 湿度変動をトリガーするためのボタン
+    const Button &button;          ///< 湿度変動をトリガーするためのボタン
+    bool lastPressed = false;      ///< 前回読み取ったときにボタンが押されていたかどうか
     float currentHumidity = 50.0f; ///< 現在の湿度値
 };
\ No newline at end of file
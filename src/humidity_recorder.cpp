@@ -1,23 +1,45 @@
 #include "humidity_recorder.h"
 
-bool SDHumidityRecorder::isSDAvailable()
+bool SDHumidityRecorder::save(const HumidityData &data)
 {
-    if (!sd.begin())
+    if (!card.ensureMounted())
     {
         return false;
     }
-    return true;
+
+    uint32_t start = micros();
+    bool ok = write(data);
+    card.recordLatency(micros() - start);
+
+    if (!ok)
+    {
+        // 書き込みに失敗した場合はカードが抜かれた可能性がある
+        card.reportFailure();
+    }
+    return ok;
 }
 
-bool SDHumidityRecorder::save(const HumidityData &data)
+bool SDHumidityRecorder::load(HumidityData &data)
 {
-    if (!isSDAvailable())
+    if (!card.ensureMounted())
+    {
         return false;
+    }
 
+    uint32_t start = micros();
+    bool ok = read(data);
+    card.recordLatency(micros() - start);
+    return ok;
+}
+
+bool SDHumidityRecorder::write(const HumidityData &data)
+{
     // ファイルを開く
-    fs::File file = sd.open("/humidity_log.txt", "w");
+    fs::File file = card.fs().open("/humidity_log.txt", "w");
     if (!file)
+    {
         return false;
+    }
 
     // recordHead, recordSizeを書き込み
     file.println(data.head);
@@ -26,7 +48,7 @@ bool SDHumidityRecorder::save(const HumidityData &data)
     // データを書き込み
     for (size_t i = 0; i < HumidityData::RECORD_SIZE; i++)
     {
-        file.println(data.record[i]);
+        file.println(HumidityEncoding::decode(data.items[i]));
     }
 
     file.println();
@@ -35,18 +57,17 @@ bool SDHumidityRecorder::save(const HumidityData &data)
     return true;
 }
 
-bool SDHumidityRecorder::load(HumidityData &data)
+bool SDHumidityRecorder::read(HumidityData &data)
 {
-    if (!isSDAvailable())
-        return false;
-
     // ファイルを開く
-    fs::File file = sd.open("/humidity_log.txt", "r");
+    fs::File file = card.fs().open("/humidity_log.txt", "r");
     if (!file)
+    {
         return false;
+    }
 
     // recordHead, recordSizeを読み込み
-    data.head = file.parseInt();
+    data.head = file.parseInt() & HumidityData::MASK;
     size_t savedRecordSize = file.parseInt();
     if (savedRecordSize < HumidityData::RECORD_SIZE)
     {
@@ -58,9 +79,15 @@ bool SDHumidityRecorder::load(HumidityData &data)
     // データを読み込み
     for (size_t i = 0; i < HumidityData::RECORD_SIZE; i++)
     {
-        data.record[i] = file.parseFloat();
+        data.items[i] = HumidityEncoding::encode(file.parseFloat());
     }
 
+    // テキスト形式は累計数・時刻・イベントを保持しないため、全スロットを時刻不明の記録済みデータとして扱う
+    data.count = HumidityData::RECORD_SIZE;
+    std::fill(data.intervals, data.intervals + HumidityData::RECORD_SIZE, HumidityData::INTERVAL_UNKNOWN);
+    memset(data.events, 0, sizeof(data.events));
+    data.newestTime = 0;
+
     file.close();
     return true;
 }
\ No newline at end of file
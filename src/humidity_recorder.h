@@ -1,6 +1,7 @@
 #pragma once
 
 #include "humidity_data.h"
+#include "sd_card_manager.h"
 #include <Arduino.h>
 #include <FS.h>
 #include <SD.h>
@@ -32,6 +33,45 @@ public:
      * @return false 読み込み失敗
      */
     virtual bool load(HumidityData &data) = 0;
+
+    /**
+     * @brief 最新のデータだけを先に読み込む
+     *
+     * 起動直後の表示と制御に必要な分だけを読み込み、残りは loadOlder() で少しずつ読み込みます。
+     * 既定の実装は load() で全件を読み込みます。
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @param recent 最低限読み込む最新データ数
+     * @return true 読み込み成功
+     * @return false 読み込み失敗
+     */
+    virtual bool loadRecent(HumidityData &data, size_t recent)
+    {
+        return load(data);
+    }
+
+    /**
+     * @brief loadRecent() で読み込まなかった古いデータを読み込む
+     *
+     * 読み込み中に追加されたデータは上書きしません。
+     *
+     * @param[out] data 読み込み先の湿度データ構造体（loadRecent() と同じもの）
+     * @param maxSamples 今回読み込む最大データ数の目安
+     * @return true すべて読み込み終えた（または中断した）
+     * @return false まだ読み込むデータが残っている
+     */
+    virtual bool loadOlder(HumidityData &data, size_t maxSamples)
+    {
+        return true;
+    }
+
+    /**
+     * @brief loadRecent() 時点の最新データから数えて、読み込み済みのデータ数を取得する
+     */
+    virtual size_t getLoadedCount() const
+    {
+        return HumidityData::RECORD_SIZE;
+    }
 };
 
 /**
@@ -45,9 +85,9 @@ public:
     /**
      * @brief コンストラクタ
      *
-     * @param sd SDファイルシステムオブジェクトへの参照
+     * @param card SDカードマネージャーへの参照
      */
-    explicit SDHumidityRecorder(fs::SDFS &sd) : sd(sd)
+    explicit SDHumidityRecorder(SDCardManager &card) : card(card)
     {
     }
 
@@ -70,13 +110,15 @@ public:
     bool load(HumidityData &data) override;
 
 private:
-    fs::SDFS &sd; ///< SDファイルシステムへの参照
+    SDCardManager &card; ///< SDカードマネージャーへの参照
 
     /**
-     * @brief SDカードが利用可能かチェックする
-     *
-     * @return true 利用可能
-     * @return false 利用不可
+     * @brief ファイルへデータを書き込む
+     */
+    bool write(const HumidityData &data);
+
+    /**
+     * @brief ファイルからデータを読み込む
      */
-    bool isSDAvailable();
+    bool read(HumidityData &data);
 };
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "job_scheduler.h"
+#include <algorithm>
+
+namespace
+{
+/**
+ * @brief 期限が来ているかどうか（オーバーフロー対応の差分計算）
+ */
+bool isDue(uint32_t deadline, uint32_t now)
+{
+    return static_cast<int32_t>(now - deadline) >= 0;
+}
+} // namespace
+
+int JobScheduler::add(const char *name, JobFunction function, void *context, uint32_t period, uint8_t priority)
+{
+    if (jobCount >= MAX_JOBS || !function)
+    {
+        return INVALID_JOB;
+    }
+
+    uint32_t now = millis();
+    Job &job = jobs[jobCount];
+    job = {};
+    job.name = name;
+    job.function = function;
+    job.context = context;
+    job.period = std::max<uint32_t>(period, 1);
+    job.deadline = now;
+    job.lastStart = now;
+    job.priority = priority;
+    job.enabled = true;
+    return jobCount++;
+}
+
+uint32_t JobScheduler::run()
+{
+    // 各ジョブは1回の呼び出しで最大1回だけ実行し、処理が周期に追いつかない場合でも loop() に戻れるようにする
+    uint32_t done = 0;
+    for (size_t i = 0; i < jobCount; i++)
+    {
+        uint32_t start = millis();
+        int index = findDue(start, done);
+        if (index == INVALID_JOB)
+        {
+            break;
+        }
+
+        Job &job = jobs[index];
+        done |= 1u << index;
+        job.stats.maxLateness = std::max(job.stats.maxLateness, start - job.deadline);
+        job.lastStart = start;
+        job.deadline += job.period;
+
+        // ジョブの中で setPeriod() が呼ばれた場合は、その中で次の期限が決まる
+        job.function(job.context);
+
+        uint32_t end = millis();
+        job.stats.runCount++;
+        job.stats.maxDuration = std::max(job.stats.maxDuration, end - start);
+
+        // 1周期以上遅れた場合は取りこぼした期限を数え、連続実行せずに1周期後から再開する
+        if (isDue(job.deadline, end))
+        {
+            job.stats.overrunCount += (end - job.deadline) / job.period + 1;
+            job.deadline = end + job.period;
+        }
+    }
+
+    // 次の期限までの時間
+    uint32_t now = millis();
+    uint32_t wait = MAX_IDLE;
+    for (size_t i = 0; i < jobCount; i++)
+    {
+        const Job &job = jobs[i];
+        if (!job.enabled)
+        {
+            continue;
+        }
+        if (isDue(job.deadline, now))
+        {
+            return 0;
+        }
+        wait = std::min(wait, job.deadline - now);
+    }
+    return wait;
+}
+
+void JobScheduler::setPeriod(int job, uint32_t period)
+{
+    if (!isValid(job))
+    {
+        return;
+    }
+
+    jobs[job].period = std::max<uint32_t>(period, 1);
+    jobs[job].deadline = jobs[job].lastStart + jobs[job].period;
+}
+
+void JobScheduler::setEnabled(int job, bool enabled)
+{
+    if (!isValid(job) || jobs[job].enabled == enabled)
+    {
+        return;
+    }
+
+    jobs[job].enabled = enabled;
+    if (enabled)
+    {
+        jobs[job].deadline = millis();
+    }
+}
+
+void JobScheduler::trigger(int job)
+{
+    if (!isValid(job))
+    {
+        return;
+    }
+
+    jobs[job].deadline = millis();
+}
+
+int JobScheduler::findDue(uint32_t now, uint32_t done) const
+{
+    int found = INVALID_JOB;
+    for (size_t i = 0; i < jobCount; i++)
+    {
+        const Job &job = jobs[i];
+        if (!job.enabled || (done & (1u << i)) || !isDue(job.deadline, now))
+        {
+            continue;
+        }
+
+        // 優先度の高い順、同じ優先度では期限の早い順
+        if (found == INVALID_JOB || job.priority > jobs[found].priority ||
+            (job.priority == jobs[found].priority && static_cast<int32_t>(job.deadline - jobs[found].deadline) < 0))
+        {
+            found = i;
+        }
+    }
+    return found;
+}
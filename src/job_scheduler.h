@@ -0,0 +1,171 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief 周期的なジョブを期限の順に実行する協調型スケジューラー
+ *
+ * 各ジョブは周期・優先度と次の実行期限を持ち、run() は期限が来たジョブを優先度の高い順
+ * （同じ優先度では期限の早い順）に1回ずつ実行して、次の期限までの時間を返します。
+ * loop() はその時間だけ delay() するため、ジョブのない間はCPUを他のタスクに譲れます。
+ *
+ * ジョブの実行が遅れて1周期以上の期限を取りこぼした場合は、その回数を取りこぼし（overrun）として数え、
+ * 遅れを取り戻そうと連続実行せずに、実行後から1周期後を次の期限とします。
+ */
+class JobScheduler final
+{
+public:
+    constexpr static size_t MAX_JOBS = 8;      ///< 登録できる最大ジョブ数
+    constexpr static uint32_t MAX_IDLE = 1000; ///< 実行待ちのジョブがない場合に返す待ち時間（ミリ秒）
+    constexpr static int INVALID_JOB = -1;     ///< 登録に失敗したことを表すジョブ番号
+
+    using JobFunction = void (*)(void *context); ///< ジョブとして呼び出す関数
+
+    /**
+     * @brief ジョブの実行統計
+     */
+    struct JobStats
+    {
+        uint32_t runCount;     ///< 実行した回数
+        uint32_t overrunCount; ///< 取りこぼした期限の数
+        uint32_t maxLateness;  ///< 期限から実行開始までの最大の遅れ（ミリ秒）
+        uint32_t maxDuration;  ///< 最長の実行時間（ミリ秒）
+    };
+
+    /**
+     * @brief ジョブを登録する
+     *
+     * 最初の期限は登録した時点のため、次の run() ですぐに実行されます。
+     *
+     * @param name ジョブ名（統計の表示用）
+     * @param function 呼び出す関数
+     * @param context 関数に渡す引数
+     * @param period 実行周期（ミリ秒、1以上）
+     * @param priority 優先度（大きいほど先に実行）
+     * @return int ジョブ番号。登録できない場合は INVALID_JOB
+     */
+    int add(const char *name, JobFunction function, void *context, uint32_t period, uint8_t priority);
+
+    /**
+     * @brief メンバー関数をジョブとして登録する
+     *
+     * 例: scheduler.add<&GreenThumbApp::render>("render", this, 2000, 1);
+     *
+     * @tparam Method 呼び出すメンバー関数
+     * @param name ジョブ名（統計の表示用）
+     * @param object メンバー関数を呼び出すオブジェクト
+     * @param period 実行周期（ミリ秒、1以上）
+     * @param priority 優先度（大きいほど先に実行）
+     * @return int ジョブ番号。登録できない場合は INVALID_JOB
+     */
+    template <auto Method, typename T> int add(const char *name, T *object, uint32_t period, uint8_t priority)
+    {
+        return add(name, [](void *context) { (static_cast<T *>(context)->*Method)(); }, object, period, priority);
+    }
+
+    /**
+     * @brief 期限が来たジョブを実行する
+     *
+     * 1回の呼び出しで各ジョブを最大1回ずつ実行します。
+     *
+     * @return uint32_t 次の期限までの時間（ミリ秒、最大 MAX_IDLE）
+     */
+    uint32_t run();
+
+    /**
+     * @brief ジョブの実行周期を変更する
+     *
+     * 次の期限は前回の実行開始（未実行の場合は登録時点）から新しい周期後になります。
+     *
+     * @param job ジョブ番号
+     * @param period 実行周期（ミリ秒、1以上）
+     */
+    void setPeriod(int job, uint32_t period);
+
+    /**
+     * @brief ジョブの実行周期を取得する
+     */
+    uint32_t getPeriod(int job) const
+    {
+        return isValid(job) ? jobs[job].period : 0;
+    }
+
+    /**
+     * @brief ジョブの有効・無効を切り替える
+     *
+     * 有効にしたジョブはすぐに実行されます。
+     *
+     * @param job ジョブ番号
+     * @param enabled 有効にする場合は true
+     */
+    void setEnabled(int job, bool enabled);
+
+    /**
+     * @brief ジョブを次の run() ですぐに実行させる
+     *
+     * @param job ジョブ番号
+     */
+    void trigger(int job);
+
+    /**
+     * @brief 登録されているジョブの数を取得する
+     */
+    size_t getJobCount() const
+    {
+        return jobCount;
+    }
+
+    /**
+     * @brief ジョブ名を取得する
+     */
+    const char *getName(int job) const
+    {
+        return isValid(job) ? jobs[job].name : "";
+    }
+
+    /**
+     * @brief ジョブの実行統計を取得する
+     */
+    const JobStats &getStats(int job) const
+    {
+        static const JobStats empty = {};
+        return isValid(job) ? jobs[job].stats : empty;
+    }
+
+private:
+    /**
+     * @brief 登録されたジョブ
+     */
+    struct Job
+    {
+        const char *name;     ///< ジョブ名
+        JobFunction function; ///< 呼び出す関数
+        void *context;        ///< 関数に渡す引数
+        uint32_t period;      ///< 実行周期（ミリ秒）
+        uint32_t deadline;    ///< 次の実行期限（millis() の値）
+        uint32_t lastStart;   ///< 前回の実行開始（未実行の場合は登録時点）
+        uint8_t priority;     ///< 優先度
+        bool enabled;         ///< 有効かどうか
+        JobStats stats;       ///< 実行統計
+    };
+
+    Job jobs[MAX_JOBS] = {}; ///< 登録されたジョブ
+    size_t jobCount = 0;     ///< 登録されたジョブの数
+
+    /**
+     * @brief ジョブ番号が有効かどうか
+     */
+    bool isValid(int job) const
+    {
+        return job >= 0 && static_cast<size_t>(job) < jobCount;
+    }
+
+    /**
+     * @brief 期限が来たジョブのうち、次に実行するものを探す
+     *
+     * @param now 現在の時間（ミリ秒）
+     * @param done 今回の run() で実行済みのジョブのビットマスク
+     * @return int ジョブ番号。期限が来たジョブがない場合は INVALID_JOB
+     */
+    int findDue(uint32_t now, uint32_t done) const;
+};
@@ -6,51 +6,599 @@
  */
 
 #include <Arduino.h>
+#include <LittleFS.h>
 #include <SD.h>
 #include <SPI.h>
 #include <U8g2lib.h>
+#include <algorithm>
+#include <esp_heap_caps.h>
 
+#include "adc_humidity_reader.h"
+#include "async_humidity_recorder.h"
+#include "async_multi_humidity_recorder.h"
+#include "binary_humidity_recorder.h"
+#include "calibration_store.h"
+#include "cpu_frequency_governor.h"
+#include "deep_sleep_controller.h"
 #include "greenthumb_app.h"
+#include "humidity_archive.h"
 #include "humidity_reader.h"
 #include "humidity_recorder.h"
+#include "multi_plant_app.h"
+#include "power_manager.h"
+#include "profiler.h"
 #include "pump_controller.h"
-
-constexpr uint8_t SENSOR_PIN = D0;       ///< 湿度センサーのアナログピン
-constexpr uint8_t SD_CS_PIN = D2;        ///< SDカードモジュールのCSピン
-constexpr uint8_t PUMP_CONTROL_PIN = D3; ///< ポンプ制御用GPIOピン
+#include "sd_card_manager.h"
+#include "tiered_humidity_recorder.h"
+#include "timed_pump_controller.h"
+#include "wall_clock.h"
 
 typedef U8G2_SSD1306_128X64_NONAME_F_HW_I2C U8G2_OLED;
 
+constexpr uint8_t SD_CS_PIN = D2; ///< SDカードモジュールのCSピン
+
 U8G2_OLED oled(U8G2_R0, /* reset=*/U8X8_PIN_NONE);
-GPIOHumidityReader humidityReader(SENSOR_PIN);
-SDHumidityRecorder humidityRecorder(SD);
+SDCardManager sdCard(SD, SD_CS_PIN);
+CalibrationStore calibrationStore(LittleFS);
+CpuFrequencyGovernor cpuGovernor;
+
+#if PLANT_CHANNELS > 1
+// 複数の植木鉢を管理する場合は、チャンネル順のピン番号をビルドフラグで指定する
+// 例: -DPLANT_CHANNELS=4 -DPLANT_SENSOR_PINS="{A0, A1, A2, A3}" -DPLANT_PUMP_PINS="{D3, D4, D5, D6}"
+#if !defined(PLANT_SENSOR_PINS) || !defined(PLANT_PUMP_PINS)
+#error "PLANT_SENSOR_PINS and PLANT_PUMP_PINS must be defined when PLANT_CHANNELS > 1"
+#endif
+#ifndef PLANT_MAX_RUNNING_PUMPS
+#define PLANT_MAX_RUNNING_PUMPS 1 ///< 同時に稼働できるポンプの最大数（電源の電流容量に合わせる）
+#endif
+
+constexpr uint8_t SENSOR_PINS[] = PLANT_SENSOR_PINS; ///< 湿度センサーのアナログピン（チャンネル順）
+constexpr uint8_t PUMP_PINS[] = PLANT_PUMP_PINS;     ///< ポンプ制御用GPIOピン（チャンネル順）
+static_assert(sizeof(SENSOR_PINS) == PLANT_CHANNELS && sizeof(PUMP_PINS) == PLANT_CHANNELS,
+              "PLANT_SENSOR_PINS and PLANT_PUMP_PINS must have PLANT_CHANNELS entries");
+static_assert(PLANT_CHANNELS <= ContinuousADCHumidityReader::MAX_CHANNELS,
+              "PLANT_CHANNELS exceeds the channels ADC1 can convert continuously");
+
+ContinuousADCHumidityReader humidityReader(SENSOR_PINS, PLANT_CHANNELS);
+BinarySDMultiHumidityRecorder sdRecorder(sdCard);
+AsyncMultiHumidityRecorder humidityRecorder(sdRecorder, cpuGovernor);
+IPumpController *pumpControllers[PLANT_CHANNELS] = {}; ///< チャンネルごとのポンプコントローラー（setup() で作成）
+#if PUMP_TIMER_CUTOFF
+TimedPumpController *timedPumps[PLANT_CHANNELS] = {}; ///< タイマーで停止するポンプコントローラー（停止の統計の表示用）
+#endif
+
+Button button(MultiPlantApp::USR_BTN_PIN);
+MultiPlantApp app(humidityReader, humidityRecorder, pumpControllers, PLANT_MAX_RUNNING_PUMPS, oled, cpuGovernor, button);
+PowerManager powerManager(button, humidityReader);
+#else
+constexpr uint8_t SENSOR_PINS[] = {D0};  ///< 湿度センサーのアナログピン
+constexpr uint8_t PUMP_CONTROL_PIN = D3; ///< ポンプ制御用GPIOピン
+
+ContinuousADCHumidityReader humidityReader(SENSOR_PINS, 1);
+BinarySDHumidityRecorder sdRecorder(sdCard);
+HumidityArchive humidityArchive(sdCard);
+ArchivingHumidityRecorder archivingRecorder(sdRecorder, humidityArchive, GreenThumbApp::RECORD_INTERVAL / 1000);
+TieredHumidityRecorder tieredRecorder(archivingRecorder, LittleFS);
+AsyncHumidityRecorder humidityRecorder(tieredRecorder, cpuGovernor);
+#if PUMP_TIMER_CUTOFF
+// 保存や画面の転送でメインループが遅れても、最大稼働時間・停止閾値でタイマーが停止する
+TimedPumpController pumpController(PUMP_CONTROL_PIN, GreenThumbApp::PUMP_MAX_DURATION, &humidityReader,
+                                   GreenThumbApp::PUMP_OFF_THRESHOLD);
+#else
 GPIOPumpController pumpController(PUMP_CONTROL_PIN);
+#endif
+
+Button button(GreenThumbApp::USR_BTN_PIN);
+GreenThumbApp app(humidityReader, humidityRecorder, pumpController, oled, cpuGovernor, button);
+PowerManager powerManager(button, humidityReader);
+#endif
+
+#if DEEP_SLEEP_ENABLED
+#if PLANT_CHANNELS > 1
+#error "DEEP_SLEEP_ENABLED supports a single plant only"
+#endif
+DeepSleepController deepSleep(SENSOR_PINS[0], PUMP_CONTROL_PIN, GreenThumbApp::USR_BTN_PIN, GreenThumbApp::RECORD_INTERVAL);
+uint32_t restoredWateringTime = 0; ///< 起動時に復元した、最後に水やりした時間（ミリ秒）
+#endif
+
+/**
+ * @brief 保存されているセンサーの校正値を読み込む
+ */
+void loadCalibration()
+{
+    HumidityCalibration calibrations[ContinuousADCHumidityReader::MAX_CHANNELS];
+    size_t channels = humidityReader.getChannelCount();
+    if (!calibrationStore.load(calibrations, channels))
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < channels; i++)
+    {
+        humidityReader.setCalibration(i, calibrations[i]);
+    }
+}
+
+/**
+ * @brief 校正コマンドを処理する
+ *
+ * "cal <チャンネル番号(1始まり)> <湿度%>" を受け取ると、そのチャンネルの現在の電圧を校正点として保存します。
+ * 例: 空気中で "cal 1 0"、水に浸して "cal 1 100"
+ *
+ * @param line 受け取ったコマンド
+ */
+void handleCalibrationCommand(const char *line)
+{
+    unsigned channel = 0;
+    unsigned humidity = 0;
+    if (sscanf(line, "cal %u %u", &channel, &humidity) != 2 || channel < 1 || channel > humidityReader.getChannelCount() ||
+        humidity > 100)
+    {
+        Serial.println("usage: cal <channel> <humidity%>");
+        return;
+    }
+
+    uint16_t millivolts = humidityReader.getMillivolts(channel - 1);
+    if (!humidityReader.calibrate(channel - 1, humidity))
+    {
+        Serial.println("calibration failed");
+        return;
+    }
 
-GreenThumbApp app(humidityReader, humidityRecorder, pumpController, oled);
+    HumidityCalibration calibrations[ContinuousADCHumidityReader::MAX_CHANNELS];
+    for (size_t i = 0; i < humidityReader.getChannelCount(); i++)
+    {
+        calibrations[i] = humidityReader.getCalibration(i);
+    }
+    calibrationStore.save(calibrations, humidityReader.getChannelCount());
+    Serial.printf("channel %u: %u mV = %u%%\n", channel, millivolts, humidity);
+}
+
+/**
+ * @brief 時計のコマンドを処理する
+ *
+ * "time <UNIX時刻(秒)>" で時計を設定し、"time" だけの場合は現在の時刻を表示します。
+ * 例: PC の `date +%s` の値を送る
+ *
+ * @param line 受け取ったコマンド
+ */
+void handleTimeCommand(const char *line)
+{
+    unsigned long timestamp = 0;
+    if (sscanf(line, "time %lu", &timestamp) == 1 && !WallClock::set(timestamp))
+    {
+        Serial.println("usage: time <unix seconds>");
+        return;
+    }
+
+    uint32_t now = WallClock::now();
+    Serial.printf("time %lu (%s)\n", static_cast<unsigned long>(now), WallClock::isValid(now) ? "set" : "not set");
+}
+
+#if PUMP_TIMER_CUTOFF
+/**
+ * @brief タイマーがポンプを停止した回数と、停止の遅れを表示する
+ *
+ * @param channel チャンネル番号（1始まり）
+ * @param pump タイマーで停止するポンプコントローラー
+ */
+void printPumpStats(size_t channel, const TimedPumpController &pump)
+{
+    uint32_t deadlineCount = pump.getCutoffCount(TimedPumpController::CUTOFF_DEADLINE);
+    Serial.printf("pump %u cutoff deadline %lu (latency avg %lu us max %lu us), threshold %lu (check late max %lu us)\n",
+                  static_cast<unsigned>(channel), static_cast<unsigned long>(deadlineCount),
+                  static_cast<unsigned long>(pump.getDeadlineLatency() / std::max<uint32_t>(deadlineCount, 1)),
+                  static_cast<unsigned long>(pump.getMaxDeadlineLatency()),
+                  static_cast<unsigned long>(pump.getCutoffCount(TimedPumpController::CUTOFF_THRESHOLD)),
+                  static_cast<unsigned long>(pump.getMaxCheckLatency()));
+}
+#endif
+
+/**
+ * @brief 電源管理・CPU周波数ごとの時間・画面転送・起動時間・保存タスク・SDカード・ポンプの停止・ジョブの実行統計を表示する
+ */
+void printStats()
+{
+    Serial.printf("duty %.2f%% (active %llu ms, sleep %llu ms x%lu, delay %llu ms, button wakeups %lu)\n",
+                  powerManager.getDutyCycle() * 100.0f,
+                  static_cast<unsigned long long>(powerManager.getActiveTime() / 1000),
+                  static_cast<unsigned long long>(powerManager.getSleepTime() / 1000),
+                  static_cast<unsigned long>(powerManager.getSleepCount()),
+                  static_cast<unsigned long long>(powerManager.getDelayTime() / 1000),
+                  static_cast<unsigned long>(powerManager.getButtonWakeupCount()));
+
+    uint64_t idleTime = cpuGovernor.getTime(CpuFrequencyGovernor::LEVEL_IDLE);
+    uint64_t boostTime = cpuGovernor.getTime(CpuFrequencyGovernor::LEVEL_BOOST);
+    uint64_t totalTime = idleTime + boostTime;
+    Serial.printf("cpu %lu MHz %.2f%% (%llu ms), %lu MHz %.2f%% (%llu ms), switches %lu\n",
+                  static_cast<unsigned long>(CpuFrequencyGovernor::IDLE_MHZ), totalTime ? idleTime * 100.0f / totalTime : 0.0f,
+                  static_cast<unsigned long long>(idleTime / 1000), static_cast<unsigned long>(CpuFrequencyGovernor::BOOST_MHZ),
+                  totalTime ? boostTime * 100.0f / totalTime : 0.0f, static_cast<unsigned long long>(boostTime / 1000),
+                  static_cast<unsigned long>(cpuGovernor.getSwitchCount()));
+
+    const AsyncDisplay &display = app.getDisplay();
+    uint32_t frameCount = std::max<uint32_t>(display.getFrameCount(), 1);
+    uint32_t transferCount = std::max<uint32_t>(display.getTransferCount(), 1);
+    Serial.printf("render avg %lu us max %lu us, transfer avg %lu us max %lu us, dropped %lu\n",
+                  static_cast<unsigned long>(display.getRenderTime() / frameCount),
+                  static_cast<unsigned long>(display.getMaxRenderTime()),
+                  static_cast<unsigned long>(display.getTransferTime() / transferCount),
+                  static_cast<unsigned long>(display.getMaxTransferTime()),
+                  static_cast<unsigned long>(display.getDroppedCount()));
+
+    const HumidityGraphView &graph = app.getGraphView();
+    Serial.printf("graph full %lu incremental %lu\n", static_cast<unsigned long>(graph.getFullRenderCount()),
+                  static_cast<unsigned long>(graph.getIncrementalRenderCount()));
+
+    const FrameDiffer &frames = display.getFrameDiffer();
+    Serial.printf("display full %lu partial %lu skipped %lu, sent %lu bytes, saved %lu bytes\n",
+                  static_cast<unsigned long>(frames.getFullFrameCount()),
+                  static_cast<unsigned long>(frames.getPartialFrameCount()),
+                  static_cast<unsigned long>(frames.getSkippedFrameCount()), static_cast<unsigned long>(frames.getBytesSent()),
+                  static_cast<unsigned long>(frames.getBytesSaved()));
+
+#if PLANT_CHANNELS == 1
+    // 起動から最初の画面表示・履歴の読み込み完了までの時間（まだの場合は0）
+    Serial.printf("boot first frame %lu ms, history loaded %lu ms\n", static_cast<unsigned long>(app.getTimeToFirstFrame()),
+                  static_cast<unsigned long>(app.getTimeToFullHistory()));
+#endif
+
+    // 保存タスクの保存回数（まとめた要求・失敗を含む）と、キューが満杯で破棄・作り直した回数
+    Serial.printf("recorder saves %lu (coalesced %lu, failed %lu), dropped %lu, resyncs %lu\n",
+                  static_cast<unsigned long>(humidityRecorder.getSaveCount()),
+                  static_cast<unsigned long>(humidityRecorder.getCoalescedCount()),
+                  static_cast<unsigned long>(humidityRecorder.getFailedCount()),
+                  static_cast<unsigned long>(humidityRecorder.getDroppedCount()),
+                  static_cast<unsigned long>(humidityRecorder.getResyncCount()));
+
+    // SDカードのマウント状態、マウントの成功回数/試行回数、ファイル操作の失敗回数と所要時間（所要時間にはマウントも含む）
+    Serial.printf("sd %s, mounts %lu/%lu, io failures %lu, latency last %lu us avg %lu us max %lu us (n %lu)\n",
+                  SDCardManager::getStateName(sdCard.getState()), static_cast<unsigned long>(sdCard.getMountGeneration()),
+                  static_cast<unsigned long>(sdCard.getMountAttempts()), static_cast<unsigned long>(sdCard.getIoFailures()),
+                  static_cast<unsigned long>(sdCard.getLastLatency()), static_cast<unsigned long>(sdCard.getAverageLatency()),
+                  static_cast<unsigned long>(sdCard.getMaxLatency()), static_cast<unsigned long>(sdCard.getOperationCount()));
+
+#if PUMP_TIMER_CUTOFF
+#if PLANT_CHANNELS > 1
+    for (size_t i = 0; i < PLANT_CHANNELS; i++)
+    {
+        if (timedPumps[i])
+        {
+            printPumpStats(i + 1, *timedPumps[i]);
+        }
+    }
+#else
+    printPumpStats(1, pumpController);
+#endif
+#endif
+
+    const JobScheduler &jobs = app.getJobScheduler();
+    for (size_t i = 0; i < jobs.getJobCount(); i++)
+    {
+        const JobScheduler::JobStats &stats = jobs.getStats(i);
+        Serial.printf("  %-8s runs %lu overruns %lu max late %lu ms max run %lu ms\n", jobs.getName(i),
+                      static_cast<unsigned long>(stats.runCount), static_cast<unsigned long>(stats.overrunCount),
+                      static_cast<unsigned long>(stats.maxLateness), static_cast<unsigned long>(stats.maxDuration));
+    }
+}
+
+#if PROFILER_ENABLED
+/**
+ * @brief フェーズごとの処理時間のヒストグラム・停滞・タスクのスタックとヒープの最小空き容量を表示する
+ */
+void printProfile()
+{
+    for (size_t i = 0; i < Profiler::PHASE_COUNT; i++)
+    {
+        Profiler::Phase phase = static_cast<Profiler::Phase>(i);
+        const Profiler::PhaseStats &stats = Profiler::getStats(phase);
+        Serial.printf("%-8s n %lu avg %lu us max %lu us stalls %lu |", Profiler::getName(phase),
+                      static_cast<unsigned long>(stats.count),
+                      static_cast<unsigned long>(stats.totalTime / std::max<uint32_t>(stats.count, 1)),
+                      static_cast<unsigned long>(stats.maxTime), static_cast<unsigned long>(stats.stallCount));
+
+        // 空でないバケットだけを「下限:回数」で表示する
+        for (size_t bucket = 0; bucket < Profiler::BUCKET_COUNT; bucket++)
+        {
+            if (stats.buckets[bucket])
+            {
+                Serial.printf(" %lu:%lu", static_cast<unsigned long>(Profiler::getBucketFloor(bucket)),
+                              static_cast<unsigned long>(stats.buckets[bucket]));
+            }
+        }
+        Serial.println();
+    }
+
+    int stallPhase = Profiler::getLastStallPhase();
+    Serial.printf("last stall %s, watchdog %lu (phases 0x%02lx)\n",
+                  stallPhase < 0 ? "-" : Profiler::getName(static_cast<Profiler::Phase>(stallPhase)),
+                  static_cast<unsigned long>(Profiler::getWatchdogCount()),
+                  static_cast<unsigned long>(Profiler::getWatchdogPhases()));
+
+    // タスクごとのスタックの最小空き容量（ESP-IDF ではバイト単位）
+    static const char *const TASK_NAMES[] = {"loopTask", "display", "recorder", "adc", "esp_timer"};
+    Serial.print("stack free min");
+    for (const char *name : TASK_NAMES)
+    {
+        TaskHandle_t task = xTaskGetHandle(name);
+        if (task)
+        {
+            Serial.printf(" %s %u", name, static_cast<unsigned>(uxTaskGetStackHighWaterMark(task)));
+        }
+    }
+    Serial.println();
+
+    Serial.printf("heap free %u min %u largest %u\n", static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_8BIT)),
+                  static_cast<unsigned>(heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT)),
+                  static_cast<unsigned>(heap_caps_get_largest_free_block(MALLOC_CAP_8BIT)));
+}
+
+/**
+ * @brief 計測のコマンドを処理する
+ *
+ * "prof" で表示、"prof reset" で消去、"prof on" / "prof off" で計測の開始・停止を行います。
+ *
+ * @param line 受け取ったコマンド
+ */
+void handleProfileCommand(const char *line)
+{
+    const char *argument = line + 4;
+    while (*argument == ' ')
+    {
+        argument++;
+    }
+
+    if (strncmp(argument, "reset", 5) == 0)
+    {
+        Profiler::reset();
+    }
+    else if (strncmp(argument, "on", 2) == 0)
+    {
+        Profiler::setEnabled(true);
+    }
+    else if (strncmp(argument, "off", 3) == 0)
+    {
+        Profiler::setEnabled(false);
+    }
+    else
+    {
+        printProfile();
+    }
+}
+#endif
+
+/**
+ * @brief シリアルからコマンドを受け付ける
+ *
+ * "cal ..." で校正、"time ..." で時計の設定、"stats" で電源管理・CPU周波数・画面転送・ジョブの実行統計を表示します。
+ * PROFILER_ENABLED の場合は "prof ..." で処理のフェーズごとの計測結果を扱います。
+ */
+void handleSerialCommand()
+{
+    if (!Serial.available())
+    {
+        return;
+    }
+
+    char line[32] = {};
+    Serial.readBytesUntil('\n', line, sizeof(line) - 1);
+
+    if (strncmp(line, "stats", 5) == 0)
+    {
+        printStats();
+    }
+    else if (strncmp(line, "time", 4) == 0)
+    {
+        handleTimeCommand(line);
+    }
+#if PROFILER_ENABLED
+    else if (strncmp(line, "prof", 4) == 0)
+    {
+        handleProfileCommand(line);
+    }
+#endif
+    else
+    {
+        handleCalibrationCommand(line);
+    }
+}
+
+/**
+ * @brief ライトスリープしてよいかどうか
+ *
+ * ポンプの稼働中は制御の周期を保つため、画面の転送中と保存タスクの処理中は転送・保存を止めないためにスリープしません。
+ */
+bool canSleep()
+{
+    return !app.isWatering() && !app.isDisplayBusy() && !humidityRecorder.isBusy();
+}
+
+#if DEEP_SLEEP_ENABLED
+/**
+ * @brief タイマーでディープスリープから復帰したときの処理を行う（戻らない）
+ *
+ * 記録がRTCメモリに収まる間は、センサーの読み取りとポンプの判定だけを行ってすぐにスリープします。
+ * 満杯になった場合は、画面を使わずに履歴を読み込んで記録を追加し、保存してからスリープします。
+ */
+[[noreturn]] void runScheduledWakeup()
+{
+    if (deepSleep.runCycle())
+    {
+        sdCard.begin();
+        LittleFS.begin(true);
+
+        // 湿度データは大きいため、別に確保せずアプリケーションの領域を使う（保存タスクの起動前のため同期的に保存される）
+        app.appendHistoryWithoutDisplay([](HumidityData &data) { return deepSleep.drain(data); });
+    }
+    deepSleep.sleep();
+}
+
+/**
+ * @brief ディープスリープ中に溜まった記録と、保持していた状態をアプリケーションに戻す
+ *
+ * 保存タスクの起動前に呼び出し、溜まった記録をその場で保存します。
+ */
+void restoreRetainedState()
+{
+    app.appendHistory([](HumidityData &data) { return deepSleep.drain(data); });
+
+    // 壁時計の水やり時刻を、millis() の経過時間に直す（クールタイムより前は区別しない）
+    uint32_t wateringTime = deepSleep.getLastWateringTime();
+    if (wateringTime != 0)
+    {
+        uint32_t elapsed = std::min(deepSleep.now() - wateringTime, GreenThumbApp::PUMP_MIN_INTERVAL / 1000);
+        app.setLastWateringTime(millis() - elapsed * 1000);
+    }
+    restoredWateringTime = app.getLastWateringTime();
+
+    app.setGraphScaleIndex(deepSleep.getGraphScaleIndex());
+}
+
+/**
+ * @brief ボタン操作がない時間が続いたら、状態をRTCメモリに保持してディープスリープする
+ */
+void sleepIfInactive()
+{
+    if (millis() - app.getLastInteractionTime() < DeepSleepController::AWAKE_TIMEOUT || !canSleep())
+    {
+        return;
+    }
+
+    // 起きている間に水やりした場合だけ、壁時計の時刻に直して保持する
+    if (app.getLastWateringTime() != restoredWateringTime)
+    {
+        deepSleep.setLastWateringTime(deepSleep.now() - (millis() - app.getLastWateringTime()) / 1000);
+    }
+    deepSleep.setGraphScaleIndex(app.getGraphScaleIndex());
+    deepSleep.setCalibration(humidityReader.getCalibration(0));
+
+    app.setDisplayPowerSave(true);
+    deepSleep.sleep();
+}
+#endif
 
 /**
  * @brief 初期化処理
  *
- * シリアル通信、SDカード、アプリケーションの初期化を行います。
+ * シリアル通信、SDカード、内蔵フラッシュ、ADC、アプリケーション、保存タスクの初期化を行います。
  */
 void setup()
 {
+    // 普段は低い周波数で動かし、描画・保存・履歴の読み込みの間だけ上げる
+    cpuGovernor.begin();
+
+#if DEEP_SLEEP_ENABLED
+    // タイマーで復帰した場合は、OLEDやADCを初期化せずに記録だけ行ってスリープに戻る
+    deepSleep.begin();
+    if (deepSleep.isScheduledWakeup())
+    {
+        runScheduledWakeup();
+    }
+#endif
+
     Serial.begin(115200);
 
-    // SDカードの初期化
-    pinMode(SD_CS_PIN, OUTPUT);
-    SD.begin(SD_CS_PIN);
+    // 電源投入後は時計が設定されるまで、記録をアーカイブに追記しない
+    if (!WallClock::isSet())
+    {
+        Serial.println("clock not set: send \"time <unix seconds>\"");
+    }
+
+    // SDカードの初期化（マウントは最初の読み込み時に行う）
+    sdCard.begin();
+
+    // 内蔵フラッシュの初期化（ジャーナル用）
+    LittleFS.begin(true);
+
+    // ADCの連続変換の開始（最初の値が揃うまで待つ。失敗した場合は単発の読み取りで代用する）
+    if (!humidityReader.begin())
+    {
+        Serial.println("ADC continuous mode failed: using one-shot reads");
+    }
+
+    // センサーの校正値の読み込み
+    loadCalibration();
+
+    // ボタンの割り込みの設定
+    if (!button.begin())
+    {
+        Serial.println("button: timer init failed");
+    }
+
+#if PLANT_CHANNELS > 1
+    // チャンネルごとのポンプコントローラーの作成
+    for (size_t i = 0; i < PLANT_CHANNELS; i++)
+    {
+#if PUMP_TIMER_CUTOFF
+        timedPumps[i] = new TimedPumpController(PUMP_PINS[i], MultiPlantApp::PUMP_MAX_DURATION,
+                                                new ContinuousADCChannelReader(humidityReader, i),
+                                                MultiPlantApp::PUMP_OFF_THRESHOLD);
+        if (!timedPumps[i]->begin())
+        {
+            Serial.printf("pump %u: timer cutoff unavailable\n", static_cast<unsigned>(i + 1));
+        }
+        pumpControllers[i] = timedPumps[i];
+#else
+        pumpControllers[i] = new GPIOPumpController(PUMP_PINS[i]);
+#endif
+    }
+
+    // アプリケーションの初期化
+    app.begin();
+
+    // 保存タスクの起動
+    humidityRecorder.begin();
+#else
+#if PUMP_TIMER_CUTOFF
+    // ポンプを停止するタイマーの作成
+    if (!pumpController.begin())
+    {
+        Serial.println("pump: timer cutoff unavailable");
+    }
+#endif
 
     // アプリケーションの初期化
     app.begin();
+
+#if DEEP_SLEEP_ENABLED
+    // ディープスリープ中の記録と状態の復元
+    restoreRetainedState();
+#endif
+
+    // 保存タスクの起動
+    humidityRecorder.begin();
+#endif
+
+    // ボタンによるスリープからの復帰の設定（ボタンの初期化後に行う）
+    powerManager.begin();
+    app.setButtonWakeup(powerManager.isLightSleepEnabled());
+
+#if PROFILER_ENABLED
+    // 起動時の履歴の読み込みを終えてから、停滞の確認とタスクウォッチドッグの登録を始める
+    if (!Profiler::begin())
+    {
+        Serial.println("profiler: timer init failed");
+    }
+#endif
 }
 
 /**
  * @brief メインループ
  *
- * アプリケーションの更新処理を継続的に呼び出します。
+ * シリアルコマンドの受け付けと、アプリケーションの期限が来たジョブの実行を繰り返し、
+ * 次の期限までは PowerManager で待ちます。
  */
 void loop()
 {
-    app.update();
-}
\ No newline at end of file
+    handleSerialCommand();
+
+    // 次のジョブの期限まで、ライトスリープまたは delay() で待つ
+    if (powerManager.idle(app.update(), canSleep()))
+    {
+        app.onButtonWakeup();
+    }
+
+#if DEEP_SLEEP_ENABLED
+    sleepIfInactive();
+#endif
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "humidity_data.h"
+#include "ring_buffer.h"
+#include <cstdint>
+
+#ifndef PLANT_CHANNELS
+#define PLANT_CHANNELS 1 ///< 植木鉢（センサーとポンプの組）の数（1 〜 5、センサーは ADC1 の連続変換で読む）
+#endif
+
+/**
+ * @brief 指定した値以下の最大の2のべき乗を求める
+ */
+constexpr size_t floorPowerOfTwo(size_t value)
+{
+    return value < 2 ? 1 : 2 * floorPowerOfTwo(value / 2);
+}
+
+/**
+ * @brief 複数の植木鉢の湿度データを1つのリングバッファで保持する構造体
+ *
+ * 全チャンネルを同じタイミングでまとめて記録するため、時刻（記録間隔）とイベントの列は全チャンネルで共有し、
+ * 湿度の列だけをチャンネルごとに持ちます（チャンネルごとに HumidityData を持つ場合の時刻・イベント列の重複がありません）。
+ * ポンプの稼働はチャンネルごとのビットマスク（pumps）で1列にまとめて記録します。
+ *
+ * 要素数は HumidityData と同じメモリ量に収まる最大の2のべき乗で、チャンネル数を増やすとメモリ量は一定のまま記録期間が短くなります。
+ */
+struct MultiHumidityData : RingIndex<floorPowerOfTwo(HumidityData::RECORD_SIZE *
+                                                     (sizeof(HumidityData::Sample) + sizeof(uint16_t) + sizeof(uint8_t)) /
+                                                     (PLANT_CHANNELS * sizeof(HumidityData::Sample) + sizeof(uint16_t) + 2 * sizeof(uint8_t)))>
+{
+    using Sample = HumidityData::Sample; ///< 格納する型
+
+    constexpr static size_t CHANNELS = PLANT_CHANNELS;                          ///< チャンネル数
+    constexpr static size_t RECORD_SIZE = CAPACITY;                             ///< 記録可能な最大データ数（チャンネルあたり）
+    constexpr static uint16_t INTERVAL_UNKNOWN = HumidityData::INTERVAL_UNKNOWN; ///< 前のデータからの経過秒数が分からないことを表す値
+
+    static_assert(CHANNELS >= 1 && CHANNELS <= 8, "PLANT_CHANNELS must be between 1 and 8");
+
+    Sample humidity[CHANNELS][RECORD_SIZE]; ///< チャンネルごとの湿度データ（エンコード済み）
+    uint16_t intervals[RECORD_SIZE];        ///< 前のデータからの経過秒数（全チャンネル共通）
+    uint8_t events[RECORD_SIZE];            ///< イベントのビットフラグ（全チャンネル共通、HumidityData::Event）
+    uint8_t pumps[RECORD_SIZE];             ///< 前回の記録以降にポンプが稼働したチャンネルのビットマスク
+    uint32_t newestTime;                    ///< 最新データの時刻（秒）
+
+    /**
+     * @brief 1チャンネル分のデータを HumidityData と同じ形で読むためのビュー
+     *
+     * HumidityPyramid など、1チャンネルのデータを走査する処理にそのまま渡せます。
+     * 作成時点の位置をコピーするため、データを追加した後は作り直してください。
+     */
+    struct ChannelView : RingIndex<RECORD_SIZE>
+    {
+        /**
+         * @brief コンストラクタ
+         *
+         * @param data 湿度データ
+         * @param channel チャンネル番号（0始まり）
+         */
+        ChannelView(const MultiHumidityData &data, size_t channel)
+            : RingIndex<RECORD_SIZE>(data), data(data), channel(channel)
+        {
+        }
+
+        /**
+         * @brief 配列上の位置のエンコード済み湿度値を取得する
+         */
+        Sample sampleAt(size_t position) const
+        {
+            return data.humidity[channel][position];
+        }
+
+        /**
+         * @brief 配列上の位置のイベントを取得する（このチャンネルのポンプの稼働を EVENT_PUMP として含む）
+         */
+        uint8_t eventsAt(size_t position) const
+        {
+            return data.events[position] | (data.pumps[position] & (1 << channel) ? HumidityData::EVENT_PUMP : 0);
+        }
+
+        /**
+         * @brief 配列上の位置の、前のデータからの経過秒数を取得する
+         */
+        uint16_t intervalAt(size_t position) const
+        {
+            return data.intervals[position];
+        }
+
+    private:
+        const MultiHumidityData &data; ///< 湿度データ
+        size_t channel;                ///< チャンネル番号
+    };
+
+    /**
+     * @brief コンストラクタ
+     *
+     * データをゼロ初期化します。
+     */
+    MultiHumidityData() : humidity{}, intervals{}, events{}, pumps{}, newestTime(0)
+    {
+    }
+
+    /**
+     * @brief 指定したチャンネルの湿度値を新しい順に取得する
+     *
+     * @param channel チャンネル番号（0始まり）
+     * @param index データのインデックス（0 が最新）
+     * @return float 湿度値（%）
+     */
+    float get(size_t channel, size_t index) const
+    {
+        return HumidityEncoding::decode(humidity[channel][position(index)]);
+    }
+
+    /**
+     * @brief 指定したチャンネルのビューを取得する
+     *
+     * @param channel チャンネル番号（0始まり）
+     */
+    ChannelView getChannel(size_t channel) const
+    {
+        return ChannelView(*this, channel);
+    }
+
+    /**
+     * @brief 全チャンネルの湿度データを1行追加
+     *
+     * @param values チャンネルごとの湿度値（%、CHANNELS 個）
+     * @param timestamp 記録した時刻（秒）
+     * @param flags イベントのビットフラグ（全チャンネル共通）
+     * @param pumpMask 前回の記録以降にポンプが稼働したチャンネルのビットマスク
+     */
+    void push(const float *values, uint32_t timestamp, uint8_t flags, uint8_t pumpMask)
+    {
+        // 時計が戻った場合や、間隔が列に収まらない場合は経過秒数を不明とする
+        uint32_t interval = timestamp - newestTime;
+        bool known = count > 0 && timestamp >= newestTime && interval < INTERVAL_UNKNOWN;
+
+        for (size_t channel = 0; channel < CHANNELS; channel++)
+        {
+            humidity[channel][head] = HumidityEncoding::encode(values[channel]);
+        }
+        intervals[head] = known ? interval : INTERVAL_UNKNOWN;
+        events[head] = flags;
+        pumps[head] = pumpMask;
+        newestTime = timestamp;
+        advance();
+    }
+
+    /**
+     * @brief 記録間隔を指定してエンコード済みの1行を追加
+     *
+     * 保存済みのデータを複製する場合に使用します。
+     *
+     * @param samples チャンネルごとのエンコード済みの湿度値（CHANNELS 個）
+     * @param timestamp 記録した時刻（秒）
+     * @param interval 前のデータからの経過秒数
+     * @param flags イベントのビットフラグ（全チャンネル共通）
+     * @param pumpMask 前回の記録以降にポンプが稼働したチャンネルのビットマスク
+     */
+    void pushRecord(const Sample *samples, uint32_t timestamp, uint16_t interval, uint8_t flags, uint8_t pumpMask)
+    {
+        for (size_t channel = 0; channel < CHANNELS; channel++)
+        {
+            humidity[channel][head] = samples[channel];
+        }
+        intervals[head] = interval;
+        events[head] = flags;
+        pumps[head] = pumpMask;
+        newestTime = timestamp;
+        advance();
+    }
+
+    /**
+     * @brief 湿度データをクリア
+     */
+    void clear()
+    {
+        memset(humidity, 0, sizeof(humidity));
+        memset(intervals, 0, sizeof(intervals));
+        memset(events, 0, sizeof(events));
+        memset(pumps, 0, sizeof(pumps));
+        newestTime = 0;
+        reset();
+    }
+};
@@ -0,0 +1,285 @@
+#include "multi_humidity_recorder.h"
+#include <esp_rom_crc.h>
+
+namespace
+{
+/**
+ * @brief ヘッダのCRCを計算する（crcフィールド自身は除く）
+ */
+template <typename Header> uint32_t headerCrc(const Header &header)
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&header), offsetof(Header, crc));
+}
+} // namespace
+
+bool BinarySDMultiHumidityRecorder::save(const MultiHumidityData &data)
+{
+    if (!card.ensureMounted())
+    {
+        return false;
+    }
+
+    // 再マウントされた場合はカードが差し替えられた可能性があるため全体を書き直す
+    if (card.getMountGeneration() != syncedGeneration)
+    {
+        synced = false;
+    }
+
+    uint32_t start = micros();
+    bool ok = write(data);
+    card.recordLatency(micros() - start);
+
+    if (!ok)
+    {
+        // 書き込みに失敗した場合はカードが抜かれた可能性がある
+        card.reportFailure();
+    }
+    return ok;
+}
+
+bool BinarySDMultiHumidityRecorder::load(MultiHumidityData &data)
+{
+    if (!card.ensureMounted())
+    {
+        return false;
+    }
+
+    uint32_t start = micros();
+    bool ok = read(data);
+    card.recordLatency(micros() - start);
+    return ok;
+}
+
+uint32_t BinarySDMultiHumidityRecorder::sectorCrc(const DataSector &sector, size_t sectorIndex)
+{
+    return esp_rom_crc32_le(sectorIndex, reinterpret_cast<const uint8_t *>(&sector), offsetof(DataSector, crc));
+}
+
+bool BinarySDMultiHumidityRecorder::writeDataSector(fs::File &file, const MultiHumidityData &data, size_t sectorIndex)
+{
+    uint8_t buffer[SECTOR_SIZE] = {};
+    DataSector sector = {};
+
+    // リングバッファの該当範囲の全列をコピー（最終セクタの余りはゼロ埋め）
+    size_t first = sectorIndex * ROWS_PER_SECTOR;
+    size_t n = std::min(ROWS_PER_SECTOR, MultiHumidityData::RECORD_SIZE - first);
+    memcpy(sector.intervals, &data.intervals[first], n * sizeof(uint16_t));
+    for (size_t channel = 0; channel < MultiHumidityData::CHANNELS; channel++)
+    {
+        memcpy(sector.humidity[channel], &data.humidity[channel][first], n * sizeof(MultiHumidityData::Sample));
+    }
+    memcpy(sector.events, &data.events[first], n * sizeof(uint8_t));
+    memcpy(sector.pumps, &data.pumps[first], n * sizeof(uint8_t));
+
+    // セクタ番号をシードにすることで、別の位置に書かれたセクタも検出できる
+    sector.crc = sectorCrc(sector, sectorIndex);
+    memcpy(buffer, &sector, sizeof(sector));
+
+    if (!file.seek((HEADER_SECTOR_COUNT + sectorIndex) * SECTOR_SIZE))
+    {
+        return false;
+    }
+    return file.write(buffer, SECTOR_SIZE) == SECTOR_SIZE;
+}
+
+bool BinarySDMultiHumidityRecorder::writeHeader(fs::File &file, const MultiHumidityData &data)
+{
+    uint8_t buffer[SECTOR_SIZE] = {};
+
+    FileHeader header = {};
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    header.sampleSize = sizeof(MultiHumidityData::Sample);
+    header.channels = MultiHumidityData::CHANNELS;
+    header.recordSize = MultiHumidityData::RECORD_SIZE;
+    header.rowsPerSector = ROWS_PER_SECTOR;
+    header.head = data.head;
+    header.count = data.count;
+    header.newestTime = data.newestTime;
+    header.sequence = headerSequence + 1;
+    header.crc = headerCrc(header);
+    memcpy(buffer, &header, sizeof(header));
+
+    // 失敗した場合は番号を進めず、次回も同じセクタに書き込む（最後に書き込めたヘッダは上書きしない）
+    if (!file.seek((header.sequence % HEADER_SECTOR_COUNT) * SECTOR_SIZE) ||
+        file.write(buffer, SECTOR_SIZE) != SECTOR_SIZE)
+    {
+        return false;
+    }
+    headerSequence = header.sequence;
+    return true;
+}
+
+bool BinarySDMultiHumidityRecorder::rewriteAll(const MultiHumidityData &data)
+{
+    // ファイルを作り直して全セクタを確保する
+    fs::File file = card.fs().open(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < DATA_SECTOR_COUNT && ok; i++)
+    {
+        ok = writeDataSector(file, data, i);
+    }
+
+    // ヘッダはデータの後に書き込み、未完成のファイルが有効とみなされないようにする
+    // （両方のコピーを書き込み、以前のファイルのヘッダがもう一方のセクタに残らないようにする）
+    for (size_t i = 0; i < HEADER_SECTOR_COUNT && ok; i++)
+    {
+        ok = writeHeader(file, data);
+    }
+    file.close();
+
+    return ok;
+}
+
+bool BinarySDMultiHumidityRecorder::write(const MultiHumidityData &data)
+{
+    uint32_t newRows = data.count - savedCount;
+    bool needsRewrite = !synced ||                                                          // ファイルの内容が不明
+                        data.count < savedCount ||                                          // データがクリアされた
+                        newRows >= MultiHumidityData::RECORD_SIZE ||                        // 全体が入れ替わった
+                        (savedHead + newRows) % MultiHumidityData::RECORD_SIZE != data.head; // ヘッドの整合性が取れない
+
+    bool ok;
+    if (needsRewrite)
+    {
+        ok = rewriteAll(data);
+    }
+    else
+    {
+        fs::File file = card.fs().open(path, "r+");
+        if (!file)
+        {
+            synced = false;
+            return false;
+        }
+
+        // 新しい行を含むセクタのみを書き込む
+        ok = true;
+        size_t index = savedHead;
+        size_t remaining = newRows;
+        while (remaining > 0 && ok)
+        {
+            size_t sectorIndex = index / ROWS_PER_SECTOR;
+            ok = writeDataSector(file, data, sectorIndex);
+
+            size_t sectorEnd = std::min((sectorIndex + 1) * ROWS_PER_SECTOR, MultiHumidityData::RECORD_SIZE);
+            size_t n = std::min(sectorEnd - index, remaining);
+            remaining -= n;
+            index = (index + n) % MultiHumidityData::RECORD_SIZE;
+        }
+
+        // 最後にヘッド位置を更新
+        ok = ok && writeHeader(file, data);
+        file.close();
+    }
+
+    synced = ok;
+    if (ok)
+    {
+        syncedGeneration = card.getMountGeneration();
+        savedHead = data.head;
+        savedCount = data.count;
+    }
+    return ok;
+}
+
+bool BinarySDMultiHumidityRecorder::isValidHeader(const FileHeader &header)
+{
+    return header.magic == FILE_MAGIC && header.version == FILE_VERSION && header.crc == headerCrc(header) &&
+           header.sampleSize == sizeof(MultiHumidityData::Sample) && header.channels == MultiHumidityData::CHANNELS &&
+           header.recordSize == MultiHumidityData::RECORD_SIZE && header.rowsPerSector == ROWS_PER_SECTOR &&
+           header.head < MultiHumidityData::RECORD_SIZE;
+}
+
+bool BinarySDMultiHumidityRecorder::read(MultiHumidityData &data)
+{
+    fs::File file = card.fs().open(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    uint8_t buffer[SECTOR_SIZE];
+    if (file.size() < (HEADER_SECTOR_COUNT + DATA_SECTOR_COUNT) * SECTOR_SIZE)
+    {
+        file.close();
+        return false;
+    }
+
+    // 2つのヘッダを読み込み、有効なもののうちシーケンス番号が新しい方を使う
+    // （書き込み途中で電源が落ちたヘッダはCRCが一致しないため、1つ前のヘッダが使われる）
+    FileHeader header = {};
+    bool found = false;
+    for (size_t i = 0; i < HEADER_SECTOR_COUNT; i++)
+    {
+        FileHeader candidate;
+        if (file.read(buffer, SECTOR_SIZE) != SECTOR_SIZE)
+        {
+            file.close();
+            return false;
+        }
+        memcpy(&candidate, buffer, sizeof(candidate));
+
+        if (isValidHeader(candidate) && (!found || static_cast<int32_t>(candidate.sequence - header.sequence) > 0))
+        {
+            header = candidate;
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        file.close();
+        return false;
+    }
+
+    // 全データセクタを読み込む（CRCが一致しないセクタはゼロで埋める）
+    bool ok = true;
+    size_t corruptSectors = 0;
+    for (size_t sectorIndex = 0; sectorIndex < DATA_SECTOR_COUNT && ok; sectorIndex++)
+    {
+        DataSector sector;
+        ok = file.read(buffer, SECTOR_SIZE) == SECTOR_SIZE;
+        memcpy(&sector, buffer, sizeof(sector));
+
+        bool valid = ok && sector.crc == sectorCrc(sector, sectorIndex);
+        if (!valid)
+        {
+            corruptSectors++;
+            sector = {};
+            std::fill(sector.intervals, sector.intervals + ROWS_PER_SECTOR, MultiHumidityData::INTERVAL_UNKNOWN);
+        }
+
+        size_t first = sectorIndex * ROWS_PER_SECTOR;
+        size_t n = std::min(ROWS_PER_SECTOR, MultiHumidityData::RECORD_SIZE - first);
+        memcpy(&data.intervals[first], sector.intervals, n * sizeof(uint16_t));
+        for (size_t channel = 0; channel < MultiHumidityData::CHANNELS; channel++)
+        {
+            memcpy(&data.humidity[channel][first], sector.humidity[channel], n * sizeof(MultiHumidityData::Sample));
+        }
+        memcpy(&data.events[first], sector.events, n * sizeof(uint8_t));
+        memcpy(&data.pumps[first], sector.pumps, n * sizeof(uint8_t));
+    }
+    file.close();
+
+    if (!ok)
+    {
+        return false;
+    }
+
+    data.head = header.head;
+    data.count = header.count;
+    data.newestTime = header.newestTime;
+    headerSequence = header.sequence;
+
+    // 破損セクタがあった場合は次回の保存でファイル全体を書き直す
+    synced = corruptSectors == 0;
+    syncedGeneration = card.getMountGeneration();
+    savedHead = header.head;
+    savedCount = header.count;
+    return true;
+}
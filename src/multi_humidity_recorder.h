@@ -0,0 +1,190 @@
+#pragma once
+
+#include "multi_humidity_data.h"
+#include "sd_card_manager.h"
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+
+/**
+ * @brief 複数チャンネルの湿度データの記録・読み出しを行うインターフェース
+ */
+class IMultiHumidityRecorder
+{
+public:
+    virtual ~IMultiHumidityRecorder() = default;
+
+    /**
+     * @brief 湿度データを保存する
+     *
+     * @param data 保存する湿度データ
+     * @return true 保存成功
+     * @return false 保存失敗
+     */
+    virtual bool save(const MultiHumidityData &data) = 0;
+
+    /**
+     * @brief 湿度データを読み込む
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @return true 読み込み成功
+     * @return false 読み込み失敗
+     */
+    virtual bool load(MultiHumidityData &data) = 0;
+};
+
+/**
+ * @brief SDカード上のバイナリリングファイルを使用した複数チャンネルの湿度データレコーダー
+ *
+ * BinarySDHumidityRecorder と同じく、メモリ上のリングバッファと同じ構造の固定長ファイルを確保し、
+ * 保存時は新しいデータを含むセクタとヘッダセクタだけを書き換えます。
+ * 各データセクタは ROWS_PER_SECTOR 行分の全チャンネルの列（記録間隔・各チャンネルの湿度・イベント・ポンプ）をまとめて持つため、
+ * 1回の記録で書き込むのはチャンネル数によらず1セクタとヘッダだけです。
+ * ヘッダは BinarySDHumidityRecorder と同じく2つのコピーを交互に書き換え、CRCが一致するうちシーケンス番号が新しい方を使います。
+ *
+ * ファイル構成:
+ * - セクタ0・1: ヘッダの2つのコピー（マジック、バージョン、チャンネル数、ヘッド位置、累計データ数、シーケンス番号）
+ * - セクタ2〜: データセクタ（ROWS_PER_SECTOR 行分の各列 + CRC）
+ */
+class BinarySDMultiHumidityRecorder final : public IMultiHumidityRecorder
+{
+public:
+    constexpr static size_t SECTOR_SIZE = 512; ///< SDカードのセクタサイズ
+    constexpr static size_t ROWS_PER_SECTOR =
+        (SECTOR_SIZE - sizeof(uint32_t)) /
+        (sizeof(uint16_t) + MultiHumidityData::CHANNELS * sizeof(MultiHumidityData::Sample) + 2 * sizeof(uint8_t)); ///< 1セクタあたりの行数
+    constexpr static size_t DATA_SECTOR_COUNT = (MultiHumidityData::RECORD_SIZE + ROWS_PER_SECTOR - 1) / ROWS_PER_SECTOR; ///< データセクタ数
+    constexpr static size_t HEADER_SECTOR_COUNT = 2;   ///< ヘッダのコピーの数（交互に書き込む）
+    constexpr static uint32_t FILE_MAGIC = 0x4D485447; ///< ファイル識別子（"GTHM"）
+    constexpr static uint16_t FILE_VERSION = 2;        ///< ファイルフォーマットのバージョン
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param card SDカードマネージャーへの参照
+     * @param path 保存先ファイルのパス
+     */
+    explicit BinarySDMultiHumidityRecorder(SDCardManager &card, const char *path = "/plants_log.bin") : card(card), path(path)
+    {
+    }
+
+    /**
+     * @brief 前回の保存以降に追加された行を含むセクタのみをSDカードへ書き込む
+     *
+     * ファイルが存在しない場合や、データがクリアされた場合、カードが再マウントされた場合はファイル全体を書き直します。
+     *
+     * @param data 保存する湿度データ
+     * @return true 保存成功
+     * @return false 保存失敗
+     */
+    bool save(const MultiHumidityData &data) override;
+
+    /**
+     * @brief SDカードからデータを読み込む
+     *
+     * CRCが一致しないセクタは書き込み途中で破損したものとみなし、ゼロで埋めます。
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @return true 読み込み成功
+     * @return false 読み込み失敗（ファイルなし、またはヘッダ不正）
+     */
+    bool load(MultiHumidityData &data) override;
+
+private:
+    /**
+     * @brief ファイルヘッダ（セクタ0・1に交互に格納）
+     */
+    struct FileHeader
+    {
+        uint32_t magic;         ///< ファイル識別子
+        uint16_t version;       ///< フォーマットバージョン
+        uint16_t sampleSize;    ///< 1データあたりのバイト数
+        uint32_t channels;      ///< チャンネル数
+        uint32_t recordSize;    ///< リングバッファの要素数
+        uint32_t rowsPerSector; ///< 1セクタあたりの行数
+        uint32_t head;          ///< リングバッファのヘッド
+        uint32_t count;         ///< 累計データ数
+        uint32_t newestTime;    ///< 最新データの時刻（秒）
+        uint32_t sequence;      ///< 書き込むたびに増える番号（奇数はセクタ1、偶数はセクタ0に格納）
+        uint32_t crc;           ///< ヘッダのCRC（このフィールドを除く）
+    };
+
+    /**
+     * @brief データセクタ
+     */
+    struct DataSector
+    {
+        uint16_t intervals[ROWS_PER_SECTOR];                                             ///< 前のデータからの経過秒数
+        MultiHumidityData::Sample humidity[MultiHumidityData::CHANNELS][ROWS_PER_SECTOR]; ///< チャンネルごとの湿度データ
+        uint8_t events[ROWS_PER_SECTOR];                                                 ///< イベントのビットフラグ
+        uint8_t pumps[ROWS_PER_SECTOR];                                                  ///< ポンプが稼働したチャンネルのビットマスク
+        uint32_t crc;                                                                    ///< セクタのCRC（セクタ番号をシードに使用）
+    };
+
+    static_assert(sizeof(FileHeader) <= SECTOR_SIZE, "FileHeader must fit in one sector");
+    static_assert(sizeof(DataSector) <= SECTOR_SIZE, "DataSector must fit in one sector");
+
+    SDCardManager &card; ///< SDカードマネージャーへの参照
+    const char *path;    ///< 保存先ファイルのパス
+
+    bool synced = false;           ///< ファイルの内容がメモリ上のデータと同期済みかどうか
+    uint32_t syncedGeneration = 0; ///< 同期したときのマウント世代
+    uint32_t savedHead = 0;        ///< 最後に保存したときのヘッド位置
+    uint32_t savedCount = 0;       ///< 最後に保存したときの累計データ数
+    uint32_t headerSequence = 0;   ///< 最後に書き込んだ（または読み込んだ）ヘッダのシーケンス番号
+
+    /**
+     * @brief 前回の保存以降の変更をファイルへ書き込む
+     */
+    bool write(const MultiHumidityData &data);
+
+    /**
+     * @brief ファイル全体を読み込む（ヘッダは2つのうち有効で新しい方を使う）
+     */
+    bool read(MultiHumidityData &data);
+
+    /**
+     * @brief ヘッダのCRCとフォーマットが現在のビルドと一致するかどうか
+     */
+    static bool isValidHeader(const FileHeader &header);
+
+    /**
+     * @brief 指定したデータセクタを書き込む
+     *
+     * @param file 書き込み先ファイル
+     * @param data 湿度データ
+     * @param sectorIndex データセクタ番号（0始まり）
+     * @return true 書き込み成功
+     * @return false 書き込み失敗
+     */
+    bool writeDataSector(fs::File &file, const MultiHumidityData &data, size_t sectorIndex);
+
+    /**
+     * @brief ヘッダセクタを書き込む
+     *
+     * 最後に書き込んだヘッダとは別のセクタに書き込み、書き込み途中で電源が落ちても前のヘッダが残るようにします。
+     *
+     * @param file 書き込み先ファイル
+     * @param data 湿度データ
+     * @return true 書き込み成功
+     * @return false 書き込み失敗
+     */
+    bool writeHeader(fs::File &file, const MultiHumidityData &data);
+
+    /**
+     * @brief ファイル全体を書き直す
+     *
+     * @param data 湿度データ
+     * @return true 書き込み成功
+     * @return false 書き込み失敗
+     */
+    bool rewriteAll(const MultiHumidityData &data);
+
+    /**
+     * @brief データセクタのCRCを計算する（crcフィールド自身は除く）
+     *
+     * @param sector データセクタ
+     * @param sectorIndex データセクタ番号（CRCのシードに使用）
+     */
+    static uint32_t sectorCrc(const DataSector &sector, size_t sectorIndex);
+};
@@ -0,0 +1,248 @@
+#include "multi_plant_app.h"
+#include "profiler.h"
+#include <time.h>
+
+void MultiPlantApp::begin()
+{
+    // OLEDの初期化と転送タスクの起動
+    if (!display.begin())
+    {
+        Serial.println("display: synchronous transfer");
+    }
+
+    // 周期的な処理の登録（同時に期限が来た場合は優先度の高い順に実行する）
+    sampleJob = jobs.add<&MultiPlantApp::sample>("sample", this, SAMPLE_INTERVAL, 5);
+    controlJob = jobs.add<&MultiPlantApp::control>("control", this, CONTROL_INTERVAL, 4);
+    inputJob = jobs.add<&MultiPlantApp::handleInput>("input", this, INPUT_INTERVAL, 3);
+    recordJob = jobs.add<&MultiPlantApp::record>("record", this, RECORD_CHECK_INTERVAL, 2);
+    renderJob = jobs.add<&MultiPlantApp::render>("render", this, DISPLAY_INTERVAL, 1);
+
+    // 過去のログを読み込み、選択中のチャンネルのグラフを作る
+    CpuBoost boost(governor);
+    recorder.load(data);
+    pyramid.rebuild(getSelectedChannel());
+}
+
+uint32_t MultiPlantApp::update()
+{
+    return jobs.run();
+}
+
+void MultiPlantApp::sample()
+{
+    PROFILE_PHASE(PHASE_SAMPLE);
+
+    // 全チャンネルの湿度をまとめて読み取る
+    reader.readAll(latestHumidity);
+}
+
+void MultiPlantApp::control()
+{
+    PROFILE_PHASE(PHASE_CONTROL);
+
+    // ポンプ制御（同時に稼働する台数はスケジューラーが制限する）
+    uint8_t runningBefore = scheduler.getRunningMask();
+    for (size_t channel = 0; channel < CHANNELS; channel++)
+    {
+        updatePump(channel, latestHumidity[channel]);
+    }
+
+    // 記録間隔の途中で稼働・停止したポンプも次のデータに残す
+    uint8_t running = scheduler.getRunningMask();
+    pendingPumps |= running;
+
+    // 稼働・停止があった場合は、すぐに画面を切り替えて記録する
+    if (running != runningBefore)
+    {
+        // いずれかのポンプの稼働中は湿度の変化が速いため、読み取りと制御の間隔を短くする
+        jobs.setPeriod(sampleJob, running ? WATERING_INTERVAL : SAMPLE_INTERVAL);
+        jobs.setPeriod(controlJob, running ? WATERING_INTERVAL : CONTROL_INTERVAL);
+
+        jobs.trigger(renderJob);
+        jobs.trigger(recordJob);
+    }
+}
+
+void MultiPlantApp::handleInput()
+{
+    PROFILE_PHASE(PHASE_INPUT);
+
+    // 割り込みで受け取ったボタンのイベントを古い順に処理する
+    Button::Event event;
+    while (button.poll(event))
+    {
+        // 長押し検知でリセット
+        if (event.type == Button::EVENT_LONG_PRESS)
+        {
+            resetHumidityData();
+            jobs.trigger(renderJob);
+        }
+
+        // シングルクリックで縮尺・チャンネル切り替え（長押しの後に離した場合を除く）
+        if (event.type == Button::EVENT_RELEASE && !event.longPressed)
+        {
+            nextView();
+            jobs.trigger(renderJob);
+        }
+    }
+
+    // ボタンで復帰できる場合、離されている間はイベントを取り出す間隔を延ばしてスリープできる時間を長くする
+    // （押されている間は、離したときのイベントにすぐ応えられるよう短い間隔で取り出す）
+    jobs.setPeriod(inputJob, buttonWakeup && !button.isPressed() ? INPUT_IDLE_INTERVAL : INPUT_INTERVAL);
+}
+
+void MultiPlantApp::record()
+{
+    PROFILE_PHASE(PHASE_RECORD);
+
+    // いずれかのチャンネルの湿度の変化量とポンプの状態に応じて記録間隔を変える
+    uint32_t currentTime = millis();
+    bool pumpOn = scheduler.getRunningMask() != 0;
+    if (!recordingPolicy.shouldRecord(currentTime, latestHumidity, CHANNELS, pumpOn))
+    {
+        return;
+    }
+
+    // 全チャンネルを1行として記録し、表示中のチャンネルだけをダウンサンプルに反映する
+    CpuBoost boost(governor);
+    data.push(latestHumidity, static_cast<uint32_t>(time(nullptr)), pendingEvents, pendingPumps);
+    pendingEvents = 0;
+    pendingPumps = 0;
+    pyramid.update(getSelectedChannel());
+
+    // ログの保存（保存タスクのキューに積むだけで、SDカードへの書き込みは待たない）
+    recorder.save(data);
+
+    recordingPolicy.onRecorded(currentTime, latestHumidity, CHANNELS, pumpOn);
+}
+
+void MultiPlantApp::render()
+{
+    PROFILE_PHASE(PHASE_RENDER);
+
+    // グラフの描画の間だけCPU周波数を上げる（I2C の転送は転送タスクが行い、転送速度はCPU周波数によらない）
+    CpuBoost boost(governor);
+    display.beginFrame();
+
+    int w = oled.getDisplayWidth();
+    int h = oled.getDisplayHeight();
+    drawChannelValue(0, 32, latestHumidity[selectedChannel]);
+
+    if (scheduler.isRunning(selectedChannel))
+    {
+        drawWateringView(0, 33, w, h - 33);
+    }
+    else
+    {
+        graphView.draw(pyramid, 0, 33, w, h - 33, graphScaleIndex);
+    }
+
+    // 転送タスクに渡し、転送を待たずに戻る（変化したタイルだけが送られる）
+    display.present();
+}
+
+void MultiPlantApp::nextView()
+{
+    graphScaleIndex = (graphScaleIndex + 1) % HumidityPyramid::LEVEL_COUNT;
+    if (graphScaleIndex == 0)
+    {
+        // ダウンサンプルは表示中のチャンネルの分だけを持つため、切り替え時に作り直す
+        selectedChannel = (selectedChannel + 1) % CHANNELS;
+        CpuBoost boost(governor);
+        pyramid.rebuild(getSelectedChannel());
+    }
+}
+
+void MultiPlantApp::updatePump(size_t channel, float humidity)
+{
+    uint32_t now = millis();
+    if (scheduler.isRunning(channel))
+    {
+        // ポンプ停止閾値以上の湿度、最大稼働時間を超過、またはタイマーで停止済み
+        if (humidity >= PUMP_OFF_THRESHOLD || now - scheduler.getStartTime(channel) >= PUMP_MAX_DURATION ||
+            scheduler.isCutOff(channel))
+        {
+            scheduler.stop(channel);
+            lastWateringTimes[channel] = now;
+        }
+    }
+    else if (scheduler.isWaiting(channel))
+    {
+        // 空きを待つ間に湿度が戻った場合は要求を取り消す
+        if (humidity >= PUMP_OFF_THRESHOLD)
+        {
+            scheduler.stop(channel);
+        }
+    }
+    else if (humidity < PUMP_ON_THRESHOLD &&                        // ポンプ起動閾値よりも現在の土壌水分が少ない
+             now - lastWateringTimes[channel] >= PUMP_MIN_INTERVAL) // 最後に水やりした時間から一定時間経過している
+    {
+        scheduler.request(channel);
+    }
+}
+
+void MultiPlantApp::drawChannelValue(const int x, const int y, const float humidity)
+{
+    char humStr[16];
+    sprintf(humStr, "%.1f", humidity);
+
+    // 大きいフォントで湿度値、小さいフォントで%を表示
+    oled.setFont(u8g2_font_logisoso22_tn);
+    oled.drawStr(x, y - 10, humStr);
+
+    const int humW = oled.getStrWidth(humStr);
+    oled.setFont(u8g2_font_logisoso16_tr);
+    oled.drawStr(x + humW + 2, y - 10, "%");
+
+    // 選択中のチャンネル番号を表示
+    char channelStr[16];
+    sprintf(channelStr, "P%u/%u", static_cast<unsigned>(selectedChannel + 1), static_cast<unsigned>(CHANNELS));
+    oled.setFont(u8g2_font_profont12_mf);
+    oled.drawStr(x, y, channelStr);
+
+    // 全チャンネルのポンプの状態を表示（稼働中は塗りつぶし、待機中は枠、選択中は下線）
+    int boxX = x + oled.getStrWidth(channelStr) + 4;
+    for (size_t channel = 0; channel < CHANNELS; channel++)
+    {
+        int bx = boxX + channel * 8;
+        if (scheduler.isRunning(channel))
+        {
+            oled.drawBox(bx, y - 7, 6, 6);
+        }
+        else if (scheduler.isWaiting(channel))
+        {
+            oled.drawFrame(bx, y - 7, 6, 6);
+        }
+        else
+        {
+            oled.drawPixel(bx + 2, y - 4);
+        }
+
+        if (channel == selectedChannel)
+        {
+            oled.drawHLine(bx, y, 6);
+        }
+    }
+}
+
+void MultiPlantApp::drawWateringView(const int x, const int y, const int w, const int h)
+{
+    oled.setFont(u8g2_font_profont17_tf);
+    const char *text = "watering...";
+    int textWidth = oled.getStrWidth(text);
+    int centerX = x + (w - textWidth) / 2;
+    oled.drawStr(centerX, y + h / 2, text);
+}
+
+void MultiPlantApp::resetHumidityData()
+{
+    CpuBoost boost(governor);
+
+    // データをリセット
+    data.clear();
+    pyramid.update(getSelectedChannel());
+    pendingEvents |= HumidityData::EVENT_RESET;
+
+    // ログの保存
+    recorder.save(data);
+}
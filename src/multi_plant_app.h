@@ -0,0 +1,252 @@
+#pragma once
+
+#include "async_display.h"
+#include "button.h"
+#include "cpu_frequency_governor.h"
+#include "humidity_graph_view.h"
+#include "humidity_pyramid.h"
+#include "humidity_reader.h"
+#include "job_scheduler.h"
+#include "multi_humidity_data.h"
+#include "multi_humidity_recorder.h"
+#include "pump_scheduler.h"
+#include "recording_policy.h"
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+/**
+ * @brief 複数の植木鉢を1台で管理するアプリケーションのメインクラス
+ *
+ * 全チャンネルのセンサーをまとめて読み取り、1つの MultiHumidityData に記録します。
+ * ポンプは PumpScheduler を通して稼働させ、同時に稼働する台数を制限します。
+ *
+ * 画面には選択中の1チャンネルだけを表示し、グラフ用のダウンサンプルもそのチャンネルの分だけを保持します。
+ * シングルクリックで縮尺を切り替え、最も粗い縮尺の次は次のチャンネルの 1x に切り替えます。長押しでリセットします。
+ *
+ * GreenThumbApp と同じく、各処理は周期の異なるジョブとして JobScheduler に登録します。
+ */
+class MultiPlantApp final
+{
+public:
+    /**
+     * @brief コンストラクタ
+     *
+     * @param reader 複数チャンネルの湿度リーダーへの参照
+     * @param recorder 複数チャンネルの湿度レコーダーへの参照
+     * @param pumps チャンネルごとのポンプコントローラーの配列
+     * @param maxRunningPumps 同時に稼働できるポンプの最大数
+     * @param oled OLEDディスプレイオブジェクトへの参照
+     * @param governor 描画・保存・履歴の読み込みの間にCPU周波数を上げるガバナーへの参照
+     * @param button 割り込みで入力を受け取るボタンへの参照（begin() 済み）
+     */
+    MultiPlantApp(IMultiHumidityReader &reader, IMultiHumidityRecorder &recorder, IPumpController *const *pumps,
+                  size_t maxRunningPumps, U8G2 &oled, CpuFrequencyGovernor &governor, Button &button)
+        : reader(reader), recorder(recorder), scheduler(pumps, MultiHumidityData::CHANNELS, maxRunningPumps), oled(oled),
+          governor(governor), button(button), data(), pyramid(RECORD_INTERVAL / 1000), graphView(oled), display(oled)
+    {
+    }
+
+    ~MultiPlantApp() = default;
+
+    /**
+     * @brief アプリケーションの初期化
+     *
+     * 依存コンポーネントの初期化や、保存されたデータの読み込みを行います。
+     * setup() 関数内で呼び出してください。
+     */
+    void begin();
+
+    /**
+     * @brief アプリケーションの更新処理
+     *
+     * センサー読み取り、ポンプ制御、画面更新、ボタン入力処理などのうち、期限が来たジョブを実行します。
+     * loop() 関数内で呼び出し、戻り値の時間だけ delay() してください。
+     *
+     * @return uint32_t 次のジョブの期限までの時間（ミリ秒）
+     */
+    uint32_t update();
+
+    /**
+     * @brief ポンプが稼働中かどうか（稼働中はスリープせず、制御の周期を短くする）
+     */
+    bool isWatering() const
+    {
+        return scheduler.getRunningMask() != 0;
+    }
+
+    /**
+     * @brief ボタンでスリープから復帰できるかどうかを設定する
+     *
+     * 復帰できる場合は、ボタンが離されている間の読み取り間隔を INPUT_IDLE_INTERVAL に延ばし、
+     * スリープできる時間を長くします。
+     *
+     * @param enabled ボタンで復帰できる場合は true
+     */
+    void setButtonWakeup(bool enabled)
+    {
+        buttonWakeup = enabled;
+    }
+
+    /**
+     * @brief ボタンでスリープから復帰したときの処理（すぐにボタンを読み取る）
+     */
+    void onButtonWakeup()
+    {
+        jobs.trigger(inputJob);
+    }
+
+    /**
+     * @brief ディスプレイを取得する（描画・転送統計の表示用）
+     */
+    const AsyncDisplay &getDisplay() const
+    {
+        return display;
+    }
+
+    /**
+     * @brief 履歴グラフの描画を取得する（描画統計の表示用）
+     */
+    const HumidityGraphView &getGraphView() const
+    {
+        return graphView;
+    }
+
+    /**
+     * @brief 画面の転送中かどうか（転送中はスリープしない）
+     */
+    bool isDisplayBusy() const
+    {
+        return display.isBusy();
+    }
+
+    /**
+     * @brief 転送が終わるのを待ってから、ディスプレイの省電力モードを切り替える
+     *
+     * @param enabled 省電力モードにする（表示を消す）場合は true
+     */
+    void setDisplayPowerSave(bool enabled)
+    {
+        display.setPowerSave(enabled);
+    }
+
+    /**
+     * @brief ジョブスケジューラーを取得する（実行統計の表示用）
+     */
+    const JobScheduler &getJobScheduler() const
+    {
+        return jobs;
+    }
+
+    constexpr static uint8_t USR_BTN_PIN = D1;                 ///< ユーザーボタンのピン番号
+    constexpr static uint32_t PUMP_MAX_DURATION = 15 * 1000;   ///< ポンプの最大稼働時間（15秒）
+    constexpr static float PUMP_OFF_THRESHOLD = 75.0f;         ///< ポンプを停止させる湿度閾値 (%)
+    constexpr static uint32_t RECORD_INTERVAL = 5 * 60 * 1000; ///< 基準の記録間隔（5分、グラフの1列分の時間。記録間隔が不明なデータにも使う）
+
+private:
+    constexpr static size_t CHANNELS = MultiHumidityData::CHANNELS;        ///< チャンネル数
+    constexpr static uint32_t DISPLAY_INTERVAL = 2000;                     ///< ディスプレイ更新間隔（2秒）
+    constexpr static uint32_t SAMPLE_INTERVAL = 1000;                      ///< センサー読み取り間隔（1秒）
+    constexpr static uint32_t CONTROL_INTERVAL = 1000;                     ///< ポンプ制御間隔（1秒）
+    constexpr static uint32_t WATERING_INTERVAL = 20;                      ///< ポンプ稼働中のセンサー読み取り・ポンプ制御間隔（20ミリ秒）
+    constexpr static uint32_t INPUT_INTERVAL = 20;                         ///< ボタン読み取り間隔（20ミリ秒）
+    constexpr static uint32_t INPUT_IDLE_INTERVAL = 1000;                  ///< ボタンで復帰できる場合の、離されている間のボタン読み取り間隔（1秒）
+    constexpr static uint32_t RECORD_CHECK_INTERVAL = 1000;                ///< 記録するかどうかの判定間隔（1秒）
+    constexpr static uint32_t PUMP_MIN_INTERVAL = 3 * 24 * 60 * 60 * 1000; ///< ポンプ再稼働までの最短クールタイム（3日）
+    constexpr static float PUMP_ON_THRESHOLD = 5.0f;                       ///< ポンプを作動させる湿度閾値 (%)
+
+    IMultiHumidityReader &reader;            ///< 複数チャンネルの湿度リーダー
+    IMultiHumidityRecorder &recorder;        ///< 複数チャンネルの湿度レコーダー
+    PumpScheduler scheduler;                 ///< ポンプの同時稼働数を制限するスケジューラー
+    U8G2 &oled;                              ///< OLEDディスプレイ
+    CpuFrequencyGovernor &governor;          ///< CPU周波数のガバナー
+    Button &button;                          ///< ボタンコントローラー
+    MultiHumidityData data;                  ///< 全チャンネルの湿度データ
+    HumidityPyramid pyramid;                 ///< 選択中のチャンネルのグラフ表示用の多段ダウンサンプル
+    HumidityGraphView graphView;             ///< 履歴グラフの描画
+    AsyncDisplay display;                    ///< 描画と転送を分けたディスプレイ
+    AdaptiveRecordingPolicy recordingPolicy; ///< 記録間隔を決める記録ポリシー
+    JobScheduler jobs;                       ///< 周期的な処理のスケジューラー
+
+    uint32_t lastWateringTimes[CHANNELS] = {};        ///< チャンネルごとの最後にポンプを停止した時間（ミリ秒）
+    uint8_t selectedChannel = 0;                      ///< 表示中のチャンネル
+    uint8_t graphScaleIndex = 0;                      ///< グラフ縮尺インデックス
+    uint8_t pendingEvents = HumidityData::EVENT_BOOT; ///< 次に記録するデータに付けるイベント
+    uint8_t pendingPumps = 0;                         ///< 次に記録するデータに付けるポンプのビットマスク
+    float latestHumidity[CHANNELS] = {};              ///< チャンネルごとの最後に読み取った湿度値（%）
+    int sampleJob = JobScheduler::INVALID_JOB;        ///< センサー読み取りのジョブ番号
+    int controlJob = JobScheduler::INVALID_JOB;       ///< ポンプ制御のジョブ番号
+    int inputJob = JobScheduler::INVALID_JOB;         ///< ボタン読み取りのジョブ番号
+    int recordJob = JobScheduler::INVALID_JOB;        ///< 記録のジョブ番号
+    int renderJob = JobScheduler::INVALID_JOB;        ///< 画面表示のジョブ番号
+    bool buttonWakeup = false;                        ///< ボタンでスリープから復帰できるかどうか
+
+    /**
+     * @brief 選択中のチャンネルのビューを取得する
+     */
+    MultiHumidityData::ChannelView getSelectedChannel() const
+    {
+        return data.getChannel(selectedChannel);
+    }
+
+    /**
+     * @brief 全チャンネルの湿度をまとめて読み取る（ジョブ）
+     */
+    void sample();
+
+    /**
+     * @brief 全チャンネルのポンプの稼働・停止を判定する（ジョブ）
+     */
+    void control();
+
+    /**
+     * @brief ボタンの状態を読み取り、操作に応じた処理を行う（ジョブ）
+     */
+    void handleInput();
+
+    /**
+     * @brief 記録ポリシーに従って全チャンネルの湿度を記録・保存する（ジョブ）
+     */
+    void record();
+
+    /**
+     * @brief 画面を描画する（ジョブ）
+     */
+    void render();
+
+    /**
+     * @brief 次の縮尺に切り替え、最も粗い縮尺の次は次のチャンネルに切り替える
+     */
+    void nextView();
+
+    /**
+     * @brief 1チャンネル分のポンプの稼働・停止を判定する
+     *
+     * @param channel チャンネル番号（0始まり）
+     * @param humidity 現在の湿度値（%）
+     */
+    void updatePump(size_t channel, float humidity);
+
+    /**
+     * @brief 選択中のチャンネルの湿度値と、全チャンネルのポンプの状態を描画する
+     *
+     * @param x 描画開始X座標
+     * @param y 描画開始Y座標
+     * @param humidity 選択中のチャンネルの湿度値
+     */
+    void drawChannelValue(const int x, const int y, const float humidity);
+
+    /**
+     * @brief ポンプ作動中の画面を描画する
+     *
+     * @param x 描画領域の左上X座標
+     * @param y 描画領域の左上Y座標
+     * @param w 描画領域の幅
+     * @param h 描画領域の高さ
+     */
+    void drawWateringView(const int x, const int y, const int w, const int h);
+
+    /**
+     * @brief 全チャンネルの湿度データをリセットする
+     */
+    void resetHumidityData();
+};
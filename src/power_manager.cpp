@@ -0,0 +1,53 @@
+#include "power_manager.h"
+#include <esp_sleep.h>
+#include <esp_timer.h>
+
+void PowerManager::begin()
+{
+    lastWakeup = esp_timer_get_time();
+    if (!lightSleep)
+    {
+        return;
+    }
+
+    // ボタンの状態が変わるとスリープから復帰する（ピンごとの設定はスリープの直前に Button が行う）
+    esp_sleep_enable_gpio_wakeup();
+}
+
+bool PowerManager::idle(uint32_t duration, bool canSleep)
+{
+    // 前回の復帰から今までが稼働時間
+    int64_t start = esp_timer_get_time();
+    if (lastWakeup != 0)
+    {
+        activeTime += start - lastWakeup;
+    }
+
+    bool buttonWakeup = false;
+    if (lightSleep && canSleep && duration >= MIN_SLEEP)
+    {
+        // esp_timer はライトスリープ中の時間も補正して進むため、復帰後の時刻の差がスリープ時間になる
+        esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(duration) * 1000);
+        reader.suspend();
+        button.enableWakeup();
+        esp_light_sleep_start();
+        button.disableWakeup();
+        reader.resume();
+        sleepCount++;
+
+        buttonWakeup = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+        if (buttonWakeup)
+        {
+            buttonWakeupCount++;
+        }
+        lastWakeup = esp_timer_get_time();
+        sleepTime += lastWakeup - start;
+    }
+    else
+    {
+        delay(duration);
+        lastWakeup = esp_timer_get_time();
+        delayTime += lastWakeup - start;
+    }
+    return buttonWakeup;
+}
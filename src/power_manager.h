@@ -0,0 +1,133 @@
+#pragma once
+
+#include "adc_humidity_reader.h"
+#include "button.h"
+#include <Arduino.h>
+
+#ifndef LIGHT_SLEEP_ENABLED
+#define LIGHT_SLEEP_ENABLED 0 ///< ジョブの間にライトスリープするかどうか（1 で有効）
+#endif
+
+/**
+ * @brief ジョブの間の待ち時間を、ライトスリープまたは delay() で過ごす電源管理クラス
+ *
+ * ライトスリープが有効な場合、次のジョブの期限までタイマーを設定してライトスリープし、
+ * ボタンの状態が変わったとき（押された、または離されたとき）にも復帰します。スリープ中はCPUと周辺機器のクロックが止まり、
+ * RAMとGPIOの状態は保持されます。ADCの連続変換（DMA）はスリープをまたいで続けられないため、スリープの間は止めます。
+ *
+ * 待ち時間が MIN_SLEEP 未満の場合や、スリープできない状態（ポンプの稼働中、保存タスクの処理中など）では
+ * 通常の delay() で待ち、その間は他のタスクが動作します。
+ *
+ * 稼働時間・スリープ時間・delay() の時間を計測し、デューティ比（稼働時間の割合）を求められます。
+ */
+class PowerManager final
+{
+public:
+    constexpr static uint32_t MIN_SLEEP = 5; ///< ライトスリープする最短の待ち時間（ミリ秒、これ未満は delay()）
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param button スリープから復帰させるボタン（状態が変わると復帰）
+     * @param reader スリープの間は連続変換を止める湿度リーダー
+     * @param lightSleep ライトスリープを使用するかどうか
+     */
+    PowerManager(Button &button, ContinuousADCHumidityReader &reader, bool lightSleep = LIGHT_SLEEP_ENABLED)
+        : button(button), reader(reader), lightSleep(lightSleep)
+    {
+    }
+
+    /**
+     * @brief スリープからの復帰要因を設定する
+     *
+     * ボタンのピンの初期化後に、setup() 関数内で呼び出してください。
+     */
+    void begin();
+
+    /**
+     * @brief ライトスリープを使用するかどうか
+     */
+    bool isLightSleepEnabled() const
+    {
+        return lightSleep;
+    }
+
+    /**
+     * @brief 次のジョブの期限まで待つ
+     *
+     * @param duration 待ち時間（ミリ秒）
+     * @param canSleep ライトスリープしてよいかどうか
+     * @return true ボタンでスリープから復帰した
+     * @return false 待ち時間が経過した
+     */
+    bool idle(uint32_t duration, bool canSleep);
+
+    /**
+     * @brief 稼働していた時間を取得する
+     *
+     * @return uint64_t 時間（マイクロ秒）
+     */
+    uint64_t getActiveTime() const
+    {
+        return activeTime;
+    }
+
+    /**
+     * @brief ライトスリープしていた時間を取得する
+     *
+     * @return uint64_t 時間（マイクロ秒）
+     */
+    uint64_t getSleepTime() const
+    {
+        return sleepTime;
+    }
+
+    /**
+     * @brief delay() で待っていた時間を取得する
+     *
+     * @return uint64_t 時間（マイクロ秒）
+     */
+    uint64_t getDelayTime() const
+    {
+        return delayTime;
+    }
+
+    /**
+     * @brief ライトスリープした回数を取得する
+     */
+    uint32_t getSleepCount() const
+    {
+        return sleepCount;
+    }
+
+    /**
+     * @brief ボタンでスリープから復帰した回数を取得する
+     */
+    uint32_t getButtonWakeupCount() const
+    {
+        return buttonWakeupCount;
+    }
+
+    /**
+     * @brief デューティ比（計測開始からの稼働時間の割合）を取得する
+     *
+     * @return float 稼働時間の割合（0.0 〜 1.0）
+     */
+    float getDutyCycle() const
+    {
+        uint64_t total = activeTime + sleepTime + delayTime;
+        return total ? static_cast<float>(activeTime) / total : 1.0f;
+    }
+
+private:
+    Button &button;                      ///< スリープから復帰させるボタン
+    ContinuousADCHumidityReader &reader; ///< スリープの間は連続変換を止める湿度リーダー
+    bool lightSleep;                     ///< ライトスリープを使用するかどうか
+
+    int64_t lastWakeup = 0;         ///< 前回 idle() から戻った時刻（マイクロ秒、0 は未計測）
+    uint64_t activeTime = 0;        ///< 稼働していた時間（マイクロ秒）
+    uint64_t sleepTime = 0;         ///< ライトスリープしていた時間（マイクロ秒）
+    uint64_t delayTime = 0;         ///< delay() で待っていた時間（マイクロ秒）
+    uint32_t sleepCount = 0;        ///< ライトスリープした回数
+    uint32_t buttonWakeupCount = 0; ///< ボタンでスリープから復帰した回数
+};
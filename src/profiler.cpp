@@ -0,0 +1,139 @@
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <algorithm>
+#include <esp_attr.h>
+#include <string.h>
+
+namespace
+{
+/**
+ * @brief タスクウォッチドッグの記録（リセットをまたいで残す）
+ */
+struct WatchdogRecord
+{
+    uint32_t magic;  ///< 記録が有効であることを示す値
+    uint32_t count;  ///< 発火した回数
+    uint32_t phases; ///< 最後に発火したときに実行中だったフェーズのビットマスク
+};
+
+constexpr uint32_t WATCHDOG_MAGIC = 0x47545744; ///< "GTWD"
+
+RTC_NOINIT_ATTR WatchdogRecord watchdogRecord; ///< タスクウォッチドッグの記録
+
+const char *const PHASE_NAMES[Profiler::PHASE_COUNT] = {
+    "sample", "control", "input", "record", "save", "render", "transfer", "history",
+};
+} // namespace
+
+volatile bool Profiler::enabled = true;
+volatile uint32_t Profiler::startTimes[PHASE_COUNT] = {};
+Profiler::PhaseStats Profiler::stats[PHASE_COUNT] = {};
+volatile int Profiler::lastStallPhase = -1;
+portMUX_TYPE Profiler::lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool Profiler::begin()
+{
+    // 電源投入後のRAMは不定のため、印がなければ記録を作り直す
+    if (watchdogRecord.magic != WATCHDOG_MAGIC)
+    {
+        watchdogRecord = {WATCHDOG_MAGIC, 0, 0};
+    }
+
+    // loop() が止まったときにタスクウォッチドッグが発火するようにする
+    enableLoopWDT();
+
+    esp_timer_handle_t timer;
+    esp_timer_create_args_t args = {};
+    args.callback = watch;
+    args.name = "profiler";
+    if (esp_timer_create(&args, &timer) != ESP_OK)
+    {
+        return false;
+    }
+    return esp_timer_start_periodic(timer, WATCH_INTERVAL * 1000) == ESP_OK;
+}
+
+void Profiler::exit(Phase phase, uint32_t start)
+{
+    // 下位32bitどうしの差のため、一周（約71分）未満の時間は正しく求まる
+    uint32_t elapsed = static_cast<uint32_t>(esp_timer_get_time()) - start;
+    startTimes[phase] = 0;
+
+    // バケットは時間の2進の桁数で決める（除算やループを使わない）
+    size_t bucket = elapsed == 0 ? 0 : 31 - __builtin_clz(elapsed);
+    portENTER_CRITICAL(&lock);
+    PhaseStats &phaseStats = stats[phase];
+    phaseStats.count++;
+    phaseStats.totalTime += elapsed;
+    phaseStats.maxTime = std::max(phaseStats.maxTime, elapsed);
+    phaseStats.buckets[std::min(bucket, BUCKET_COUNT - 1)]++;
+    portEXIT_CRITICAL(&lock);
+}
+
+const char *Profiler::getName(Phase phase)
+{
+    return PHASE_NAMES[phase];
+}
+
+uint32_t Profiler::getWatchdogCount()
+{
+    return watchdogRecord.magic == WATCHDOG_MAGIC ? watchdogRecord.count : 0;
+}
+
+uint32_t Profiler::getWatchdogPhases()
+{
+    return watchdogRecord.magic == WATCHDOG_MAGIC ? watchdogRecord.phases : 0;
+}
+
+void Profiler::reset()
+{
+    portENTER_CRITICAL(&lock);
+    memset(stats, 0, sizeof(stats));
+    lastStallPhase = -1;
+    portEXIT_CRITICAL(&lock);
+}
+
+void IRAM_ATTR Profiler::onWatchdog()
+{
+    uint32_t phases = 0;
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+    {
+        if (startTimes[i] != 0)
+        {
+            phases |= 1u << i;
+        }
+    }
+    watchdogRecord.magic = WATCHDOG_MAGIC;
+    watchdogRecord.count++;
+    watchdogRecord.phases = phases;
+}
+
+void Profiler::watch(void *arg)
+{
+    // 同じ実行を何度も数えないよう、STALL_TIME を超えてから WATCH_INTERVAL の間に1回だけ数える
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+    {
+        uint32_t start = startTimes[i];
+        uint32_t elapsed = now - start;
+        if (start != 0 && elapsed >= STALL_TIME * 1000 && elapsed < (STALL_TIME + WATCH_INTERVAL) * 1000)
+        {
+            portENTER_CRITICAL(&lock);
+            stats[i].stallCount++;
+            lastStallPhase = i;
+            portEXIT_CRITICAL(&lock);
+        }
+    }
+}
+
+/**
+ * @brief タスクウォッチドッグの割り込みから呼ばれるフック（ESP-IDF の弱いシンボルを置き換える）
+ */
+extern "C" void IRAM_ATTR esp_task_wdt_isr_user_handler(void)
+{
+    Profiler::onWatchdog();
+}
+
+#endif
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 0 ///< 処理のフェーズごとの時間を計測するかどうか（0 の場合は計測のコードを一切含めない）
+#endif
+
+#if PROFILER_ENABLED
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+/**
+ * @brief 処理のフェーズごとの時間の計測と、停滞の検出
+ *
+ * センサー読み取り・ポンプ制御・ボタン入力・記録・保存・描画・画面転送・履歴の読み込みの各フェーズを
+ * PROFILE_PHASE() で囲むと、フェーズごとに回数・合計・最長の時間と、2のべき乗の幅の固定バケット
+ * （1, 2, 4, ... マイクロ秒）のヒストグラムを記録します。
+ *
+ * 時間は esp_timer（システムタイマー）で計ります。ESP32-C3 のサイクルカウンタは CPU クロックで進み、
+ * CpuFrequencyGovernor がフェーズの途中で周波数を切り替えるため、サイクル数からは時間に換算できません。
+ *
+ * フェーズの実行中は開始時刻を保持しており、WATCH_INTERVAL ごとのタイマーで STALL_TIME を超えて
+ * 続いているフェーズを停滞として数えます。タスクウォッチドッグが発火した場合は、その時点で実行中だったフェーズを
+ * リセット後も残るRAMに記録します（loop() のタスクはウォッチドッグに登録されます）。
+ *
+ * 開始時刻はフェーズごとに1つだけ保持するため、各フェーズは同時に1つのタスクだけが実行します（同じフェーズの入れ子も不可）。
+ * 保存（PHASE_SAVE）と画面転送（PHASE_TRANSFER）は、専用タスクの起動前だけ loop() のタスクが同期的に実行し、
+ * 起動後は専用タスクだけが実行するため重なりません。重なった場合は enter() の configASSERT() で停止します。
+ *
+ * 開始時刻は esp_timer の下位32bit（約71分で一周）で保持し、別のタスクのタイマーやウォッチドッグの割り込みからも
+ * 1回の読み出しで読めるようにしています（RV32 では64bitの読み出しが2回に分かれ、書き込みの途中の値を読むことがあります）。
+ * 計測結果の更新と消去はスピンロックで排他します。setEnabled(false) にすると、
+ * 計測のコストはフラグの確認だけになります。PROFILER_ENABLED が 0 の場合、このクラスと計測のコードはビルドに含まれません。
+ */
+class Profiler final
+{
+public:
+    constexpr static size_t BUCKET_COUNT = 16;      ///< ヒストグラムのバケット数（最後のバケットは 32768 マイクロ秒以上）
+    constexpr static uint32_t STALL_TIME = 1000;    ///< 停滞とみなすフェーズの時間（ミリ秒）
+    constexpr static uint32_t WATCH_INTERVAL = 250; ///< 停滞を確認する間隔（ミリ秒）
+
+    /**
+     * @brief 処理のフェーズ
+     */
+    enum Phase : uint8_t
+    {
+        PHASE_SAMPLE,   ///< センサー読み取り
+        PHASE_CONTROL,  ///< ポンプ制御
+        PHASE_INPUT,    ///< ボタン入力
+        PHASE_RECORD,   ///< 記録の判定と追加
+        PHASE_SAVE,     ///< ログの保存
+        PHASE_RENDER,   ///< 画面の描画
+        PHASE_TRANSFER, ///< OLEDへの転送
+        PHASE_HISTORY,  ///< 履歴の読み込み
+        PHASE_COUNT     ///< フェーズの数
+    };
+
+    /**
+     * @brief フェーズごとの計測結果
+     */
+    struct PhaseStats
+    {
+        uint32_t count;                 ///< 実行回数
+        uint64_t totalTime;             ///< 合計の時間（マイクロ秒）
+        uint32_t maxTime;               ///< 最長の時間（マイクロ秒）
+        uint32_t stallCount;            ///< STALL_TIME を超えた回数
+        uint32_t buckets[BUCKET_COUNT]; ///< 時間のヒストグラム（バケット i は 2^i 以上 2^(i+1) 未満のマイクロ秒）
+    };
+
+    /**
+     * @brief 停滞の確認とタスクウォッチドッグの登録を開始する
+     *
+     * @return true 開始成功
+     * @return false タイマーの作成に失敗
+     */
+    static bool begin();
+
+    /**
+     * @brief 計測するかどうかを設定する
+     */
+    static void setEnabled(bool enabled)
+    {
+        Profiler::enabled = enabled;
+    }
+
+    /**
+     * @brief 計測するかどうか
+     */
+    static bool isEnabled()
+    {
+        return enabled;
+    }
+
+    /**
+     * @brief フェーズの開始を記録する
+     *
+     * 同じフェーズを別のタスクが実行中でないこと（同じタスクでの入れ子でないこと）。
+     *
+     * @return uint32_t 開始時刻（マイクロ秒の下位32bit、実行していないことを表す 0 にならないよう最下位bitを立てる）
+     */
+    static uint32_t enter(Phase phase)
+    {
+        // 実行中の同じフェーズの開始時刻を上書きすると、停滞やウォッチドッグの記録が誤るため止める
+        configASSERT(startTimes[phase] == 0);
+
+        uint32_t now = static_cast<uint32_t>(esp_timer_get_time()) | 1;
+        startTimes[phase] = now;
+        return now;
+    }
+
+    /**
+     * @brief フェーズの終了を記録し、時間をヒストグラムに加える
+     *
+     * @param start enter() が返した開始時刻
+     */
+    static void exit(Phase phase, uint32_t start);
+
+    /**
+     * @brief フェーズの計測結果を取得する
+     */
+    static const PhaseStats &getStats(Phase phase)
+    {
+        return stats[phase];
+    }
+
+    /**
+     * @brief フェーズの名前を取得する
+     */
+    static const char *getName(Phase phase);
+
+    /**
+     * @brief ヒストグラムのバケットの下限を取得する
+     *
+     * @return uint32_t 下限（マイクロ秒）
+     */
+    constexpr static uint32_t getBucketFloor(size_t bucket)
+    {
+        return bucket == 0 ? 0 : 1u << bucket;
+    }
+
+    /**
+     * @brief 最後に停滞したフェーズを取得する
+     *
+     * @return int 停滞したフェーズ（まだ停滞していない場合は -1）
+     */
+    static int getLastStallPhase()
+    {
+        return lastStallPhase;
+    }
+
+    /**
+     * @brief タスクウォッチドッグが発火した回数を取得する（リセットをまたいで数える）
+     */
+    static uint32_t getWatchdogCount();
+
+    /**
+     * @brief 最後にタスクウォッチドッグが発火したときに実行中だったフェーズのビットマスクを取得する
+     */
+    static uint32_t getWatchdogPhases();
+
+    /**
+     * @brief 計測結果を消去する（タスクウォッチドッグの記録は残す）
+     */
+    static void reset();
+
+    /**
+     * @brief タスクウォッチドッグの割り込みから呼ばれ、実行中のフェーズを記録する
+     */
+    static void onWatchdog();
+
+private:
+    static volatile bool enabled;                     ///< 計測するかどうか
+    static volatile uint32_t startTimes[PHASE_COUNT]; ///< 実行中のフェーズの開始時刻（マイクロ秒の下位32bit、0 は実行していない）
+    static PhaseStats stats[PHASE_COUNT];             ///< フェーズごとの計測結果（lock で保護）
+    static volatile int lastStallPhase;               ///< 最後に停滞したフェーズ
+    static portMUX_TYPE lock;                         ///< 計測結果の更新・消去の排他
+
+    /**
+     * @brief 停滞を確認するタイマーのコールバック
+     */
+    static void watch(void *arg);
+};
+
+/**
+ * @brief スコープの間をフェーズとして計測する
+ *
+ * 計測が無効な場合は、フラグの確認だけで何もしません。
+ */
+class PhaseScope final
+{
+public:
+    /**
+     * @brief コンストラクタ（フェーズの開始）
+     */
+    explicit PhaseScope(Profiler::Phase phase) : phase(phase), start(Profiler::isEnabled() ? Profiler::enter(phase) : 0)
+    {
+    }
+
+    /**
+     * @brief デストラクタ（フェーズの終了）
+     */
+    ~PhaseScope()
+    {
+        if (start != 0)
+        {
+            Profiler::exit(phase, start);
+        }
+    }
+
+    PhaseScope(const PhaseScope &) = delete;
+    PhaseScope &operator=(const PhaseScope &) = delete;
+
+private:
+    Profiler::Phase phase; ///< 計測するフェーズ
+    uint32_t start;        ///< 開始時刻（マイクロ秒の下位32bit、0 は計測しない）
+};
+
+/// スコープの終わりまでをフェーズとして計測する（例: PROFILE_PHASE(PHASE_RENDER);）
+#define PROFILE_PHASE(phase) PhaseScope profilePhase(Profiler::phase)
+
+#else
+
+/// 計測を含めないビルドでは何もしない
+#define PROFILE_PHASE(phase) \
+    do                       \
+    {                        \
+    } while (0)
+
+#endif
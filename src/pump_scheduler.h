@@ -0,0 +1,173 @@
+#pragma once
+
+#include "pump_controller.h"
+#include <Arduino.h>
+
+/**
+ * @brief 同時に稼働するポンプの数を制限するスケジューラー
+ *
+ * 電源の電流容量を超えないよう、同時に稼働するポンプを最大 maxRunning 台に制限します。
+ * 空きがないときの稼働要求は待ち行列に入れ、稼働中のポンプが停止した時点で要求の古い順に稼働させます。
+ * 稼働状態・待機状態はチャンネルごとのビットマスクで保持するため、判定はチャンネル数によらず O(1) です。
+ */
+class PumpScheduler final
+{
+public:
+    constexpr static size_t MAX_CHANNELS = 8; ///< 管理できる最大チャンネル数
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param pumps チャンネルごとのポンプコントローラーの配列（最初の稼働要求までに設定）
+     * @param channelCount チャンネル数（最大 MAX_CHANNELS）
+     * @param maxRunning 同時に稼働できるポンプの最大数
+     */
+    PumpScheduler(IPumpController *const *pumps, size_t channelCount, size_t maxRunning)
+        : pumps(pumps), channelCount(std::min(channelCount, MAX_CHANNELS)), maxRunning(maxRunning)
+    {
+    }
+
+    /**
+     * @brief ポンプの稼働を要求する
+     *
+     * 空きがあればすぐに稼働させ、なければ待ち行列に入れます。稼働中・待機中のチャンネルは無視します。
+     *
+     * @param channel チャンネル番号（0始まり）
+     */
+    void request(size_t channel)
+    {
+        uint8_t bit = 1 << channel;
+        if (channel >= channelCount || ((runningMask | waitingMask) & bit))
+        {
+            return;
+        }
+
+        queue[(queueFront + queueSize) % MAX_CHANNELS] = channel;
+        queueSize++;
+        waitingMask |= bit;
+        startWaiting();
+    }
+
+    /**
+     * @brief ポンプを停止する（待機中の場合は要求を取り消す）
+     *
+     * 空いた枠で待機中のポンプを稼働させます。
+     *
+     * @param channel チャンネル番号（0始まり）
+     */
+    void stop(size_t channel)
+    {
+        uint8_t bit = 1 << channel;
+        if (runningMask & bit)
+        {
+            pumps[channel]->turnOff();
+            runningMask &= ~bit;
+        }
+        else if (waitingMask & bit)
+        {
+            removeWaiting(channel);
+        }
+        startWaiting();
+    }
+
+    /**
+     * @brief ポンプが稼働中かどうか
+     */
+    bool isRunning(size_t channel) const
+    {
+        return runningMask & (1 << channel);
+    }
+
+    /**
+     * @brief 稼働中のはずのポンプが、コントローラー側で停止されたかどうか（タイマーによる強制停止など）
+     */
+    bool isCutOff(size_t channel) const
+    {
+        return isRunning(channel) && !pumps[channel]->isOn();
+    }
+
+    /**
+     * @brief ポンプが空きを待っているかどうか
+     */
+    bool isWaiting(size_t channel) const
+    {
+        return waitingMask & (1 << channel);
+    }
+
+    /**
+     * @brief 稼働中のポンプのビットマスクを取得する
+     */
+    uint8_t getRunningMask() const
+    {
+        return runningMask;
+    }
+
+    /**
+     * @brief 稼働中のポンプの数を取得する
+     */
+    size_t getRunningCount() const
+    {
+        return __builtin_popcount(runningMask);
+    }
+
+    /**
+     * @brief ポンプが稼働を開始した時間を取得する
+     *
+     * @param channel チャンネル番号（0始まり）
+     * @return uint32_t 稼働を開始した時間（ミリ秒）
+     */
+    uint32_t getStartTime(size_t channel) const
+    {
+        return startTimes[channel];
+    }
+
+private:
+    IPumpController *const *pumps; ///< チャンネルごとのポンプコントローラー
+    size_t channelCount;           ///< チャンネル数
+    size_t maxRunning;             ///< 同時に稼働できるポンプの最大数
+
+    uint8_t runningMask = 0;                ///< 稼働中のチャンネルのビットマスク
+    uint8_t waitingMask = 0;                ///< 待機中のチャンネルのビットマスク
+    uint8_t queue[MAX_CHANNELS] = {};       ///< 稼働要求の待ち行列（リングバッファ）
+    size_t queueFront = 0;                  ///< 待ち行列の先頭の位置
+    size_t queueSize = 0;                   ///< 待ち行列の要素数
+    uint32_t startTimes[MAX_CHANNELS] = {}; ///< チャンネルごとの稼働開始時間（ミリ秒）
+
+    /**
+     * @brief 待ち行列から指定したチャンネルの要求を取り除く
+     */
+    void removeWaiting(size_t channel)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < queueSize; i++)
+        {
+            uint8_t queued = queue[(queueFront + i) % MAX_CHANNELS];
+            if (queued != channel)
+            {
+                queue[(queueFront + kept) % MAX_CHANNELS] = queued;
+                kept++;
+            }
+        }
+        queueSize = kept;
+        waitingMask &= ~(1 << channel);
+    }
+
+    /**
+     * @brief 空きがある限り、待ち行列の古い順にポンプを稼働させる
+     */
+    void startWaiting()
+    {
+        while (queueSize > 0 && getRunningCount() < maxRunning)
+        {
+            uint8_t channel = queue[queueFront];
+            queueFront = (queueFront + 1) % MAX_CHANNELS;
+            queueSize--;
+
+            uint8_t bit = 1 << channel;
+            waitingMask &= ~bit;
+            runningMask |= bit;
+            startTimes[channel] = millis();
+            pumps[channel]->turnOn();
+        }
+    }
+};
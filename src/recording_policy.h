@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief 湿度の変化量に応じて記録間隔を変える記録ポリシー
+ *
+ * 前回記録した値から DEADBAND 以上変化したときだけ記録するため、変化が速いほど記録間隔が短くなり
+ * （最短 MIN_INTERVAL）、安定している間は MAX_INTERVAL ごとの記録だけになります。
+ * ポンプの稼働中は ACTIVE_INTERVAL ごとに記録し、稼働・停止の瞬間もすぐに記録します。
+ *
+ * 各データには前回からの経過秒数が記録されるため、グラフは記録間隔によらず均等な時間軸で描画できます。
+ */
+class AdaptiveRecordingPolicy final
+{
+public:
+    constexpr static size_t MAX_CHANNELS = 8;                ///< 判定できる最大チャンネル数
+    constexpr static uint32_t ACTIVE_INTERVAL = 10 * 1000;   ///< ポンプ稼働中の記録間隔（10秒）
+    constexpr static uint32_t MIN_INTERVAL = 60 * 1000;      ///< 湿度が変化しているときの最短の記録間隔（1分）
+    constexpr static uint32_t MAX_INTERVAL = 30 * 60 * 1000; ///< 湿度が安定しているときの記録間隔（30分）
+    constexpr static float DEADBAND = 1.0f;                  ///< 記録する湿度の変化量 (%)
+
+    /**
+     * @brief 今記録すべきかどうか判定する
+     *
+     * @param now 現在の時間（ミリ秒）
+     * @param humidity チャンネルごとの現在の湿度値（%）
+     * @param channels チャンネル数（最大 MAX_CHANNELS）
+     * @param active ポンプが稼働中かどうか（複数チャンネルの場合はいずれか）
+     * @return true 記録する
+     * @return false 記録しない
+     */
+    bool shouldRecord(uint32_t now, const float *humidity, size_t channels, bool active) const
+    {
+        // 起動後最初の判定と、ポンプの稼働・停止の瞬間はすぐに記録する
+        if (!recorded || active != lastActive)
+        {
+            return true;
+        }
+
+        // オーバーフロー対応の差分計算
+        uint32_t elapsed = now - lastTime;
+        if (elapsed >= MAX_INTERVAL || (active && elapsed >= ACTIVE_INTERVAL))
+        {
+            return true;
+        }
+        if (elapsed < MIN_INTERVAL)
+        {
+            return false;
+        }
+
+        // いずれかのチャンネルが前回の記録から不感帯を超えて変化した
+        for (size_t i = 0; i < std::min(channels, MAX_CHANNELS); i++)
+        {
+            if (fabsf(humidity[i] - lastValues[i]) >= DEADBAND)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief 記録したことを通知する
+     *
+     * @param now 記録した時間（ミリ秒）
+     * @param humidity チャンネルごとの記録した湿度値（%）
+     * @param channels チャンネル数（最大 MAX_CHANNELS）
+     * @param active ポンプが稼働中かどうか
+     */
+    void onRecorded(uint32_t now, const float *humidity, size_t channels, bool active)
+    {
+        for (size_t i = 0; i < std::min(channels, MAX_CHANNELS); i++)
+        {
+            lastValues[i] = humidity[i];
+        }
+        lastTime = now;
+        lastActive = active;
+        recorded = true;
+    }
+
+private:
+    float lastValues[MAX_CHANNELS] = {}; ///< 前回記録したチャンネルごとの湿度値（%）
+    uint32_t lastTime = 0;               ///< 前回記録した時間（ミリ秒）
+    bool lastActive = false;             ///< 前回記録したときにポンプが稼働中だったか
+    bool recorded = false;               ///< 起動後に記録したかどうか
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief 要素数が2のべき乗の固定長リングバッファの位置管理
+ *
+ * インデックスの計算は剰余ではなくビットマスクで行うため、除算命令を使いません。
+ * 記録済みのデータは配列上で最大2つの連続した区間（古い側・折り返し後）に分かれるので、
+ * getRanges() で得たインデックスの区間ごとに、同じ位置に対応する各配列（列）をまとめて読み書きできます。
+ *
+ * @tparam N 要素数（2のべき乗）
+ */
+template <size_t N>
+struct RingIndex
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "RingBuffer size must be a power of two");
+
+    constexpr static size_t CAPACITY = N;  ///< 要素数
+    constexpr static size_t MASK = N - 1;  ///< インデックスのマスク
+
+    /**
+     * @brief 配列上の連続したインデックスの区間
+     */
+    struct Range
+    {
+        size_t start; ///< 区間の先頭のインデックス
+        size_t size;  ///< 区間の要素数
+    };
+
+    uint32_t head;  ///< 次に書き込む位置（0〜N-1）
+    uint32_t count; ///< clear() 以降に追加された累計要素数
+
+    /**
+     * @brief コンストラクタ
+     */
+    RingIndex() : head(0), count(0)
+    {
+    }
+
+    /**
+     * @brief 新しい順のインデックスを配列上の位置に変換する
+     *
+     * @param index 要素のインデックス（0 が最新）
+     * @return size_t 配列上の位置
+     */
+    size_t position(size_t index) const
+    {
+        return (head - 1 - index) & MASK;
+    }
+
+    /**
+     * @brief 記録済みの要素数を取得する（最大 N）
+     */
+    size_t size() const
+    {
+        return count < N ? count : N;
+    }
+
+    /**
+     * @brief 最新の要素を古い順に並べた、最大2つの連続したインデックスの区間を取得する
+     *
+     * older → newer の順に読むと古い順になります。折り返さない場合 newer は空です。
+     *
+     * @param[out] older 古い側の区間（折り返し位置まで）
+     * @param[out] newer 新しい側の区間（配列の先頭から）
+     * @param newest 対象にする最新の要素数（記録済みの要素数を超える分は無視）
+     */
+    void getRanges(Range &older, Range &newer, size_t newest = N) const
+    {
+        size_t n = newest < size() ? newest : size();
+        size_t start = (head - n) & MASK;
+        size_t first = n < N - start ? n : N - start;
+        older = {start, first};
+        newer = {0, n - first};
+    }
+
+protected:
+    /**
+     * @brief 書き込み位置を1つ進める
+     */
+    void advance()
+    {
+        head = (head + 1) & MASK;
+        count++;
+    }
+
+    /**
+     * @brief 位置を初期状態に戻す
+     */
+    void reset()
+    {
+        head = 0;
+        count = 0;
+    }
+};
+
+/**
+ * @brief 要素数が2のべき乗の固定長リングバッファ
+ *
+ * 記録済みのデータは getSpans() で最大2つの連続した区間としてまとめて読めます。
+ * 同じ位置に対応する別の配列（列）を持つ派生クラスは、getRanges() で得たインデックスの区間で各列を読めます。
+ *
+ * @tparam T 要素の型
+ * @tparam N 要素数（2のべき乗）
+ */
+template <typename T, size_t N>
+struct RingBuffer : RingIndex<N>
+{
+    using typename RingIndex<N>::Range;
+
+    /**
+     * @brief 配列上の連続した区間
+     */
+    struct Span
+    {
+        const T *data; ///< 区間の先頭
+        size_t size;   ///< 区間の要素数
+    };
+
+    T items[N]; ///< 要素の配列
+
+    /**
+     * @brief コンストラクタ
+     *
+     * 要素をゼロ初期化します。
+     */
+    RingBuffer() : items{}
+    {
+    }
+
+    /**
+     * @brief 新しい順に要素を取得する
+     *
+     * @param index 要素のインデックス（0 が最新）
+     * @return const T& 要素への参照
+     */
+    const T &at(size_t index) const
+    {
+        return items[this->position(index)];
+    }
+
+    /**
+     * @brief 要素を追加する
+     *
+     * @param value 追加する要素
+     */
+    void push(const T &value)
+    {
+        items[this->head] = value;
+        this->advance();
+    }
+
+    /**
+     * @brief 要素をクリアする
+     */
+    void clear()
+    {
+        memset(items, 0, sizeof(items));
+        this->reset();
+    }
+
+    /**
+     * @brief 最新の要素を古い順に並べた、最大2つの連続した区間を取得する
+     *
+     * @param[out] older 古い側の区間（折り返し位置まで）
+     * @param[out] newer 新しい側の区間（配列の先頭から）
+     * @param newest 対象にする最新の要素数（記録済みの要素数を超える分は無視）
+     */
+    void getSpans(Span &older, Span &newer, size_t newest = N) const
+    {
+        Range ranges[2];
+        this->getRanges(ranges[0], ranges[1], newest);
+        older = {&items[ranges[0].start], ranges[0].size};
+        newer = {&items[0], ranges[1].size};
+    }
+};
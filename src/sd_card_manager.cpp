@@ -0,0 +1,110 @@
+#include "sd_card_manager.h"
+
+void SDCardManager::begin()
+{
+    pinMode(csPin, OUTPUT);
+    if (detectPin >= 0)
+    {
+        pinMode(detectPin, INPUT_PULLUP);
+    }
+}
+
+const char *SDCardManager::getStateName(State state)
+{
+    switch (state)
+    {
+    case State::Unmounted:
+        return "unmounted";
+    case State::Mounted:
+        return "mounted";
+    case State::Absent:
+        return "absent";
+    case State::Failed:
+        return "failed";
+    }
+    return "?";
+}
+
+bool SDCardManager::ensureMounted()
+{
+    bool detected = isCardDetected();
+    bool inserted = detected && !cardWasDetected;
+    cardWasDetected = detected;
+
+    if (state == State::Mounted)
+    {
+        // 検出ピンで抜き取りを検知
+        if (!detected)
+        {
+            unmount(State::Absent);
+            return false;
+        }
+        return true;
+    }
+
+    if (!detected)
+    {
+        state = State::Absent;
+        return false;
+    }
+
+    // カードが挿入された直後はバックオフを待たずに試行する（オーバーフロー対応の差分計算）
+    if (!inserted && state != State::Unmounted && millis() - lastAttemptTime < backoff)
+    {
+        return false;
+    }
+
+    return mount();
+}
+
+bool SDCardManager::mount()
+{
+    uint32_t start = micros();
+    mountAttempts++;
+    lastAttemptTime = millis();
+
+    sd.end();
+    bool ok = sd.begin(csPin) && sd.cardType() != CARD_NONE;
+    recordLatency(micros() - start);
+
+    if (ok)
+    {
+        state = State::Mounted;
+        backoff = 0;
+        mountGeneration++;
+        return true;
+    }
+
+    mountFailures++;
+    sd.end();
+
+    // 検出ピンで挿入が確認できている場合は失敗、それ以外はカードなしとみなす
+    state = detectPin >= 0 ? State::Failed : State::Absent;
+    backoff = backoff == 0 ? INITIAL_BACKOFF : std::min(backoff * 2, MAX_BACKOFF);
+    return false;
+}
+
+void SDCardManager::unmount(State newState)
+{
+    sd.end();
+    state = newState;
+    lastAttemptTime = millis();
+    backoff = INITIAL_BACKOFF;
+}
+
+void SDCardManager::reportFailure()
+{
+    ioFailures++;
+    if (state == State::Mounted)
+    {
+        unmount(State::Failed);
+    }
+}
+
+void SDCardManager::recordLatency(uint32_t latency)
+{
+    lastLatency = latency;
+    maxLatency = std::max(maxLatency, latency);
+    totalLatency += latency;
+    operationCount++;
+}
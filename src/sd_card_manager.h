@@ -0,0 +1,201 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+
+/**
+ * @brief SDカードのマウント状態を管理するクラス
+ *
+ * マウント状態を保持し、保存・読み込みのたびに sd.begin() を呼び出さずに済むようにします。
+ * マウントに失敗した場合は指数バックオフで再試行し、カードがない間の待ち時間を抑えます。
+ * カード検出ピンが指定されている場合は、ピンの状態からカードの抜き差しを即座に検出します。
+ */
+class SDCardManager
+{
+public:
+    /**
+     * @brief マウント状態
+     */
+    enum class State : uint8_t
+    {
+        Unmounted, ///< 未マウント（まだ試行していない）
+        Mounted,   ///< マウント済み
+        Absent,    ///< カードが挿入されていない
+        Failed,    ///< カードはあるがマウントまたは入出力に失敗した
+    };
+
+    constexpr static uint32_t INITIAL_BACKOFF = 1000;      ///< 再試行間隔の初期値（1秒）
+    constexpr static uint32_t MAX_BACKOFF = 5 * 60 * 1000; ///< 再試行間隔の上限（5分）
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param sd SDファイルシステムオブジェクトへの参照
+     * @param csPin SDカードモジュールのCSピン
+     * @param detectPin カード検出ピン（LOWで挿入）。-1 の場合は使用しない
+     */
+    SDCardManager(fs::SDFS &sd, uint8_t csPin, int8_t detectPin = -1) : sd(sd), csPin(csPin), detectPin(detectPin)
+    {
+    }
+
+    /**
+     * @brief ピンの初期化
+     *
+     * setup() 関数内で呼び出してください。
+     */
+    void begin();
+
+    /**
+     * @brief SDカードがマウントされていることを保証する
+     *
+     * マウント済みであれば即座に true を返します。
+     * 未マウントの場合、バックオフ期間が経過していればマウントを試行します。
+     *
+     * @return true マウント済み
+     * @return false 利用不可
+     */
+    bool ensureMounted();
+
+    /**
+     * @brief ファイル操作の失敗を通知する
+     *
+     * カードが抜かれた可能性があるため、アンマウントして再マウント待ちの状態にします。
+     */
+    void reportFailure();
+
+    /**
+     * @brief ファイル操作の所要時間を記録する
+     *
+     * @param latency 所要時間（マイクロ秒）
+     */
+    void recordLatency(uint32_t latency);
+
+    /**
+     * @brief SDファイルシステムを取得する
+     */
+    fs::SDFS &fs()
+    {
+        return sd;
+    }
+
+    /**
+     * @brief 現在のマウント状態を取得する
+     */
+    State getState() const
+    {
+        return state;
+    }
+
+    /**
+     * @brief マウント状態の名前を取得する（統計の表示用）
+     */
+    static const char *getStateName(State state);
+
+    /**
+     * @brief マウントに成功した回数を取得する
+     *
+     * カードが差し替えられたかどうかの判定に使用します。
+     */
+    uint32_t getMountGeneration() const
+    {
+        return mountGeneration;
+    }
+
+    /**
+     * @brief マウントを試行した回数を取得する
+     */
+    uint32_t getMountAttempts() const
+    {
+        return mountAttempts;
+    }
+
+    /**
+     * @brief マウントに失敗した回数を取得する
+     */
+    uint32_t getMountFailures() const
+    {
+        return mountFailures;
+    }
+
+    /**
+     * @brief ファイル操作の失敗が通知された回数を取得する
+     */
+    uint32_t getIoFailures() const
+    {
+        return ioFailures;
+    }
+
+    /**
+     * @brief 所要時間を記録したファイル操作の回数を取得する
+     */
+    uint32_t getOperationCount() const
+    {
+        return operationCount;
+    }
+
+    /**
+     * @brief 直近のファイル操作の所要時間を取得する（マイクロ秒）
+     */
+    uint32_t getLastLatency() const
+    {
+        return lastLatency;
+    }
+
+    /**
+     * @brief ファイル操作の最大所要時間を取得する（マイクロ秒）
+     */
+    uint32_t getMaxLatency() const
+    {
+        return maxLatency;
+    }
+
+    /**
+     * @brief ファイル操作の平均所要時間を取得する（マイクロ秒）
+     */
+    uint32_t getAverageLatency() const
+    {
+        return operationCount == 0 ? 0 : totalLatency / operationCount;
+    }
+
+private:
+    fs::SDFS &sd;     ///< SDファイルシステムへの参照
+    uint8_t csPin;    ///< CSピン番号
+    int8_t detectPin; ///< カード検出ピン番号（-1 で未使用）
+
+    State state = State::Unmounted;     ///< 現在のマウント状態
+    uint32_t lastAttemptTime = 0;       ///< 最後にマウントを試行した時間（ミリ秒）
+    uint32_t backoff = 0;               ///< 次の試行までの待ち時間（ミリ秒）
+    bool cardWasDetected = false;       ///< 前回確認時にカード検出ピンが挿入を示していたか
+
+    uint32_t mountGeneration = 0; ///< マウント成功回数
+    uint32_t mountAttempts = 0;   ///< マウント試行回数
+    uint32_t mountFailures = 0;   ///< マウント失敗回数
+    uint32_t ioFailures = 0;      ///< ファイル操作の失敗回数
+    uint32_t lastLatency = 0;     ///< 直近の操作時間
+    uint32_t maxLatency = 0;      ///< 最大操作時間
+    uint64_t totalLatency = 0;    ///< 操作時間の合計
+    uint32_t operationCount = 0;  ///< 操作回数
+
+    /**
+     * @brief カード検出ピンがカードの挿入を示しているか
+     *
+     * 検出ピンを使用しない場合は常に true を返します。
+     */
+    bool isCardDetected() const
+    {
+        return detectPin < 0 || digitalRead(detectPin) == LOW;
+    }
+
+    /**
+     * @brief マウントを試行する
+     */
+    bool mount();
+
+    /**
+     * @brief アンマウントしてバックオフを開始する
+     *
+     * @param newState アンマウント後の状態
+     */
+    void unmount(State newState);
+};
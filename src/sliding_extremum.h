@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/**
+ * @brief 直近 N 件の最小値（または最大値）を保持するスライディングウィンドウ
+ *
+ * 単調キュー（モノトニックデック）で実装しており、push() は償却 O(1)、get() は O(1) です。
+ * 新しい値より極値になり得ない古い値は追加時に取り除くため、キューには単調な値だけが残ります。
+ *
+ * @tparam T 値の型
+ * @tparam N ウィンドウの長さ
+ * @tparam Compare 優先する値が先になる比較関数（最小値は std::less、最大値は std::greater）
+ */
+template <typename T, size_t N, typename Compare>
+class SlidingExtremum final
+{
+public:
+    /**
+     * @brief 値を追加し、ウィンドウから外れた値を取り除く
+     *
+     * @param value 追加する値
+     */
+    void push(T value)
+    {
+        // ウィンドウから外れた先頭の値を取り除く
+        if (size > 0 && entries[front].sequence + N <= sequence)
+        {
+            front = (front + 1) % N;
+            size--;
+        }
+
+        // 新しい値に勝てない末尾の値は、今後極値になることがないため取り除く
+        while (size > 0 && !Compare()(entries[(front + size - 1) % N].value, value))
+        {
+            size--;
+        }
+
+        entries[(front + size) % N] = {value, sequence};
+        size++;
+        sequence++;
+    }
+
+    /**
+     * @brief ウィンドウ内の極値を取得する
+     *
+     * empty() のときは呼び出さないでください。
+     */
+    T get() const
+    {
+        return entries[front].value;
+    }
+
+    /**
+     * @brief ウィンドウが空かどうか
+     */
+    bool empty() const
+    {
+        return size == 0;
+    }
+
+    /**
+     * @brief ウィンドウを空にする
+     */
+    void clear()
+    {
+        front = 0;
+        size = 0;
+        sequence = 0;
+    }
+
+private:
+    /**
+     * @brief キューの要素
+     */
+    struct Entry
+    {
+        T value;           ///< 値
+        uint32_t sequence; ///< 追加された順番
+    };
+
+    Entry entries[N] = {};  ///< キュー（リングバッファ）
+    size_t front = 0;       ///< 先頭の位置
+    size_t size = 0;        ///< 要素数
+    uint32_t sequence = 0;  ///< 次に追加する値の順番
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 書き込み側・読み出し側が1つずつの、ロックを使わない固定長キュー
+ *
+ * 割り込みハンドラ（書き込み側）からタスク（読み出し側）へイベントを渡すために使います。
+ * 書き込み側は tail だけを、読み出し側は head だけを更新するため、ミューテックスや割り込みの禁止は不要です。
+ * インデックスは 32bit の読み書き（load/store）だけで更新するため、アトミックな read-modify-write 命令のない
+ * ESP32-C3 でもロックフリーです。インデックスの計算は剰余ではなくビットマスクで行います。
+ *
+ * 書き込み側が複数ある場合は、書き込み側どうしを呼び出し側で排他してください。
+ *
+ * @tparam T 要素の型
+ * @tparam N 要素数（2のべき乗）
+ */
+template <typename T, size_t N>
+class SpscQueue final
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    constexpr static size_t CAPACITY = N; ///< 要素数
+    constexpr static size_t MASK = N - 1; ///< インデックスのマスク
+
+    /**
+     * @brief 要素を追加する（書き込み側）
+     *
+     * 割り込みハンドラから呼び出せるよう、常にインライン展開します。
+     *
+     * @param value 追加する要素
+     * @return true 追加した
+     * @return false キューが満杯
+     */
+    __attribute__((always_inline)) inline bool push(const T &value)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= N)
+        {
+            return false;
+        }
+
+        items[t & MASK] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 最も古い要素を取り出す（読み出し側）
+     *
+     * @param[out] value 取り出した要素
+     * @return true 取り出した
+     * @return false キューが空
+     */
+    bool pop(T &value)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = items[h & MASK];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief キューが空かどうか（読み出し側）
+     */
+    bool empty() const
+    {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T items[N] = {};               ///< 要素の配列
+    std::atomic<uint32_t> head{0}; ///< 次に取り出す位置（読み出し側だけが更新する）
+    std::atomic<uint32_t> tail{0}; ///< 次に追加する位置（書き込み側だけが更新する）
+};
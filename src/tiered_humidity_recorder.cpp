@@ -0,0 +1,197 @@
+#include "tiered_humidity_recorder.h"
+
+bool TieredHumidityRecorder::writeHeader(fs::File &file)
+{
+    JournalHeader header = {FILE_MAGIC, FILE_VERSION, sizeof(JournalEntry)};
+    return file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header);
+}
+
+bool TieredHumidityRecorder::appendJournal(const HumidityData &data)
+{
+    uint32_t newSamples = std::min<uint32_t>(data.count - journaledCount, HumidityData::RECORD_SIZE);
+    if (newSamples == 0)
+    {
+        return true;
+    }
+
+    fs::File file = flash.open(path, "a");
+    if (!file)
+    {
+        return false;
+    }
+    if (file.size() == 0 && !writeHeader(file))
+    {
+        file.close();
+        return false;
+    }
+
+    // 追加されたデータを古い順に追記
+    uint32_t entryCount = data.count - newSamples;
+    size_t written = data.visitNewest(newSamples, 0, [&](size_t index, uint32_t timestamp) {
+        JournalEntry entry = {++entryCount, timestamp, data.intervals[index], data.items[index], data.events[index]};
+        return file.write(reinterpret_cast<const uint8_t *>(&entry), sizeof(entry)) == sizeof(entry);
+    });
+    file.close();
+
+    journalCount += written;
+    bool ok = written == newSamples;
+
+    if (ok)
+    {
+        journaledCount = data.count;
+    }
+    return ok;
+}
+
+bool TieredHumidityRecorder::compactJournal(const HumidityData &data)
+{
+    fs::File file = flash.open(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    // リングバッファに残っている分だけを書き直す
+    uint32_t samples = data.size();
+    uint32_t entryCount = data.count - samples;
+    bool ok = writeHeader(file) && data.visitNewest(samples, 0, [&](size_t index, uint32_t timestamp) {
+        JournalEntry entry = {++entryCount, timestamp, data.intervals[index], data.items[index], data.events[index]};
+        return file.write(reinterpret_cast<const uint8_t *>(&entry), sizeof(entry)) == sizeof(entry);
+    }) == samples;
+    file.close();
+
+    journalCount = samples;
+    journaledCount = data.count;
+    return ok;
+}
+
+bool TieredHumidityRecorder::flush(const HumidityData &data)
+{
+    lastFlushTime = millis();
+    if (!inner.save(data))
+    {
+        return false;
+    }
+
+    // SDカードに反映できたのでジャーナルは不要
+    flash.remove(path);
+    journalCount = 0;
+    flushCount++;
+    return true;
+}
+
+bool TieredHumidityRecorder::save(const HumidityData &data)
+{
+    // クリアされた場合はジャーナルを破棄し、すぐにSDカードへ反映する
+    if (data.count < journaledCount)
+    {
+        flash.remove(path);
+        journalCount = 0;
+        journaledCount = 0;
+        if (flush(data))
+        {
+            return true;
+        }
+
+        // SDカードに反映できなかった場合は、次回の起動時にクリアを再現できるよう記録する
+        fs::File file = flash.open(path, "w");
+        if (!file)
+        {
+            return false;
+        }
+        JournalEntry marker = {CLEAR_MARKER, 0, 0, 0, 0};
+        bool ok = writeHeader(file) && file.write(reinterpret_cast<const uint8_t *>(&marker), sizeof(marker)) == sizeof(marker);
+        file.close();
+        journalCount = 1;
+        return ok && appendJournal(data);
+    }
+
+    bool journaled = appendJournal(data);
+
+    // 一定時間ごと、またはジャーナルが溜まったらSDカードへまとめて保存（オーバーフロー対応の差分計算）
+    bool flushed = false;
+    if (journalCount >= FLUSH_THRESHOLD || millis() - lastFlushTime >= FLUSH_INTERVAL)
+    {
+        flushed = flush(data);
+    }
+
+    // SDカードがないままジャーナルが上限に達した場合は、フラッシュのみで履歴を保持する
+    if (journalCount > JOURNAL_CAPACITY)
+    {
+        journaled = compactJournal(data);
+    }
+
+    return journaled || flushed;
+}
+
+bool TieredHumidityRecorder::replayJournal(HumidityData &data, bool restoreCount)
+{
+    fs::File file = flash.open(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    // フォーマットの異なるジャーナル（ファームウェアの更新前のものなど）は、エントリを正しく解釈できないため破棄する
+    JournalHeader header;
+    if (file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) != sizeof(header) ||
+        header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.entrySize != sizeof(JournalEntry))
+    {
+        file.close();
+        flash.remove(path);
+        journalCount = 0;
+        return false;
+    }
+
+    // 書き込み途中で途切れた末尾のエントリは無視する
+    size_t entries = (file.size() - sizeof(header)) / sizeof(JournalEntry);
+    size_t applied = 0;
+    JournalEntry entry;
+    for (size_t i = 0; i < entries; i++)
+    {
+        if (file.read(reinterpret_cast<uint8_t *>(&entry), sizeof(entry)) != sizeof(entry))
+        {
+            break;
+        }
+
+        if (entry.count == CLEAR_MARKER)
+        {
+            data.clear();
+            continue;
+        }
+
+        // SDカードに反映済みのデータは読み飛ばす
+        if (!restoreCount && entry.count <= data.count)
+        {
+            continue;
+        }
+
+        data.pushRecord(entry.value, entry.timestamp, entry.interval, entry.events);
+        if (restoreCount)
+        {
+            data.count = entry.count;
+        }
+        applied++;
+    }
+    file.close();
+
+    journalCount = entries;
+    return applied > 0;
+}
+
+bool TieredHumidityRecorder::load(HumidityData &data)
+{
+    return loadRecent(data, HumidityData::RECORD_SIZE);
+}
+
+bool TieredHumidityRecorder::loadRecent(HumidityData &data, size_t recent)
+{
+    bool loaded = inner.loadRecent(data, recent);
+
+    // SDカードから読み込めなかった場合はジャーナルだけで履歴を復元する
+    bool replayed = replayJournal(data, !loaded);
+
+    journaledCount = data.count;
+    lastFlushTime = millis();
+    return loaded || replayed;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "humidity_recorder.h"
+#include <Arduino.h>
+#include <FS.h>
+
+/**
+ * @brief RAM・内蔵フラッシュ・SDカードの3段で保存する湿度レコーダーのデコレーター
+ *
+ * 新しいデータはメモリ上のリングバッファ（RAM）にあり、save() のたびに内蔵フラッシュ上の
+ * 小さなジャーナルへ追記されます。ラップ対象のレコーダー（SDカード）への保存は
+ * FLUSH_INTERVAL ごと、またはジャーナルが FLUSH_THRESHOLD 件に達したときにまとめて行います。
+ * SDカードがない間はジャーナルに溜め続け、フラッシュのみで履歴を保持します。
+ *
+ * load() ではSDカードの履歴を読み込んだあと、SDカードに未反映のジャーナルを追加で適用します。
+ * ジャーナルの先頭にはヘッダ（識別子・バージョン・エントリのサイズ）があり、フォーマットの異なるジャーナル
+ * （ファームウェアの更新前のものなど）は適用せずに破棄します。
+ */
+class TieredHumidityRecorder final : public IHumidityRecorder
+{
+public:
+    constexpr static uint32_t FLUSH_INTERVAL = 60 * 60 * 1000;                ///< SDカードへまとめて保存する間隔（1時間）
+    constexpr static size_t FLUSH_THRESHOLD = 12;                             ///< SDカードへの保存を前倒しするジャーナル件数
+    constexpr static size_t JOURNAL_CAPACITY = 2 * HumidityData::RECORD_SIZE; ///< ジャーナルに保持する最大件数（書き直すとリングバッファの件数に戻る）
+    constexpr static uint32_t FILE_MAGIC = 0x4A485447;                        ///< ファイル識別子（"GTHJ"）
+    constexpr static uint16_t FILE_VERSION = 1;                               ///< ファイルフォーマットのバージョン
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param inner SDカードへの保存を行うレコーダーへの参照
+     * @param flash ジャーナルを置く内蔵フラッシュのファイルシステム（LittleFS）
+     * @param path ジャーナルファイルのパス
+     */
+    TieredHumidityRecorder(IHumidityRecorder &inner, fs::FS &flash, const char *path = "/journal.bin")
+        : inner(inner), flash(flash), path(path)
+    {
+    }
+
+    /**
+     * @brief ジャーナルに追記し、必要に応じてSDカードへまとめて保存する
+     *
+     * データがクリアされた場合はジャーナルを破棄し、すぐにSDカードへ保存します。
+     *
+     * @param data 保存する湿度データ
+     * @return true ジャーナルへの追記に成功（SDカードへの保存は失敗していてもよい）
+     * @return false ジャーナルへの追記に失敗し、SDカードへの保存もできなかった
+     */
+    bool save(const HumidityData &data) override;
+
+    /**
+     * @brief SDカードとジャーナルの両方からデータを読み込む
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @return true いずれかから読み込めた
+     * @return false どちらにもデータがない
+     */
+    bool load(HumidityData &data) override;
+
+    /**
+     * @brief SDカードの最新データとジャーナルを読み込む
+     *
+     * @param[out] data 読み込んだデータを格納する湿度データ構造体
+     * @param recent SDカードから最低限読み込む最新データ数
+     * @return true いずれかから読み込めた
+     * @return false どちらにもデータがない
+     */
+    bool loadRecent(HumidityData &data, size_t recent) override;
+
+    /**
+     * @brief SDカードから古いデータを読み込む
+     *
+     * @param[out] data loadRecent() に渡した湿度データ構造体
+     * @param maxSamples 今回読み込む最大データ数の目安
+     * @return true すべて読み込み終えた
+     * @return false まだ読み込むデータが残っている
+     */
+    bool loadOlder(HumidityData &data, size_t maxSamples) override
+    {
+        return inner.loadOlder(data, maxSamples);
+    }
+
+    /**
+     * @brief 読み込み済みのデータ数を取得する
+     */
+    size_t getLoadedCount() const override
+    {
+        return inner.getLoadedCount();
+    }
+
+    /**
+     * @brief SDカードに未反映のジャーナル件数を取得する
+     */
+    size_t getJournalCount() const
+    {
+        return journalCount;
+    }
+
+    /**
+     * @brief SDカードへまとめて保存した回数を取得する
+     */
+    uint32_t getFlushCount() const
+    {
+        return flushCount;
+    }
+
+private:
+    /**
+     * @brief ジャーナルのファイルヘッダ（ファイルの先頭に格納）
+     */
+    struct JournalHeader
+    {
+        uint32_t magic;     ///< ファイル識別子
+        uint16_t version;   ///< フォーマットバージョン
+        uint16_t entrySize; ///< 1エントリあたりのバイト数（湿度データのビット数で変わる）
+    };
+
+    /**
+     * @brief ジャーナルのエントリ
+     */
+    struct JournalEntry
+    {
+        uint32_t count;             ///< このデータを追加した直後の累計データ数（CLEAR_MARKER でクリア）
+        uint32_t timestamp;         ///< 記録した時刻（秒）
+        uint16_t interval;          ///< 前のデータからの経過秒数
+        HumidityData::Sample value; ///< 湿度データ（エンコード済み）
+        uint8_t events;             ///< イベントのビットフラグ
+    };
+
+    constexpr static uint32_t CLEAR_MARKER = 0; ///< データのクリアを表すエントリの累計データ数
+
+    IHumidityRecorder &inner; ///< SDカードへの保存を行うレコーダー
+    fs::FS &flash;            ///< 内蔵フラッシュのファイルシステム
+    const char *path;         ///< ジャーナルファイルのパス
+
+    uint32_t journaledCount = 0; ///< ジャーナルへ追記済みの累計データ数
+    size_t journalCount = 0;     ///< SDカードに未反映のジャーナル件数
+    uint32_t lastFlushTime = 0;  ///< 最後にSDカードへの保存を試みた時間（ミリ秒）
+    uint32_t flushCount = 0;     ///< SDカードへの保存に成功した回数
+
+    /**
+     * @brief 空のジャーナルファイルの先頭にヘッダを書き込む
+     */
+    static bool writeHeader(fs::File &file);
+
+    /**
+     * @brief SDカードへ保存し、成功したらジャーナルを破棄する
+     */
+    bool flush(const HumidityData &data);
+
+    /**
+     * @brief 前回以降に追加されたデータをジャーナルへ追記する
+     */
+    bool appendJournal(const HumidityData &data);
+
+    /**
+     * @brief ジャーナルをリングバッファの内容で書き直す
+     *
+     * SDカードがないままジャーナルが上限に達した場合に使用します。書き直した後のジャーナルはリングバッファの件数
+     * （RECORD_SIZE）になり、上限までの残りの分だけ追記できるため、書き直しはそれだけの記録ごとに1回で済みます。
+     */
+    bool compactJournal(const HumidityData &data);
+
+    /**
+     * @brief SDカードに未反映のジャーナルをデータへ適用する
+     *
+     * @param[out] data 適用先の湿度データ構造体
+     * @param restoreCount データの累計数をジャーナルに合わせるかどうか（SDカードから読み込めなかった場合）
+     * @return true 1件以上適用した
+     */
+    bool replayJournal(HumidityData &data, bool restoreCount);
+};
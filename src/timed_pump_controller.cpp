@@ -0,0 +1,117 @@
+#include "timed_pump_controller.h"
+#include <algorithm>
+#include <driver/gpio.h>
+
+bool TimedPumpController::begin()
+{
+    if (!deadlineTimer)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = onDeadline;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "pump deadline";
+        if (esp_timer_create(&args, &deadlineTimer) != ESP_OK)
+        {
+            deadlineTimer = nullptr;
+            return false;
+        }
+    }
+
+    if (reader && !checkTimer)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = onCheck;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "pump check";
+        if (esp_timer_create(&args, &checkTimer) != ESP_OK)
+        {
+            checkTimer = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+void TimedPumpController::turnOn()
+{
+    portENTER_CRITICAL(&lock);
+    state = true;
+    startTime = esp_timer_get_time();
+    lastCheck = startTime;
+    portEXIT_CRITICAL(&lock);
+    digitalWrite(controlPin, HIGH);
+
+    if (deadlineTimer)
+    {
+        esp_timer_start_once(deadlineTimer, static_cast<uint64_t>(maxDuration) * 1000);
+    }
+    if (checkTimer)
+    {
+        esp_timer_start_periodic(checkTimer, CHECK_INTERVAL);
+    }
+}
+
+void TimedPumpController::turnOff()
+{
+    stop();
+    stopTimers();
+}
+
+void TimedPumpController::onDeadline(void *arg)
+{
+    TimedPumpController *self = static_cast<TimedPumpController *>(arg);
+    int64_t now = esp_timer_get_time();
+    if (!self->stop())
+    {
+        return;
+    }
+    self->stopTimers();
+
+    // 期限からの遅れを計測する（esp_timer のタスクが動き出すまでの時間）
+    uint32_t latency = std::max<int64_t>(now - self->startTime - static_cast<int64_t>(self->maxDuration) * 1000, 0);
+    self->cutoffCounts[CUTOFF_DEADLINE]++;
+    self->deadlineLatency += latency;
+    self->maxDeadlineLatency = std::max(self->maxDeadlineLatency, latency);
+}
+
+void TimedPumpController::onCheck(void *arg)
+{
+    TimedPumpController *self = static_cast<TimedPumpController *>(arg);
+    int64_t now = esp_timer_get_time();
+    uint32_t latency = std::max<int64_t>(now - self->lastCheck - CHECK_INTERVAL, 0);
+    self->maxCheckLatency = std::max(self->maxCheckLatency, latency);
+    self->lastCheck = now;
+
+    if (self->reader->readHumidity() < self->offThreshold || !self->stop())
+    {
+        return;
+    }
+    self->stopTimers();
+    self->cutoffCounts[CUTOFF_THRESHOLD]++;
+}
+
+bool TimedPumpController::stop()
+{
+    // メインループとタイマーのコールバックが同時に停止しても、停止は1回として数える
+    portENTER_CRITICAL(&lock);
+    bool wasOn = state;
+    gpio_set_level(static_cast<gpio_num_t>(controlPin), 0);
+    state = false;
+    portEXIT_CRITICAL(&lock);
+    return wasOn;
+}
+
+void TimedPumpController::stopTimers()
+{
+    // 止まっているタイマーを止めた場合のエラーは無視する
+    if (deadlineTimer)
+    {
+        esp_timer_stop(deadlineTimer);
+    }
+    if (checkTimer)
+    {
+        esp_timer_stop(checkTimer);
+    }
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "humidity_reader.h"
+#include "pump_controller.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+#ifndef PUMP_TIMER_CUTOFF
+#define PUMP_TIMER_CUTOFF 1 ///< タイマーでポンプを強制停止する（0 にするとメインループの判定だけで停止する）
+#endif
+
+#ifndef PUMP_CHECK_INTERVAL_US
+#define PUMP_CHECK_INTERVAL_US 5000 ///< ポンプ稼働中に停止閾値を確認する間隔（マイクロ秒）
+#endif
+
+/**
+ * @brief タイマーで最大稼働時間・停止閾値を守るポンプ制御の実装
+ *
+ * turnOn() で esp_timer のワンショットタイマーを最大稼働時間後に設定し、期限が来るとタイマーの
+ * コールバックからピンをLOWにします。稼働中は高頻度の周期タイマーで湿度を読み、停止閾値以上になった時点でも停止します。
+ * コールバックは esp_timer の高優先度タスクで実行されるため、メインループが保存や画面の転送で遅れても、
+ * 稼働時間が延びることはありません（湿度の読み取りは最新の値を返すだけの IHumidityReader を渡してください）。
+ *
+ * タイマーが停止した場合、isOn() は false を返します。アプリケーションは稼働中のはずのポンプが止まっていることで、
+ * 停止したことを知ることができます。期限に対する停止の遅れ（ジッター）と、閾値の確認間隔の遅れを計測します。
+ * begin() を呼ぶまで（またはタイマーを作成できなかった場合）は GPIOPumpController と同じく、停止はメインループに任せます。
+ */
+class TimedPumpController final : public IPumpController
+{
+public:
+    constexpr static uint32_t CHECK_INTERVAL = PUMP_CHECK_INTERVAL_US; ///< 停止閾値を確認する間隔（マイクロ秒）
+
+    /**
+     * @brief 停止の理由
+     */
+    enum Cutoff : uint8_t
+    {
+        CUTOFF_DEADLINE,  ///< 最大稼働時間の超過
+        CUTOFF_THRESHOLD, ///< 停止閾値以上の湿度
+        CUTOFF_COUNT      ///< 停止の理由の数
+    };
+
+    /**
+     * @brief コンストラクタ
+     *
+     * @param controlPin ポンプ制御に使用するGPIOピン番号
+     * @param maxDuration 最大稼働時間（ミリ秒）
+     * @param reader 停止閾値の確認に使う湿度リーダー（nullptr の場合は最大稼働時間だけで停止する）
+     * @param offThreshold ポンプを停止させる湿度閾値 (%)
+     */
+    TimedPumpController(int controlPin, uint32_t maxDuration, IHumidityReader *reader = nullptr, float offThreshold = 100.0f)
+        : controlPin(controlPin), maxDuration(maxDuration), reader(reader), offThreshold(offThreshold)
+    {
+        pinMode(controlPin, OUTPUT);
+        digitalWrite(controlPin, LOW);
+    }
+
+    /**
+     * @brief 停止用のタイマーを作成する
+     *
+     * setup() 関数内で、アプリケーションの初期化より前に呼び出してください。
+     *
+     * @return true 作成成功
+     * @return false 作成に失敗（停止はメインループに任せる）
+     */
+    bool begin();
+
+    /**
+     * @brief ポンプを作動させ、停止用のタイマーを開始する
+     */
+    void turnOn() override;
+
+    /**
+     * @brief ポンプを停止させ、停止用のタイマーを止める
+     */
+    void turnOff() override;
+
+    /**
+     * @brief ポンプの状態を取得する（タイマーが停止した場合は false）
+     *
+     * @return true HIGH（作動中）
+     * @return false LOW（停止中）
+     */
+    bool isOn() override
+    {
+        return state;
+    }
+
+    /**
+     * @brief タイマーが停止させた回数を取得する
+     *
+     * @param cutoff 停止の理由
+     */
+    uint32_t getCutoffCount(Cutoff cutoff) const
+    {
+        return cutoffCounts[cutoff];
+    }
+
+    /**
+     * @brief 最大稼働時間の期限から停止するまでの遅れの合計を取得する
+     *
+     * @return uint64_t 遅れ（マイクロ秒）
+     */
+    uint64_t getDeadlineLatency() const
+    {
+        return deadlineLatency;
+    }
+
+    /**
+     * @brief 最大稼働時間の期限から停止するまでの最長の遅れを取得する
+     *
+     * @return uint32_t 遅れ（マイクロ秒）
+     */
+    uint32_t getMaxDeadlineLatency() const
+    {
+        return maxDeadlineLatency;
+    }
+
+    /**
+     * @brief 停止閾値の確認間隔が CHECK_INTERVAL より遅れた最長の時間を取得する
+     *
+     * @return uint32_t 遅れ（マイクロ秒）
+     */
+    uint32_t getMaxCheckLatency() const
+    {
+        return maxCheckLatency;
+    }
+
+private:
+    int controlPin;          ///< 制御ピン番号
+    uint32_t maxDuration;    ///< 最大稼働時間（ミリ秒）
+    IHumidityReader *reader; ///< 停止閾値の確認に使う湿度リーダー
+    float offThreshold;      ///< ポンプを停止させる湿度閾値 (%)
+
+    esp_timer_handle_t deadlineTimer = nullptr;       ///< 最大稼働時間で停止するワンショットタイマー
+    esp_timer_handle_t checkTimer = nullptr;          ///< 停止閾値を確認する周期タイマー
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; ///< 状態の更新を保護するスピンロック
+    volatile bool state = false;                      ///< 現在の状態（タイマーのコールバックからも更新）
+    int64_t startTime = 0;                            ///< 稼働を開始した時刻（マイクロ秒）
+    int64_t lastCheck = 0;                            ///< 前回停止閾値を確認した時刻（マイクロ秒）
+
+    uint32_t cutoffCounts[CUTOFF_COUNT] = {}; ///< 停止の理由ごとの、タイマーが停止させた回数
+    uint64_t deadlineLatency = 0;             ///< 期限から停止するまでの遅れの合計（マイクロ秒）
+    uint32_t maxDeadlineLatency = 0;          ///< 期限から停止するまでの最長の遅れ（マイクロ秒）
+    uint32_t maxCheckLatency = 0;             ///< 停止閾値の確認間隔の最長の遅れ（マイクロ秒）
+
+    /**
+     * @brief 最大稼働時間のタイマーのコールバック
+     */
+    static void onDeadline(void *arg);
+
+    /**
+     * @brief 停止閾値を確認する周期タイマーのコールバック
+     */
+    static void onCheck(void *arg);
+
+    /**
+     * @brief ピンをLOWにして稼働を終える
+     *
+     * @return true 停止した
+     * @return false すでに停止していた
+     */
+    bool stop();
+
+    /**
+     * @brief 停止用のタイマーを止める
+     */
+    void stopTimers();
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <sys/time.h>
+#include <time.h>
+
+/**
+ * @brief 壁時計（time()）の時刻の管理
+ *
+ * ネットワークや外付けのRTCを使わないため、電源投入直後の time() は 1970年1月1日付近から始まります。
+ * シリアルの "time" コマンドで set() した時刻は、ESP32 の RTC のタイマーがディープスリープやリセットをまたいで
+ * 保持します（電源を切ると失われます）。設定されるまでの時刻は記録の時刻として使えないため、isValid() で判定してください。
+ */
+class WallClock final
+{
+public:
+    constexpr static uint32_t MIN_VALID_TIME = 1704067200; ///< 設定済みとみなす最小の時刻（2024-01-01 00:00:00 UTC）
+
+    /**
+     * @brief 時刻が設定済みの時計から得た値かどうか
+     *
+     * @param timestamp 時刻（秒）
+     */
+    constexpr static bool isValid(uint32_t timestamp)
+    {
+        return timestamp >= MIN_VALID_TIME;
+    }
+
+    /**
+     * @brief 現在の時刻を取得する
+     *
+     * @return uint32_t 時刻（秒）
+     */
+    static uint32_t now()
+    {
+        return static_cast<uint32_t>(time(nullptr));
+    }
+
+    /**
+     * @brief 時計が設定済みかどうか
+     */
+    static bool isSet()
+    {
+        return isValid(now());
+    }
+
+    /**
+     * @brief 時計を設定する
+     *
+     * @param timestamp UNIX時刻（秒）
+     * @return true 設定成功
+     * @return false 時刻が MIN_VALID_TIME より前、または設定に失敗
+     */
+    static bool set(uint32_t timestamp)
+    {
+        if (!isValid(timestamp))
+        {
+            return false;
+        }
+
+        timeval tv = {static_cast<time_t>(timestamp), 0};
+        return settimeofday(&tv, nullptr) == 0;
+    }
+};
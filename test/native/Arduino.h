@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief ホスト上のテスト（env:native）で使う Arduino.h の代わり
+ *
+ * テスト対象のヘッダが使う関数だけを用意します。millis() はテストから進められる時刻を返します。
+ */
+
+constexpr uint8_t LOW = 0x0;    ///< ピンの出力 LOW
+constexpr uint8_t HIGH = 0x1;   ///< ピンの出力 HIGH
+constexpr uint8_t OUTPUT = 0x3; ///< 出力モード
+
+/**
+ * @brief millis() が返す時刻（ミリ秒）への参照を取得する
+ */
+inline uint32_t &mockMillis()
+{
+    static uint32_t now = 0;
+    return now;
+}
+
+inline uint32_t millis()
+{
+    return mockMillis();
+}
+
+inline void pinMode(uint8_t, uint8_t)
+{
+}
+
+inline void digitalWrite(uint8_t, uint8_t)
+{
+}
@@ -0,0 +1,160 @@
+#include "gorilla_codec.h"
+#include <unity.h>
+
+/**
+ * @brief 圧縮前のサンプル
+ */
+struct Point
+{
+    uint32_t timestamp; ///< タイムスタンプ（秒）
+    uint16_t value;     ///< 量子化した湿度値
+};
+
+static uint8_t buffer[512];
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+/**
+ * @brief エンコードしたサンプルがすべて同じ値で取り出せることを確認する
+ */
+static void assertRoundTrip(const Point *points, size_t count)
+{
+    GorillaEncoder encoder(buffer, sizeof(buffer));
+    for (size_t i = 0; i < count; i++)
+    {
+        TEST_ASSERT_TRUE(encoder.append(points[i].timestamp, points[i].value));
+    }
+    TEST_ASSERT_EQUAL(count, encoder.getCount());
+
+    GorillaDecoder decoder(buffer, encoder.getBitLength(), encoder.getCount());
+    uint32_t timestamp;
+    uint16_t value;
+    for (size_t i = 0; i < count; i++)
+    {
+        TEST_ASSERT_TRUE(decoder.next(timestamp, value));
+        TEST_ASSERT_EQUAL_UINT32(points[i].timestamp, timestamp);
+        TEST_ASSERT_EQUAL_UINT16(points[i].value, value);
+    }
+    TEST_ASSERT_FALSE(decoder.next(timestamp, value));
+}
+
+void test_constant_interval_and_value()
+{
+    Point points[64];
+    for (size_t i = 0; i < 64; i++)
+    {
+        points[i] = {1700000000 + static_cast<uint32_t>(i) * 600, 5000};
+    }
+    assertRoundTrip(points, 64);
+
+    // 2件目は間隔そのものが差分の差分になり、以降は時刻・値とも1ビットずつ
+    GorillaEncoder encoder(buffer, sizeof(buffer));
+    for (const Point &point : points)
+    {
+        encoder.append(point.timestamp, point.value);
+    }
+    TEST_ASSERT_EQUAL(32 + 16 + (4 + 12 + 1) + 62 * 2, encoder.getBitLength());
+}
+
+void test_value_range_edges()
+{
+    // 量子化した湿度の両端と、各ビット幅の境界をまたぐ変化
+    const Point points[] = {
+        {1000, 0},    {1600, 10000}, {2200, 0},     {2800, 65535}, {3400, 0},   {4000, 1},
+        {4600, 9},    {5200, 2},     {5800, 66},    {6400, 3},     {7000, 515}, {7600, 4},
+        {8200, 4},    {8800, 65535}, {9400, 65534}, {10000, 1},    {10600, 0},
+    };
+    assertRoundTrip(points, sizeof(points) / sizeof(points[0]));
+}
+
+void test_timestamp_edges()
+{
+    // 間隔の変化が各ビット幅の境界をまたぐ場合と、32ビットの範囲の両端
+    const Point points[] = {
+        {0, 100},          {0, 100},          {64, 100},         {192, 100},        {576, 100},
+        {3008, 100},       {5440, 100},       {5440, 100},       {100000000, 100},  {100000001, 100},
+        {0xFFFFFFF0, 100}, {0xFFFFFFFF, 100},
+    };
+    assertRoundTrip(points, sizeof(points) / sizeof(points[0]));
+}
+
+void test_full_buffer_rejects_append()
+{
+    uint8_t small[16];
+    GorillaEncoder encoder(small, sizeof(small));
+
+    // 最大ビット数のサンプルが入らなくなった時点で追加を拒否し、それまでのサンプルは読める
+    size_t appended = 0;
+    while (encoder.append(1000 + appended * 1000000, appended % 2 ? 65535 : 0))
+    {
+        appended++;
+    }
+    TEST_ASSERT_TRUE(appended > 0);
+    TEST_ASSERT_TRUE(encoder.getBitLength() <= sizeof(small) * 8);
+
+    GorillaDecoder decoder(small, encoder.getBitLength(), encoder.getCount());
+    uint32_t timestamp;
+    uint16_t value;
+    for (size_t i = 0; i < appended; i++)
+    {
+        TEST_ASSERT_TRUE(decoder.next(timestamp, value));
+        TEST_ASSERT_EQUAL_UINT32(1000 + i * 1000000, timestamp);
+        TEST_ASSERT_EQUAL_UINT16(i % 2 ? 65535 : 0, value);
+    }
+    TEST_ASSERT_FALSE(decoder.next(timestamp, value));
+}
+
+void test_resume_continues_block()
+{
+    const Point points[] = {{1000, 5000}, {1600, 5010}, {2200, 4990}, {2800, 4990}, {3500, 0}};
+    uint8_t saved[64];
+    {
+        GorillaEncoder encoder(saved, sizeof(saved));
+        for (size_t i = 0; i < 3; i++)
+        {
+            encoder.append(points[i].timestamp, points[i].value);
+        }
+    }
+
+    // 保存済みの書きかけのブロックを読み込み、状態を引き継いだエンコーダーで続きを追記する
+    uint8_t block[64];
+    GorillaEncoder encoder(block, sizeof(block));
+    memcpy(block, saved, sizeof(block));
+    GorillaDecoder resumed(block, sizeof(block) * 8, 3);
+    uint32_t timestamp;
+    uint16_t value;
+    while (resumed.next(timestamp, value))
+    {
+    }
+    resumed.resume(encoder);
+    TEST_ASSERT_EQUAL(3, encoder.getCount());
+    TEST_ASSERT_EQUAL_UINT32(2200, encoder.getLastTimestamp());
+    TEST_ASSERT_TRUE(encoder.append(points[3].timestamp, points[3].value));
+    TEST_ASSERT_TRUE(encoder.append(points[4].timestamp, points[4].value));
+
+    GorillaDecoder decoder(block, encoder.getBitLength(), encoder.getCount());
+    for (const Point &point : points)
+    {
+        TEST_ASSERT_TRUE(decoder.next(timestamp, value));
+        TEST_ASSERT_EQUAL_UINT32(point.timestamp, timestamp);
+        TEST_ASSERT_EQUAL_UINT16(point.value, value);
+    }
+    TEST_ASSERT_FALSE(decoder.next(timestamp, value));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_constant_interval_and_value);
+    RUN_TEST(test_value_range_edges);
+    RUN_TEST(test_timestamp_edges);
+    RUN_TEST(test_full_buffer_rejects_append);
+    RUN_TEST(test_resume_continues_block);
+    return UNITY_END();
+}
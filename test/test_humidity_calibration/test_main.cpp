@@ -0,0 +1,90 @@
+#include "humidity_calibration.h"
+#include <unity.h>
+
+// 校正点が区間の境界（16mV ごと）にない場合、その区間だけは表の補間で半区間分の傾きまでずれる
+constexpr float TOLERANCE = 0.5f; ///< 湿度の許容誤差（%）
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_default_points()
+{
+    HumidityCalibration calibration;
+
+    TEST_ASSERT_FLOAT_WITHIN(TOLERANCE, 0.0f, calibration.toHumidity(HumidityCalibration::DEFAULT_DRY_MV));
+    TEST_ASSERT_FLOAT_WITHIN(TOLERANCE, 100.0f, calibration.toHumidity(HumidityCalibration::DEFAULT_WET_MV));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, calibration.toHumidity(1600));
+}
+
+void test_interpolation_between_points()
+{
+    HumidityCalibration calibration(2200, 1000);
+
+    // 区間の境界の間も直線上にある
+    for (uint32_t millivolts = 1000; millivolts <= 2200; millivolts += 7)
+    {
+        float expected = (2200.0f - millivolts) * 100.0f / 1200.0f;
+        TEST_ASSERT_FLOAT_WITHIN(TOLERANCE, expected, calibration.toHumidity(millivolts));
+    }
+}
+
+void test_clamps_outside_points()
+{
+    HumidityCalibration calibration(2200, 1000);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f, calibration.toHumidity(0));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f, calibration.toHumidity(500));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, calibration.toHumidity(3000));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, calibration.toHumidity(HumidityCalibration::MAX_MV));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, calibration.toHumidity(100000));
+}
+
+void test_multiple_points()
+{
+    // 順不同の3点を折れ線で結ぶ
+    const CalibrationPoint points[] = {{1600, 40}, {2200, 0}, {1000, 100}};
+    HumidityCalibration calibration(points, 3);
+
+    TEST_ASSERT_EQUAL(3, calibration.getPointCount());
+    TEST_ASSERT_EQUAL(1000, calibration.getPoints()[0].millivolts);
+    TEST_ASSERT_EQUAL(2200, calibration.getPoints()[2].millivolts);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 40.0f, calibration.toHumidity(1600));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 20.0f, calibration.toHumidity(1900));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 70.0f, calibration.toHumidity(1300));
+}
+
+void test_set_point_replaces_and_limits()
+{
+    HumidityCalibration calibration(2200, 1000);
+
+    // 同じ湿度の校正点は置き換える
+    TEST_ASSERT_TRUE(calibration.setPoint(100, 1200));
+    TEST_ASSERT_EQUAL(2, calibration.getPointCount());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f, calibration.toHumidity(1200));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 50.0f, calibration.toHumidity(1700));
+
+    // 100% を超える湿度は 100% として扱い、MAX_POINTS を超える校正点は追加しない
+    TEST_ASSERT_TRUE(calibration.setPoint(150, 1100));
+    TEST_ASSERT_EQUAL(2, calibration.getPointCount());
+    TEST_ASSERT_TRUE(calibration.setPoint(30, 1900));
+    TEST_ASSERT_TRUE(calibration.setPoint(60, 1500));
+    TEST_ASSERT_EQUAL(HumidityCalibration::MAX_POINTS, calibration.getPointCount());
+    TEST_ASSERT_FALSE(calibration.setPoint(80, 1300));
+    TEST_ASSERT_EQUAL(HumidityCalibration::MAX_POINTS, calibration.getPointCount());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_default_points);
+    RUN_TEST(test_interpolation_between_points);
+    RUN_TEST(test_clamps_outside_points);
+    RUN_TEST(test_multiple_points);
+    RUN_TEST(test_set_point_replaces_and_limits);
+    return UNITY_END();
+}
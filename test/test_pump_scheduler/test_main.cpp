@@ -0,0 +1,154 @@
+#include "pump_scheduler.h"
+#include <unity.h>
+
+/**
+ * @brief 状態だけを保持するポンプ
+ */
+class FakePump final : public IPumpController
+{
+public:
+    void turnOn() override
+    {
+        on = true;
+    }
+
+    void turnOff() override
+    {
+        on = false;
+    }
+
+    bool isOn() override
+    {
+        return on;
+    }
+
+private:
+    bool on = false; ///< 稼働中かどうか
+};
+
+constexpr size_t CHANNELS = 4;    ///< チャンネル数
+constexpr size_t MAX_RUNNING = 2; ///< 同時に稼働できるポンプの数
+
+static FakePump pumps[CHANNELS];
+static IPumpController *const controllers[CHANNELS] = {&pumps[0], &pumps[1], &pumps[2], &pumps[3]};
+
+void setUp()
+{
+    for (FakePump &pump : pumps)
+    {
+        pump.turnOff();
+    }
+    mockMillis() = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_limits_running_pumps()
+{
+    PumpScheduler scheduler(controllers, CHANNELS, MAX_RUNNING);
+    for (size_t channel = 0; channel < CHANNELS; channel++)
+    {
+        scheduler.request(channel);
+        TEST_ASSERT_TRUE(scheduler.getRunningCount() <= MAX_RUNNING);
+    }
+
+    TEST_ASSERT_EQUAL_HEX8(0b0011, scheduler.getRunningMask());
+    TEST_ASSERT_TRUE(pumps[0].isOn());
+    TEST_ASSERT_TRUE(pumps[1].isOn());
+    TEST_ASSERT_FALSE(pumps[2].isOn());
+    TEST_ASSERT_TRUE(scheduler.isWaiting(2));
+    TEST_ASSERT_TRUE(scheduler.isWaiting(3));
+}
+
+void test_admits_waiting_in_request_order()
+{
+    PumpScheduler scheduler(controllers, CHANNELS, MAX_RUNNING);
+    scheduler.request(0);
+    scheduler.request(1);
+    scheduler.request(3);
+    scheduler.request(2);
+
+    // 空いた枠には、チャンネル番号ではなく要求の古い順に入る
+    mockMillis() = 5000;
+    scheduler.stop(1);
+    TEST_ASSERT_TRUE(scheduler.isRunning(3));
+    TEST_ASSERT_TRUE(pumps[3].isOn());
+    TEST_ASSERT_FALSE(pumps[1].isOn());
+    TEST_ASSERT_TRUE(scheduler.isWaiting(2));
+    TEST_ASSERT_EQUAL_UINT32(5000, scheduler.getStartTime(3));
+
+    scheduler.stop(0);
+    TEST_ASSERT_TRUE(scheduler.isRunning(2));
+    TEST_ASSERT_EQUAL(MAX_RUNNING, scheduler.getRunningCount());
+
+    scheduler.stop(3);
+    scheduler.stop(2);
+    TEST_ASSERT_EQUAL(0, scheduler.getRunningCount());
+}
+
+void test_stop_cancels_waiting_request()
+{
+    PumpScheduler scheduler(controllers, CHANNELS, MAX_RUNNING);
+    for (size_t channel = 0; channel < CHANNELS; channel++)
+    {
+        scheduler.request(channel);
+    }
+
+    // 待機中の要求を取り消すと、その後ろの要求が繰り上がる
+    scheduler.stop(2);
+    TEST_ASSERT_FALSE(scheduler.isWaiting(2));
+    TEST_ASSERT_EQUAL(MAX_RUNNING, scheduler.getRunningCount());
+
+    scheduler.stop(0);
+    TEST_ASSERT_TRUE(scheduler.isRunning(3));
+    TEST_ASSERT_FALSE(scheduler.isRunning(2));
+    TEST_ASSERT_FALSE(pumps[2].isOn());
+}
+
+void test_ignores_duplicate_and_invalid_requests()
+{
+    PumpScheduler scheduler(controllers, 3, MAX_RUNNING);
+    scheduler.request(0);
+    scheduler.request(0);
+    scheduler.request(1);
+    scheduler.request(1);
+    scheduler.request(3);
+    scheduler.request(2);
+    scheduler.request(2);
+
+    // 同じチャンネルの要求は1つだけ数え、チャンネル数を超える番号は無視する
+    scheduler.stop(0);
+    TEST_ASSERT_TRUE(scheduler.isRunning(2));
+    scheduler.stop(1);
+    TEST_ASSERT_EQUAL(1, scheduler.getRunningCount());
+    TEST_ASSERT_FALSE(pumps[3].isOn());
+}
+
+void test_detects_cut_off()
+{
+    PumpScheduler scheduler(controllers, CHANNELS, MAX_RUNNING);
+    scheduler.request(0);
+    TEST_ASSERT_FALSE(scheduler.isCutOff(0));
+
+    // コントローラー側で停止されても、stop() するまで枠は空かない
+    pumps[0].turnOff();
+    TEST_ASSERT_TRUE(scheduler.isCutOff(0));
+    TEST_ASSERT_TRUE(scheduler.isRunning(0));
+
+    scheduler.stop(0);
+    TEST_ASSERT_FALSE(scheduler.isCutOff(0));
+    TEST_ASSERT_EQUAL(0, scheduler.getRunningCount());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_limits_running_pumps);
+    RUN_TEST(test_admits_waiting_in_request_order);
+    RUN_TEST(test_stop_cancels_waiting_request);
+    RUN_TEST(test_ignores_duplicate_and_invalid_requests);
+    RUN_TEST(test_detects_cut_off);
+    return UNITY_END();
+}
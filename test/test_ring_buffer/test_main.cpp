@@ -0,0 +1,130 @@
+#include "ring_buffer.h"
+#include <unity.h>
+
+using Buffer = RingBuffer<uint16_t, 8>;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+/**
+ * @brief 区間を古い順につなげた値が、古い順に並べた要素と一致することを確認する
+ */
+static void assertSpans(const Buffer &buffer, size_t newest, size_t expectedSize)
+{
+    Buffer::Span older, newer;
+    buffer.getSpans(older, newer, newest);
+    TEST_ASSERT_EQUAL(expectedSize, older.size + newer.size);
+
+    // 古い順に i 番目の要素は、新しい順で expectedSize - 1 - i 番目
+    for (size_t i = 0; i < older.size; i++)
+    {
+        TEST_ASSERT_EQUAL(buffer.at(expectedSize - 1 - i), older.data[i]);
+    }
+    for (size_t i = 0; i < newer.size; i++)
+    {
+        TEST_ASSERT_EQUAL(buffer.at(expectedSize - 1 - older.size - i), newer.data[i]);
+    }
+}
+
+void test_push_without_wrap()
+{
+    Buffer buffer;
+    for (uint16_t i = 0; i < 5; i++)
+    {
+        buffer.push(i);
+    }
+
+    TEST_ASSERT_EQUAL(5, buffer.size());
+    TEST_ASSERT_EQUAL(4, buffer.at(0));
+    TEST_ASSERT_EQUAL(0, buffer.at(4));
+
+    Buffer::Span older, newer;
+    buffer.getSpans(older, newer);
+    TEST_ASSERT_EQUAL_PTR(&buffer.items[0], older.data);
+    TEST_ASSERT_EQUAL(5, older.size);
+    TEST_ASSERT_EQUAL(0, newer.size);
+}
+
+void test_push_wraps_and_keeps_newest()
+{
+    Buffer buffer;
+    for (uint16_t i = 0; i < 11; i++)
+    {
+        buffer.push(i);
+    }
+
+    TEST_ASSERT_EQUAL(11, buffer.count);
+    TEST_ASSERT_EQUAL(8, buffer.size());
+    TEST_ASSERT_EQUAL(3, buffer.head);
+    TEST_ASSERT_EQUAL(10, buffer.at(0));
+    TEST_ASSERT_EQUAL(3, buffer.at(7));
+    TEST_ASSERT_EQUAL(2, buffer.position(0));
+    TEST_ASSERT_EQUAL(3, buffer.position(7));
+}
+
+void test_spans_split_at_wrap()
+{
+    Buffer buffer;
+    for (uint16_t i = 0; i < 11; i++)
+    {
+        buffer.push(i);
+    }
+
+    // 全体は配列の位置3〜7と0〜2に分かれる
+    Buffer::Span older, newer;
+    buffer.getSpans(older, newer);
+    TEST_ASSERT_EQUAL_PTR(&buffer.items[3], older.data);
+    TEST_ASSERT_EQUAL(5, older.size);
+    TEST_ASSERT_EQUAL_PTR(&buffer.items[0], newer.data);
+    TEST_ASSERT_EQUAL(3, newer.size);
+    assertSpans(buffer, Buffer::CAPACITY, 8);
+
+    // 最新の一部だけを対象にした場合（折り返しの前後・折り返さない場合）
+    assertSpans(buffer, 5, 5);
+    assertSpans(buffer, 2, 2);
+    assertSpans(buffer, 3, 3);
+    assertSpans(buffer, 100, 8);
+}
+
+void test_ranges_ignore_unrecorded()
+{
+    RingIndex<8> index;
+    RingIndex<8>::Range older, newer;
+    index.getRanges(older, newer);
+    TEST_ASSERT_EQUAL(0, older.size);
+    TEST_ASSERT_EQUAL(0, newer.size);
+}
+
+void test_clear_resets_position()
+{
+    Buffer buffer;
+    for (uint16_t i = 1; i <= 10; i++)
+    {
+        buffer.push(i);
+    }
+    buffer.clear();
+
+    TEST_ASSERT_EQUAL(0, buffer.size());
+    TEST_ASSERT_EQUAL(0, buffer.head);
+    TEST_ASSERT_EQUAL(0, buffer.items[5]);
+
+    buffer.push(42);
+    TEST_ASSERT_EQUAL(42, buffer.at(0));
+    assertSpans(buffer, Buffer::CAPACITY, 1);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_push_without_wrap);
+    RUN_TEST(test_push_wraps_and_keeps_newest);
+    RUN_TEST(test_spans_split_at_wrap);
+    RUN_TEST(test_ranges_ignore_unrecorded);
+    RUN_TEST(test_clear_resets_position);
+    return UNITY_END();
+}
@@ -0,0 +1,105 @@
+#include "sliding_extremum.h"
+#include <unity.h>
+
+using MinWindow = SlidingExtremum<int, 4, std::less<int>>;
+using MaxWindow = SlidingExtremum<int, 4, std::greater<int>>;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+/**
+ * @brief 直近 4 件を素朴に走査した極値と一致することを確認する
+ */
+template <typename Window, typename Compare>
+static void assertMatchesScan(const int *values, size_t count)
+{
+    Window window;
+    for (size_t i = 0; i < count; i++)
+    {
+        window.push(values[i]);
+
+        int expected = values[i];
+        for (size_t j = i >= 3 ? i - 3 : 0; j < i; j++)
+        {
+            if (Compare()(values[j], expected))
+            {
+                expected = values[j];
+            }
+        }
+        TEST_ASSERT_EQUAL(expected, window.get());
+    }
+}
+
+void test_empty_until_push()
+{
+    MinWindow window;
+    TEST_ASSERT_TRUE(window.empty());
+    window.push(3);
+    TEST_ASSERT_FALSE(window.empty());
+    TEST_ASSERT_EQUAL(3, window.get());
+}
+
+void test_extremum_leaves_window()
+{
+    MinWindow window;
+    const int values[] = {1, 5, 6, 7};
+    for (int value : values)
+    {
+        window.push(value);
+    }
+    TEST_ASSERT_EQUAL(1, window.get());
+
+    // 最小値が4件より古くなると、次に小さい値に入れ替わる
+    window.push(8);
+    TEST_ASSERT_EQUAL(5, window.get());
+    window.push(9);
+    TEST_ASSERT_EQUAL(6, window.get());
+}
+
+void test_matches_scan()
+{
+    const int values[] = {5, 3, 8, 3, 1, 9, 9, 2, 7, 7, 7, 7, 0, 4, 6, 10, 10, 1, 8, 2};
+    const size_t count = sizeof(values) / sizeof(values[0]);
+    assertMatchesScan<MinWindow, std::less<int>>(values, count);
+    assertMatchesScan<MaxWindow, std::greater<int>>(values, count);
+
+    // 単調に増える・減る列（キューが最長になる場合と毎回空になる場合）
+    int increasing[12];
+    int decreasing[12];
+    for (int i = 0; i < 12; i++)
+    {
+        increasing[i] = i;
+        decreasing[i] = 12 - i;
+    }
+    assertMatchesScan<MinWindow, std::less<int>>(increasing, 12);
+    assertMatchesScan<MinWindow, std::less<int>>(decreasing, 12);
+    assertMatchesScan<MaxWindow, std::greater<int>>(increasing, 12);
+    assertMatchesScan<MaxWindow, std::greater<int>>(decreasing, 12);
+}
+
+void test_clear_empties_window()
+{
+    MaxWindow window;
+    window.push(10);
+    window.push(20);
+    window.clear();
+    TEST_ASSERT_TRUE(window.empty());
+
+    window.push(5);
+    TEST_ASSERT_EQUAL(5, window.get());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_until_push);
+    RUN_TEST(test_extremum_leaves_window);
+    RUN_TEST(test_matches_scan);
+    RUN_TEST(test_clear_empties_window);
+    return UNITY_END();
+}
@@ -0,0 +1,81 @@
+#include "spsc_queue.h"
+#include <unity.h>
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_empty_queue_pops_nothing()
+{
+    SpscQueue<int, 4> queue;
+    int value = -1;
+
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_FALSE(queue.pop(value));
+    TEST_ASSERT_EQUAL(-1, value);
+}
+
+void test_full_queue_rejects_push()
+{
+    SpscQueue<int, 4> queue;
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_TRUE(queue.push(i));
+    }
+    TEST_ASSERT_FALSE(queue.push(4));
+
+    // 取り出すと空きができ、押し込めなかった値は残らない
+    int value;
+    TEST_ASSERT_TRUE(queue.pop(value));
+    TEST_ASSERT_EQUAL(0, value);
+    TEST_ASSERT_TRUE(queue.push(5));
+    TEST_ASSERT_FALSE(queue.push(6));
+
+    int expected[] = {1, 2, 3, 5};
+    for (int e : expected)
+    {
+        TEST_ASSERT_TRUE(queue.pop(value));
+        TEST_ASSERT_EQUAL(e, value);
+    }
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+void test_fifo_order_across_wrap()
+{
+    SpscQueue<int, 4> queue;
+    int next = 0;
+    int expected = 0;
+    int value;
+
+    // 位置が何周も折り返しても古い順に取り出せる
+    for (int round = 0; round < 10; round++)
+    {
+        while (queue.push(next))
+        {
+            next++;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            TEST_ASSERT_TRUE(queue.pop(value));
+            TEST_ASSERT_EQUAL(expected++, value);
+        }
+    }
+    while (queue.pop(value))
+    {
+        TEST_ASSERT_EQUAL(expected++, value);
+    }
+    TEST_ASSERT_EQUAL(next, expected);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_queue_pops_nothing);
+    RUN_TEST(test_full_queue_rejects_push);
+    RUN_TEST(test_fifo_order_across_wrap);
+    return UNITY_END();
+}